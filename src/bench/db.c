@@ -0,0 +1,320 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2018 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * darktable-bench-db measures how many library reads a number of threads get done at the same time, once all
+ * on the shared connection and once through dt_database_get_reader(), which hands every thread a read only
+ * connection of its own when the library is in wal mode. the library is a throwaway one in a temporary
+ * directory, filled with the given number of images. with --writer another thread keeps committing small
+ * transactions meanwhile, like the gui does while thumbnails are being read.
+ *
+ * to compare against the rollback journal, run it again with --core --conf database/wal=FALSE.
+ */
+
+#include "common/darktable.h"
+#include "common/database.h"
+#include "common/debug.h"
+
+#include <glib/gstdio.h>
+#include <libintl.h>
+#include <sqlite3.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+typedef struct dt_bench_db_thread_t
+{
+  gboolean own_connection; // dt_database_get_reader() instead of dt_database_get()
+  int max_id;
+  gint64 stop;
+  int count;               // queries or commits done
+} dt_bench_db_thread_t;
+
+static void usage(const char *progname)
+{
+  fprintf(stderr, "usage: %s [--images <n>] [--readers <n>[,...]] [--seconds <s>] [--writer] "
+                  "[--core <darktable options>]\n",
+          progname);
+}
+
+// comma separated list of positive numbers
+static GArray *_parse_list(const char *str)
+{
+  GArray *list = g_array_new(FALSE, FALSE, sizeof(int));
+  gchar **tokens = g_strsplit(str, ",", -1);
+  for(gchar **t = tokens; *t; t++)
+  {
+    const int v = atoi(*t);
+    if(v > 0) g_array_append_val(list, v);
+  }
+  g_strfreev(tokens);
+  return list;
+}
+
+// one film roll with n images, with the columns the image cache reads filled in
+static void _fill_library(const int n)
+{
+  sqlite3 *db = dt_database_get(darktable.db);
+  dt_database_start_transaction(darktable.db);
+  DT_DEBUG_SQLITE3_EXEC(db, "INSERT INTO main.film_rolls (id, datetime_accessed, folder) "
+                            "VALUES (1, '2018:01:01 00:00:00', '/bench')",
+                        NULL, NULL, NULL);
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "WITH RECURSIVE n(id) AS (SELECT 1 UNION ALL SELECT id + 1 FROM n WHERE id < ?1) "
+                                  "INSERT INTO main.images (id, group_id, film_id, width, height, filename, maker, "
+                                  "model, lens, exposure, aperture, iso, focal_length, datetime_taken, flags, crop, "
+                                  "orientation, focus_distance, raw_parameters, longitude, latitude, altitude, "
+                                  "colorspace, version, raw_black, raw_maximum) "
+                                  "SELECT id, id, 1, 6000, 4000, printf('IMG_%05d.CR2', id), 'Canon', "
+                                  "'EOS 5D Mark III', 'EF24-105mm f/4L IS USM', 1.0 / 125, 8.0, 400, 50, "
+                                  "'2018:01:01 12:00:00', id % 6, 1.0, -1, 0, 0, NULL, NULL, NULL, 0, 0, 2048, "
+                                  "15000 FROM n",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, n);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  dt_database_release_transaction(darktable.db);
+}
+
+static gpointer _bench_reader(gpointer data)
+{
+  dt_bench_db_thread_t *t = (dt_bench_db_thread_t *)data;
+  sqlite3 *db = t->own_connection ? dt_database_get_reader(darktable.db) : dt_database_get(darktable.db);
+  // what the image cache reads on a miss, for a different image each time
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(db, "SELECT id, group_id, film_id, width, height, filename, maker, model, lens, "
+                                  "exposure, aperture, iso, focal_length, datetime_taken, flags, crop, "
+                                  "orientation, focus_distance, raw_parameters, longitude, latitude, altitude, "
+                                  "color_matrix, colorspace, version, raw_black, raw_maximum "
+                                  "FROM main.images WHERE id = ?1",
+                              -1, &stmt, NULL);
+  for(int id = 1; g_get_monotonic_time() < t->stop; id = id % t->max_id + 1)
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+      ;
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    t->count++;
+  }
+  sqlite3_finalize(stmt);
+  return NULL;
+}
+
+// small transactions on the shared connection, like setting a rating
+static gpointer _bench_writer(gpointer data)
+{
+  dt_bench_db_thread_t *t = (dt_bench_db_thread_t *)data;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.images SET flags = (flags & ~7) | ((flags + 1) % 6) WHERE id = ?1",
+                              -1, &stmt, NULL);
+  for(int id = 1; g_get_monotonic_time() < t->stop; id = id % t->max_id + 1)
+  {
+    dt_database_start_transaction(darktable.db);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, id);
+    sqlite3_step(stmt);
+    sqlite3_reset(stmt);
+    sqlite3_clear_bindings(stmt);
+    dt_database_release_transaction(darktable.db);
+    t->count++;
+  }
+  sqlite3_finalize(stmt);
+  return NULL;
+}
+
+// queries per second of n threads reading at the same time, and commits per second of the writer if any
+static double _bench_readers(const int n, const gboolean own_connection, const int max_id, const double seconds,
+                             const gboolean writer, double *commits_per_second)
+{
+  dt_bench_db_thread_t *threads = calloc(n + 1, sizeof(dt_bench_db_thread_t));
+  GThread **handles = malloc(sizeof(GThread *) * (n + 1));
+  const gint64 start = g_get_monotonic_time();
+  for(int k = 0; k <= n; k++)
+  {
+    threads[k].own_connection = own_connection;
+    threads[k].max_id = max_id;
+    threads[k].stop = start + seconds * G_USEC_PER_SEC;
+    if(k < n)
+      handles[k] = g_thread_new("bench reader", _bench_reader, &threads[k]);
+    else if(writer)
+      handles[k] = g_thread_new("bench writer", _bench_writer, &threads[k]);
+  }
+  int queries = 0;
+  for(int k = 0; k < n; k++)
+  {
+    g_thread_join(handles[k]);
+    queries += threads[k].count;
+  }
+  if(writer) g_thread_join(handles[n]);
+  const double elapsed = (g_get_monotonic_time() - start) / (double)G_USEC_PER_SEC;
+  *commits_per_second = threads[n].count / elapsed;
+  free(handles);
+  free(threads);
+  return queries / elapsed;
+}
+
+static void _remove_dir(const char *dirname)
+{
+  GDir *dir = g_dir_open(dirname, 0, NULL);
+  if(dir)
+  {
+    const gchar *name;
+    while((name = g_dir_read_name(dir)))
+    {
+      gchar *filename = g_build_filename(dirname, name, NULL);
+      if(g_file_test(filename, G_FILE_TEST_IS_DIR))
+        _remove_dir(filename);
+      else
+        g_unlink(filename);
+      g_free(filename);
+    }
+    g_dir_close(dir);
+  }
+  g_rmdir(dirname);
+}
+
+int main(int argc, char *arg[])
+{
+  bindtextdomain(GETTEXT_PACKAGE, DARKTABLE_LOCALEDIR);
+  bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
+  textdomain(GETTEXT_PACKAGE);
+
+  // parse command line arguments
+  int images = 10000;
+  double seconds = 2.0;
+  gboolean writer = FALSE;
+  GArray *readers = NULL;
+
+  int k;
+  for(k = 1; k < argc; k++)
+  {
+    if(!strcmp(arg[k], "--help"))
+    {
+      usage(arg[0]);
+      exit(1);
+    }
+    else if(!strcmp(arg[k], "--images") && argc > k + 1)
+    {
+      k++;
+      images = MAX(atoi(arg[k]), 1);
+    }
+    else if(!strcmp(arg[k], "--readers") && argc > k + 1)
+    {
+      k++;
+      if(readers) g_array_free(readers, TRUE);
+      readers = _parse_list(arg[k]);
+    }
+    else if(!strcmp(arg[k], "--seconds") && argc > k + 1)
+    {
+      k++;
+      seconds = MAX(g_ascii_strtod(arg[k], NULL), 0.1);
+    }
+    else if(!strcmp(arg[k], "--writer"))
+    {
+      writer = TRUE;
+    }
+    else if(!strcmp(arg[k], "--core"))
+    {
+      // everything from here on should be passed to the core
+      k++;
+      break;
+    }
+    else
+    {
+      usage(arg[0]);
+      exit(1);
+    }
+  }
+  if(!readers || readers->len == 0)
+  {
+    if(readers) g_array_free(readers, TRUE);
+    readers = _parse_list("1,2,4,8,16");
+  }
+
+  // wal needs a library on disk, and the readers the data.db as well
+  gchar *tmpdir = g_dir_make_tmp("darktable-bench-db-XXXXXX", NULL);
+  if(!tmpdir)
+  {
+    fprintf(stderr, "error: can't create a temporary directory\n");
+    exit(1);
+  }
+  gchar *library = g_build_filename(tmpdir, "library.db", NULL);
+
+  int m_argc = 0;
+  char **m_arg = malloc((9 + argc - k + 1) * sizeof(char *));
+  m_arg[m_argc++] = "darktable-bench-db";
+  m_arg[m_argc++] = "--library";
+  m_arg[m_argc++] = library;
+  m_arg[m_argc++] = "--configdir";
+  m_arg[m_argc++] = tmpdir;
+  m_arg[m_argc++] = "--cachedir";
+  m_arg[m_argc++] = tmpdir;
+  m_arg[m_argc++] = "--conf";
+  m_arg[m_argc++] = "write_sidecar_files=FALSE";
+  for(; k < argc; k++) m_arg[m_argc++] = arg[k];
+  m_arg[m_argc] = NULL;
+
+  if(dt_init(m_argc, m_arg, FALSE, TRUE, NULL))
+  {
+    _remove_dir(tmpdir);
+    exit(1);
+  }
+
+  _fill_library(images);
+
+  sqlite3_stmt *stmt;
+  gchar *journal_mode = NULL;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "PRAGMA main.journal_mode", -1, &stmt, NULL);
+  if(sqlite3_step(stmt) == SQLITE_ROW) journal_mode = g_strdup((const char *)sqlite3_column_text(stmt, 0));
+  sqlite3_finalize(stmt);
+
+  printf("library with %d images, journal mode %s%s\n\n", images, journal_mode ? journal_mode : "unknown",
+         writer ? ", with a writer" : "");
+  printf("readers  shared connection       own connections\n");
+  for(guint i = 0; i < readers->len; i++)
+  {
+    const int n = g_array_index(readers, int, i);
+    double shared_commits, own_commits;
+    const double shared = _bench_readers(n, FALSE, images, seconds, writer, &shared_commits);
+    const double own = _bench_readers(n, TRUE, images, seconds, writer, &own_commits);
+    printf("%7d  %11.0f queries/s  %11.0f queries/s", n, shared, own);
+    if(writer) printf(", %.0f and %.0f commits/s", shared_commits, own_commits);
+    printf("\n");
+  }
+
+  g_free(journal_mode);
+  g_array_free(readers, TRUE);
+
+  dt_cleanup();
+
+  _remove_dir(tmpdir);
+  g_free(library);
+  g_free(tmpdir);
+  free(m_arg);
+
+  return 0;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
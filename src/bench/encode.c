@@ -0,0 +1,384 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2018 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * darktable-bench-encode writes a synthetic image with the png and tiff format modules a number of times, at each
+ * bit depth and compression setting, and reports the encode throughput and the file size. each file is then read
+ * back with plain libpng and libtiff and has to give the very same pixels, so a broken stream fails the run with
+ * a non-zero exit code.
+ */
+
+#include "bench/synthetic.h"
+#include "common/darktable.h"
+#include "common/imageio_module.h"
+#include "control/conf.h"
+
+#include <glib/gstdio.h>
+#include <libintl.h>
+#include <png.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <tiffio.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+typedef struct dt_bench_encode_format_t
+{
+  const char *name;
+  const char *bpp_key, *level_key;
+  int bpp[3];
+  int levels; // the compression settings are 0 .. levels - 1
+} dt_bench_encode_format_t;
+
+static const dt_bench_encode_format_t _formats[] = {
+  { "png", "plugins/imageio/format/png/bpp", "plugins/imageio/format/png/compression", { 8, 16, 0 }, 10 },
+  { "tiff", "plugins/imageio/format/tiff/bpp", "plugins/imageio/format/tiff/compress", { 8, 16, 32 }, 4 },
+};
+
+static void usage(const char *progname)
+{
+  fprintf(stderr, "usage: %s [--size <width>x<height>] [--format png|tiff[,...]] [--levels <n>[,...]] "
+                  "[--runs <n>] [--core <darktable options>]\n",
+          progname);
+}
+
+static int _compare_double(const void *a, const void *b)
+{
+  const double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// what the export hands the format modules: four samples per pixel, 8 or 16 bit integers or floats
+static void *_input(const float *pixels, const int width, const int height, const int bpp)
+{
+  const size_t n = (size_t)4 * width * height;
+  void *buf = dt_alloc_align(64, n * bpp / 8);
+  if(!buf) return NULL;
+  for(size_t k = 0; k < n; k++)
+  {
+    if(bpp == 8)
+      ((uint8_t *)buf)[k] = CLAMP(pixels[k] * 0xff + 0.5f, 0, 0xff);
+    else if(bpp == 16)
+      ((uint16_t *)buf)[k] = CLAMP(pixels[k] * 0xffff + 0.5f, 0, 0xffff);
+    else
+      ((float *)buf)[k] = pixels[k];
+  }
+  return buf;
+}
+
+// compares a decoded row of three samples per pixel with the input row, returns 0 if they are the same
+static int _compare_row(const void *input, const void *row, const int width, const int bpp, const int y)
+{
+  const size_t bytes = bpp / 8;
+  const uint8_t *in = (const uint8_t *)input + (size_t)4 * bytes * y * width;
+  const uint8_t *out = (const uint8_t *)row;
+  for(int x = 0; x < width; x++, in += 4 * bytes, out += 3 * bytes)
+    if(memcmp(in, out, 3 * bytes)) return 1;
+  return 0;
+}
+
+static int _verify_png(const char *filename, const void *input, const int width, const int height, const int bpp)
+{
+  FILE *f = g_fopen(filename, "rb");
+  if(!f) return 1;
+
+  png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+  png_infop info_ptr = png_ptr ? png_create_info_struct(png_ptr) : NULL;
+  // both are changed after setjmp()
+  uint8_t *volatile row = NULL;
+  volatile int res = 1;
+  if(!info_ptr || setjmp(png_jmpbuf(png_ptr))) goto end;
+
+  png_init_io(png_ptr, f);
+  png_read_info(png_ptr, info_ptr);
+  if(png_get_image_width(png_ptr, info_ptr) != width || png_get_image_height(png_ptr, info_ptr) != height
+     || png_get_bit_depth(png_ptr, info_ptr) != bpp || png_get_color_type(png_ptr, info_ptr) != PNG_COLOR_TYPE_RGB)
+    goto end;
+#if G_BYTE_ORDER == G_LITTLE_ENDIAN
+  if(bpp == 16) png_set_swap(png_ptr);
+#endif
+
+  row = malloc(png_get_rowbytes(png_ptr, info_ptr));
+  res = 0;
+  for(int y = 0; y < height && !res; y++)
+  {
+    png_read_row(png_ptr, row, NULL);
+    res = _compare_row(input, row, width, bpp, y);
+  }
+  // the checksum of the zlib stream and the crc of each chunk are checked on the way to IEND
+  if(!res) png_read_end(png_ptr, NULL);
+
+end:
+  png_destroy_read_struct(&png_ptr, info_ptr ? &info_ptr : NULL, NULL);
+  free(row);
+  fclose(f);
+  return res;
+}
+
+static int _verify_tiff(const char *filename, const void *input, const int width, const int height, const int bpp)
+{
+  TIFF *tif = TIFFOpen(filename, "r");
+  if(!tif) return 1;
+
+  uint32_t w = 0, h = 0;
+  uint16_t spp = 0, bps = 0;
+  TIFFGetField(tif, TIFFTAG_IMAGEWIDTH, &w);
+  TIFFGetField(tif, TIFFTAG_IMAGELENGTH, &h);
+  TIFFGetField(tif, TIFFTAG_SAMPLESPERPIXEL, &spp);
+  TIFFGetField(tif, TIFFTAG_BITSPERSAMPLE, &bps);
+  int res = w != width || h != height || spp != 3 || bps != bpp;
+
+  uint8_t *row = res ? NULL : _TIFFmalloc(TIFFScanlineSize(tif));
+  for(int y = 0; y < height && !res; y++)
+    res = TIFFReadScanline(tif, row, y, 0) != 1 || _compare_row(input, row, width, bpp, y);
+
+  if(row) _TIFFfree(row);
+  TIFFClose(tif);
+  return res;
+}
+
+// returns the number of settings that failed
+static int _bench_format(const dt_bench_encode_format_t *fmt, const float *pixels, const int width,
+                         const int height, GArray *levels, const int runs, const char *tmpdir)
+{
+  dt_imageio_module_format_t *format = dt_imageio_get_format_by_name(fmt->name);
+  if(!format)
+  {
+    printf("\n%s: format not available\n", fmt->name);
+    return 1;
+  }
+
+  int failed = 0;
+  dt_imageio_module_data_t *params = format->get_params(format);
+  gchar *filename = g_strdup_printf("%s/bench.%s", tmpdir, format->extension(params));
+  format->free_params(format, params);
+  double *seconds = malloc(sizeof(double) * runs);
+
+  for(int b = 0; b < G_N_ELEMENTS(fmt->bpp) && fmt->bpp[b]; b++)
+  {
+    const int bpp = fmt->bpp[b];
+    void *input = _input(pixels, width, height, bpp);
+    if(!input)
+    {
+      free(seconds);
+      g_free(filename);
+      return failed + 1;
+    }
+    printf("\n%s, %d bit, %dx%d\n", fmt->name, bpp, width, height);
+
+    for(int l = 0; l < fmt->levels; l++)
+    {
+      if(levels)
+      {
+        gboolean wanted = FALSE;
+        for(guint i = 0; i < levels->len; i++) wanted |= g_array_index(levels, int, i) == l;
+        if(!wanted) continue;
+      }
+
+      dt_conf_set_int(fmt->bpp_key, bpp);
+      dt_conf_set_int(fmt->level_key, l);
+      params = format->get_params(format);
+      params->width = params->max_width = width;
+      params->height = params->max_height = height;
+
+      int r;
+      for(r = 0; r < runs; r++)
+      {
+        const double start = dt_get_wtime();
+        if(format->write_image(params, filename, input, NULL, 0, NULL, 0, 1, 1)) break;
+        seconds[r] = dt_get_wtime() - start;
+      }
+      format->free_params(format, params);
+
+      if(r < runs)
+      {
+        printf("  level %d  could not be written\n", l);
+        failed++;
+        continue;
+      }
+
+      GStatBuf st = { 0 };
+      g_stat(filename, &st);
+      const int differs = !strcmp(fmt->name, "png") ? _verify_png(filename, input, width, height, bpp)
+                                                     : _verify_tiff(filename, input, width, height, bpp);
+      qsort(seconds, runs, sizeof(double), _compare_double);
+      printf("  level %d  %9.1f MPix/s  %7.1f MB  %s\n", l,
+             width * (double)height / fmax(seconds[runs / 2], 1e-9) * 1e-6, st.st_size / (1024.0 * 1024.0),
+             differs ? "does not read back the same" : "reads back the same");
+      failed += differs;
+    }
+    dt_free_align(input);
+  }
+
+  g_unlink(filename);
+  g_free(filename);
+  free(seconds);
+  return failed;
+}
+
+static void _remove_dir(const char *dirname)
+{
+  GDir *dir = g_dir_open(dirname, 0, NULL);
+  if(dir)
+  {
+    const gchar *name;
+    while((name = g_dir_read_name(dir)))
+    {
+      gchar *filename = g_build_filename(dirname, name, NULL);
+      if(g_file_test(filename, G_FILE_TEST_IS_DIR))
+        _remove_dir(filename);
+      else
+        g_unlink(filename);
+      g_free(filename);
+    }
+    g_dir_close(dir);
+  }
+  g_rmdir(dirname);
+}
+
+int main(int argc, char *arg[])
+{
+  bindtextdomain(GETTEXT_PACKAGE, DARKTABLE_LOCALEDIR);
+  bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
+  textdomain(GETTEXT_PACKAGE);
+
+  // parse command line arguments
+  int width = 3000, height = 2000, runs = 3;
+  gchar **names = NULL;
+  GArray *levels = NULL;
+
+  int k;
+  for(k = 1; k < argc; k++)
+  {
+    if(!strcmp(arg[k], "--help"))
+    {
+      usage(arg[0]);
+      exit(1);
+    }
+    else if(!strcmp(arg[k], "--size") && argc > k + 1)
+    {
+      k++;
+      if(sscanf(arg[k], "%dx%d", &width, &height) != 2 || width <= 0 || height <= 0)
+      {
+        fprintf(stderr, "invalid size: %s\n", arg[k]);
+        usage(arg[0]);
+        exit(1);
+      }
+    }
+    else if(!strcmp(arg[k], "--format") && argc > k + 1)
+    {
+      k++;
+      g_strfreev(names);
+      names = g_strsplit(arg[k], ",", -1);
+    }
+    else if(!strcmp(arg[k], "--levels") && argc > k + 1)
+    {
+      k++;
+      if(!levels) levels = g_array_new(FALSE, FALSE, sizeof(int));
+      gchar **tokens = g_strsplit(arg[k], ",", -1);
+      for(gchar **t = tokens; *t; t++)
+      {
+        const int v = atoi(*t);
+        g_array_append_val(levels, v);
+      }
+      g_strfreev(tokens);
+    }
+    else if(!strcmp(arg[k], "--runs") && argc > k + 1)
+    {
+      k++;
+      runs = MAX(atoi(arg[k]), 1);
+    }
+    else if(!strcmp(arg[k], "--core"))
+    {
+      // everything from here on should be passed to the core
+      k++;
+      break;
+    }
+    else
+    {
+      usage(arg[0]);
+      exit(1);
+    }
+  }
+
+  // the format settings are changed through darktablerc, which mustn't be the user's
+  gchar *tmpdir = g_dir_make_tmp("darktable-bench-XXXXXX", NULL);
+  if(!tmpdir)
+  {
+    fprintf(stderr, "error: can't create a temporary directory\n");
+    exit(1);
+  }
+
+  int m_argc = 0;
+  char **m_arg = malloc((7 + argc - k + 1) * sizeof(char *));
+  m_arg[m_argc++] = "darktable-bench-encode";
+  m_arg[m_argc++] = "--library";
+  m_arg[m_argc++] = ":memory:";
+  m_arg[m_argc++] = "--configdir";
+  m_arg[m_argc++] = tmpdir;
+  m_arg[m_argc++] = "--conf";
+  m_arg[m_argc++] = "write_sidecar_files=FALSE";
+  for(; k < argc; k++) m_arg[m_argc++] = arg[k];
+  m_arg[m_argc] = NULL;
+
+  // init dt without gui and without data.db:
+  if(dt_init(m_argc, m_arg, FALSE, FALSE, NULL))
+  {
+    _remove_dir(tmpdir);
+    g_free(tmpdir);
+    free(m_arg);
+    exit(1);
+  }
+
+  float *pixels = dt_alloc_align(64, sizeof(float) * 4 * width * height);
+  int failed = 0;
+  if(!pixels)
+  {
+    fprintf(stderr, "error: can't set up the input\n");
+    failed = 1;
+  }
+  else
+  {
+    dt_bench_synthetic_fill(pixels, width, height, 4, 0);
+    for(int f = 0; f < G_N_ELEMENTS(_formats); f++)
+    {
+      gboolean wanted = !names;
+      for(gchar **name = names; name && *name; name++) wanted |= !strcmp(*name, _formats[f].name);
+      if(wanted) failed += _bench_format(&_formats[f], pixels, width, height, levels, runs, tmpdir);
+    }
+    printf("\n%d settings failed\n", failed);
+  }
+
+  dt_free_align(pixels);
+  g_strfreev(names);
+  if(levels) g_array_free(levels, TRUE);
+
+  dt_cleanup();
+  _remove_dir(tmpdir);
+  g_free(tmpdir);
+  free(m_arg);
+
+  return failed ? 1 : 0;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,848 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2018 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * darktable-bench-iop runs the processing functions of single modules on the same input and checks that their
+ * outputs agree: process() is the reference, process_sse2(), the tiled process and process_cl() are compared
+ * against it, within a tolerance which is 0 by default. each one is timed as well and reported in MPix/s.
+ *
+ * the modules are set up by a real pipe of the given type, with the parameters from the image's history (or
+ * their defaults) and the buffer formats the pipe would hand them. the modules that are off in the history are
+ * switched on for their test. the input is synthetic by default, or what the modules before would really
+ * hand over.
+ *
+ * with --blend each module that can blend is also blended with a drawn and a parametric mask, and that blend is
+ * timed on its own. on linux the last level cache misses of the blend are counted as well, as a measure of its
+ * memory traffic, where perf events are readable (see /proc/sys/kernel/perf_event_paranoid).
+ */
+
+#include "bench/synthetic.h"
+#include "common/darktable.h"
+#include "common/exif.h"
+#include "common/film.h"
+#include "common/image.h"
+#include "common/image_cache.h"
+#include "common/imageio.h"
+#include "common/mipmap_cache.h"
+#include "common/opencl.h"
+#include "control/conf.h"
+#include "develop/blend.h"
+#include "develop/develop.h"
+#include "develop/imageop.h"
+#include "develop/masks.h"
+#include "develop/pixelpipe.h"
+
+#include <glib/gstdio.h>
+#include <libintl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+typedef enum dt_bench_variant_t
+{
+  DT_BENCH_PLAIN = 0, // the reference
+  DT_BENCH_SSE2,
+  DT_BENCH_TILING,
+  DT_BENCH_OPENCL,
+  DT_BENCH_VARIANTS
+} dt_bench_variant_t;
+
+static const char *_variant_names[DT_BENCH_VARIANTS] = { "plain", "sse2", "tiling", "opencl" };
+
+typedef struct dt_bench_iop_options_t
+{
+  int size;             // of the output of each module, 0 is full size
+  dt_iop_roi_t crop;    // part of that to process, if its width is set
+  gboolean real_input;  // the output of the modules before instead of synthetic pixels
+  gboolean tiling;      // also compare the tiled process, in tiles of a quarter of the buffer
+  gboolean blend;       // also time the blend with a drawn and a parametric mask
+  float mask_blur;      // blur radius of that mask
+  int runs;
+  double tolerance;
+} dt_bench_iop_options_t;
+
+static void usage(const char *progname)
+{
+  fprintf(stderr, "usage: %s [<input file> [<xmp file>]] [--synthetic <width>x<height>] [--module <op>[,...]] "
+                  "[--pipe export|full|preview|thumbnail] [--size <max size>] [--roi <w>x<h>+<x>+<y>] "
+                  "[--input synthetic|pipe] [--tiling] [--blend] [--mask-blur <radius>] [--runs <n>] "
+                  "[--tolerance <value>] [--core <darktable options>]\n",
+          progname);
+}
+
+static int _compare_double(const void *a, const void *b)
+{
+  const double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+static void _synthetic_input(const dt_iop_buffer_dsc_t *dsc, void *input, const int width, const int height)
+{
+  const size_t n = (size_t)width * height * dsc->channels;
+  if(dsc->datatype == TYPE_UINT16)
+  {
+    // raw data up to the white point
+    float *tmp = malloc(sizeof(float) * n);
+    dt_bench_synthetic_fill(tmp, width, height, dsc->channels, 0);
+    const float white = dsc->rawprepare.raw_white_point ? dsc->rawprepare.raw_white_point : 0xffff;
+    uint16_t *out = (uint16_t *)input;
+    for(size_t k = 0; k < n; k++) out[k] = CLAMP(tmp[k] * white, 0, 0xffff);
+    free(tmp);
+  }
+  else
+    dt_bench_synthetic_fill((float *)input, width, height, dsc->channels, 0);
+}
+
+// runs the pipe up to, but without, the module and copies its output over. returns 0 on success.
+static int _pipe_input(dt_develop_t *dev, dt_dev_pixelpipe_t *pipe, GList *node, void *input,
+                       const dt_iop_roi_t *roi_in, const size_t in_bpp)
+{
+  GList *nodes = node;
+  int *enabled = malloc(sizeof(int) * g_list_length(node));
+  for(int k = 0; nodes; nodes = g_list_next(nodes), k++)
+  {
+    dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    enabled[k] = piece->enabled;
+    piece->enabled = 0;
+  }
+
+  dt_dev_pixelpipe_flush_caches(pipe);
+  int err = dt_dev_pixelpipe_process(pipe, dev, roi_in->x, roi_in->y, roi_in->width, roi_in->height,
+                                     roi_in->scale);
+  err |= !pipe->backbuf || pipe->backbuf_width != roi_in->width || pipe->backbuf_height != roi_in->height;
+  if(!err) memcpy(input, pipe->backbuf, in_bpp * roi_in->width * roi_in->height);
+
+  nodes = node;
+  for(int k = 0; nodes; nodes = g_list_next(nodes), k++)
+    ((dt_dev_pixelpipe_iop_t *)nodes->data)->enabled = enabled[k];
+  free(enabled);
+  return err;
+}
+
+static gboolean _variant_available(const dt_bench_variant_t variant, const dt_iop_module_t *module,
+                                   const dt_dev_pixelpipe_iop_t *piece, const dt_bench_iop_options_t *options)
+{
+  switch(variant)
+  {
+    case DT_BENCH_PLAIN:
+      return TRUE;
+    case DT_BENCH_SSE2:
+      return darktable.codepath.SSE2 && module->process_sse2;
+    case DT_BENCH_TILING:
+      return options->tiling && piece->process_tiling_ready;
+    case DT_BENCH_OPENCL:
+      return piece->pipe->devid >= 0 && module->process_cl && piece->process_cl_ready;
+    default:
+      return FALSE;
+  }
+}
+
+// the tiled process falls back to a single process() over the whole buffer when tiling saves no memory, which
+// at bench sizes is nearly always. while the tiling variant runs, the module claims to need that much memory
+// that a tile gets a quarter of the buffer, and process() is process_plain() so that only the tiling differs
+// from the reference. the calls are counted: a single one is the fallback.
+static struct
+{
+  void (*tiling_callback)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                          const struct dt_iop_roi_t *roi_in, const struct dt_iop_roi_t *roi_out,
+                          struct dt_develop_tiling_t *tiling);
+  void (*process)(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece, const void *const i,
+                  void *const o, const struct dt_iop_roi_t *const roi_in,
+                  const struct dt_iop_roi_t *const roi_out);
+  int calls;
+} _tiling;
+
+static void _tiling_callback(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                             const struct dt_iop_roi_t *roi_in, const struct dt_iop_roi_t *roi_out,
+                             struct dt_develop_tiling_t *tiling)
+{
+  _tiling.tiling_callback(self, piece, roi_in, roi_out, tiling);
+  // nothing is left of host_memory_limit, so singlebuffer_limit decides the tile size
+  tiling->factor = fmaxf(tiling->factor, 1e9f);
+}
+
+static void _tiling_process(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                            const void *const i, void *const o, const struct dt_iop_roi_t *const roi_in,
+                            const struct dt_iop_roi_t *const roi_out)
+{
+  _tiling.calls++;
+  self->process_plain(self, piece, i, o, roi_in, roi_out);
+}
+
+static void _run_tiling(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, const void *input,
+                        void *output, const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out,
+                        const size_t in_bpp, const size_t out_bpp)
+{
+  const float singlebuffer_limit = dt_conf_get_float("singlebuffer_limit");
+  const size_t buffer = MAX(in_bpp * roi_in->width * roi_in->height, out_bpp * roi_out->width * roi_out->height);
+  // tiling.c doesn't go below 2 MB per tile, so small buffers still aren't tiled
+  dt_conf_set_float("singlebuffer_limit", buffer / 4.0f / (1024.0f * 1024.0f));
+  _tiling.tiling_callback = module->tiling_callback;
+  _tiling.process = module->process;
+  _tiling.calls = 0;
+  module->tiling_callback = _tiling_callback;
+  module->process = _tiling_process;
+
+  module->process_tiling(module, piece, input, output, roi_in, roi_out, in_bpp);
+
+  module->tiling_callback = _tiling.tiling_callback;
+  module->process = _tiling.process;
+  dt_conf_set_float("singlebuffer_limit", singlebuffer_limit);
+}
+
+// returns the seconds spent processing, without the transfers to and from the device, or a negative number
+// on failure
+static double _run_variant(const dt_bench_variant_t variant, dt_iop_module_t *module,
+                           dt_dev_pixelpipe_iop_t *piece, const void *input, void *output,
+                           const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out, const size_t in_bpp,
+                           const size_t out_bpp)
+{
+  // the pipe announces the output format of the module while it runs
+  piece->pipe->dsc = piece->dsc_out;
+  memset(output, 0, out_bpp * roi_out->width * roi_out->height);
+
+  double start = dt_get_wtime();
+  switch(variant)
+  {
+    case DT_BENCH_PLAIN:
+      module->process_plain(module, piece, input, output, roi_in, roi_out);
+      break;
+    case DT_BENCH_SSE2:
+      module->process_sse2(module, piece, input, output, roi_in, roi_out);
+      break;
+    case DT_BENCH_TILING:
+      _run_tiling(module, piece, input, output, roi_in, roi_out, in_bpp, out_bpp);
+      break;
+    case DT_BENCH_OPENCL:
+    {
+#ifdef HAVE_OPENCL
+      const int devid = piece->pipe->devid;
+      void *cl_in = dt_opencl_copy_host_to_device(devid, (void *)input, roi_in->width, roi_in->height, in_bpp);
+      void *cl_out = dt_opencl_alloc_device(devid, roi_out->width, roi_out->height, out_bpp);
+      int ok = cl_in && cl_out;
+      if(ok)
+      {
+        start = dt_get_wtime();
+        ok = module->process_cl(module, piece, cl_in, cl_out, roi_in, roi_out) && dt_opencl_finish(devid) == TRUE;
+      }
+      const double seconds = dt_get_wtime() - start;
+      ok = ok && dt_opencl_copy_device_to_host(devid, output, cl_out, roi_out->width, roi_out->height, out_bpp)
+                     == CL_SUCCESS;
+      dt_opencl_release_mem_object(cl_in);
+      dt_opencl_release_mem_object(cl_out);
+      return ok ? seconds : -1.0;
+#else
+      return -1.0;
+#endif
+    }
+    default:
+      return -1.0;
+  }
+  return dt_get_wtime() - start;
+}
+
+// returns TRUE if the outputs agree within the tolerance
+static gboolean _compare(const dt_iop_buffer_dsc_t *dsc, const void *reference, const void *output,
+                         const size_t n, const double tolerance, double *max_diff, size_t *differing)
+{
+  *max_diff = 0.0;
+  *differing = 0;
+  for(size_t k = 0; k < n; k++)
+  {
+    double diff;
+    if(dsc->datatype == TYPE_UINT16)
+      diff = abs(((const uint16_t *)reference)[k] - ((const uint16_t *)output)[k]);
+    else
+    {
+      const float a = ((const float *)reference)[k], b = ((const float *)output)[k];
+      diff = (isnan(a) && isnan(b)) ? 0.0 : (isnan(a) || isnan(b)) ? INFINITY : fabs(a - b);
+    }
+    *max_diff = fmax(*max_diff, diff);
+    if(diff > tolerance) (*differing)++;
+  }
+  return *differing == 0;
+}
+
+// a circle in the middle of the image, in a group of its own. it belongs to darktable.develop like all forms,
+// the bench's develop only lists it. returns the id of the group.
+static int _blend_drawn_mask(dt_develop_t *dev)
+{
+  static int grpid = 0;
+  if(grpid) return grpid;
+
+  // ids only have to be unique among the forms of the image's history
+  int id = 1;
+  for(GList *forms = dev->forms; forms; forms = g_list_next(forms))
+    id = MAX(id, ((dt_masks_form_t *)forms->data)->formid + 1);
+
+  dt_masks_form_t *circle = dt_masks_create(DT_MASKS_CIRCLE);
+  dt_masks_point_circle_t *point = (dt_masks_point_circle_t *)calloc(1, sizeof(dt_masks_point_circle_t));
+  point->center[0] = point->center[1] = 0.5f;
+  point->radius = 0.25f;
+  point->border = 0.05f;
+  circle->points = g_list_append(circle->points, point);
+  circle->formid = id;
+
+  dt_masks_form_t *grp = dt_masks_create(DT_MASKS_GROUP);
+  dt_masks_point_group_t *grpt = (dt_masks_point_group_t *)calloc(1, sizeof(dt_masks_point_group_t));
+  grpt->formid = circle->formid;
+  grpt->parentid = grp->formid = id + 1;
+  grpt->state = DT_MASKS_STATE_SHOW | DT_MASKS_STATE_USE;
+  grpt->opacity = 1.0f;
+  grp->points = g_list_append(grp->points, grpt);
+
+  dev->forms = g_list_append(dev->forms, circle);
+  dev->forms = g_list_append(dev->forms, grp);
+  return grpid = grp->formid;
+}
+
+// the module blends normally with the drawn mask, limited by a parametric mask on the first channel of its
+// input. returns FALSE if the module can't blend.
+static gboolean _blend_setup(dt_develop_t *dev, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece,
+                             const dt_bench_iop_options_t *options)
+{
+  dt_iop_module_t *module = piece->module;
+  if(!(module->flags() & IOP_FLAGS_SUPPORTS_BLENDING) || !module->blend_params) return FALSE;
+
+  dt_develop_blend_params_t p = *module->default_blendop_params;
+  p.mask_mode = DEVELOP_MASK_ENABLED | DEVELOP_MASK_BOTH;
+  p.blend_mode = DEVELOP_BLEND_NORMAL2;
+  p.opacity = 100.0f;
+  p.mask_combine = DEVELOP_COMBINE_NORM_EXCL;
+  p.mask_id = _blend_drawn_mask(dev);
+  p.blendif = 1u << DEVELOP_BLENDIF_L_in;
+  const float ramp[4] = { 0.1f, 0.3f, 0.7f, 0.9f };
+  memcpy(p.blendif_parameters + 4 * DEVELOP_BLENDIF_L_in, ramp, sizeof(ramp));
+  p.radius = options->mask_blur;
+  dt_iop_commit_params(module, module->params, &p, pipe, piece);
+  return TRUE;
+}
+
+// last level cache misses, as a measure of the memory traffic. each openmp thread counts its own, the pool
+// stays the same between parallel regions. a negative number means that they couldn't be counted.
+typedef struct dt_bench_traffic_t
+{
+  int threads;
+  int *fd;
+} dt_bench_traffic_t;
+
+static void _traffic_start(dt_bench_traffic_t *t)
+{
+  t->threads = dt_get_num_threads();
+  t->fd = malloc(sizeof(int) * t->threads);
+  int *const fd = t->fd;
+  for(int k = 0; k < t->threads; k++) fd[k] = -1;
+#ifdef __linux__
+#ifdef _OPENMP
+#pragma omp parallel default(none) shared(fd)
+#endif
+  {
+    struct perf_event_attr attr = { 0 };
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = PERF_COUNT_HW_CACHE_MISSES;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    fd[dt_get_thread_num()] = syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+#endif
+}
+
+static int64_t _traffic_stop(dt_bench_traffic_t *t)
+{
+  int64_t bytes = 0;
+  for(int k = 0; k < t->threads; k++)
+  {
+#ifdef __linux__
+    uint64_t misses;
+    if(t->fd[k] < 0 || read(t->fd[k], &misses, sizeof(misses)) != sizeof(misses))
+      bytes = -1;
+    else if(bytes >= 0)
+      bytes += misses * 64;
+    if(t->fd[k] >= 0) close(t->fd[k]);
+#else
+    bytes = -1;
+#endif
+  }
+  free(t->fd);
+  return bytes;
+}
+
+// returns the number of variants that don't agree with process(), or -1 if the module couldn't be run
+static int _test_module(dt_develop_t *dev, dt_dev_pixelpipe_t *pipe, GList *node,
+                        const dt_bench_iop_options_t *options)
+{
+  dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)node->data;
+  dt_iop_module_t *module = piece->module;
+  const int enabled = piece->enabled;
+  piece->enabled = 1;
+
+  // a small run of the whole pipe, for the buffer formats
+  dt_dev_pixelpipe_get_dimensions(pipe, dev, pipe->iwidth, pipe->iheight, &pipe->processed_width,
+                                  &pipe->processed_height);
+  const double preview = fmin(1.0, fmin(256.0 / pipe->processed_width, 256.0 / pipe->processed_height));
+  dt_dev_pixelpipe_flush_caches(pipe);
+  if(dt_dev_pixelpipe_process(pipe, dev, 0, 0, preview * pipe->processed_width + .5,
+                              preview * pipe->processed_height + .5, preview))
+  {
+    fprintf(stderr, "[bench-iop] processing the pipe for `%s' failed\n", module->op);
+    piece->enabled = enabled;
+    return -1;
+  }
+
+  dt_develop_blend_params_t blend_params = { 0 };
+  if(module->blend_params) blend_params = *module->blend_params;
+  const gboolean blend = options->blend && _blend_setup(dev, pipe, piece, options);
+
+  const double scale = options->size > 0 ? fmin(1.0, fmin(options->size / (double)piece->buf_out.width,
+                                                             options->size / (double)piece->buf_out.height))
+                                           : 1.0;
+  dt_iop_roi_t roi_out = { 0, 0, scale * piece->buf_out.width + .5, scale * piece->buf_out.height + .5, scale };
+  if(options->crop.width > 0)
+  {
+    roi_out.x = MIN(options->crop.x, roi_out.width - 1);
+    roi_out.y = MIN(options->crop.y, roi_out.height - 1);
+    roi_out.width = MIN(options->crop.width, roi_out.width - roi_out.x);
+    roi_out.height = MIN(options->crop.height, roi_out.height - roi_out.y);
+  }
+  dt_iop_roi_t roi_in = roi_out;
+  module->modify_roi_in(module, piece, &roi_out, &roi_in);
+
+  const size_t in_bpp = dt_iop_buffer_dsc_to_bpp(&piece->dsc_in);
+  const size_t out_bpp = dt_iop_buffer_dsc_to_bpp(&piece->dsc_out);
+  const size_t out_size = out_bpp * roi_out.width * roi_out.height;
+  void *input = dt_alloc_align(64, in_bpp * roi_in.width * roi_in.height);
+  void *reference = dt_alloc_align(64, out_size);
+  void *output = dt_alloc_align(64, out_size);
+  double *seconds = malloc(sizeof(double) * options->runs);
+
+  int failed = !input || !reference || !output;
+  if(!failed && options->real_input)
+    failed = _pipe_input(dev, pipe, node, input, &roi_in, in_bpp);
+  else if(!failed)
+    _synthetic_input(&piece->dsc_in, input, roi_in.width, roi_in.height);
+
+  printf("\n%s%s%s, %s pipe, %dx%d -> %dx%d, %u channel %s\n", module->op, *module->multi_name ? " " : "",
+         module->multi_name, dt_dev_pixelpipe_type_to_str(pipe->type), roi_in.width, roi_in.height,
+         roi_out.width, roi_out.height, piece->dsc_in.channels,
+         piece->dsc_in.datatype == TYPE_UINT16 ? "uint16" : "float");
+  if(failed)
+  {
+    printf("  could not set up the input\n");
+    failed = -1;
+    goto cleanup;
+  }
+
+#ifdef HAVE_OPENCL
+  pipe->devid = dt_opencl_is_enabled() ? dt_opencl_lock_device(pipe->type) : -1;
+#endif
+
+  gboolean have_reference = FALSE;
+  for(dt_bench_variant_t variant = DT_BENCH_PLAIN; variant < DT_BENCH_VARIANTS; variant++)
+  {
+    if(!_variant_available(variant, module, piece, options)) continue;
+
+    void *out = variant == DT_BENCH_PLAIN ? reference : output;
+    int r;
+    for(r = 0; r < options->runs; r++)
+    {
+      seconds[r] = _run_variant(variant, module, piece, input, out, &roi_in, &roi_out, in_bpp, out_bpp);
+      if(seconds[r] < 0.0) break;
+    }
+    if(r < options->runs)
+    {
+      printf("  %-8s failed\n", _variant_names[variant]);
+      failed++;
+      if(variant == DT_BENCH_PLAIN) break;
+      continue;
+    }
+
+    if(variant == DT_BENCH_TILING && _tiling.calls <= 1)
+    {
+      printf("  %-8s not tiled\n", _variant_names[variant]);
+      continue;
+    }
+
+    qsort(seconds, options->runs, sizeof(double), _compare_double);
+    const double median = seconds[options->runs / 2];
+    printf("  %-8s %9.1f MPix/s", _variant_names[variant],
+           roi_out.width * roi_out.height / fmax(median, 1e-9) * 1e-6);
+
+    if(variant == DT_BENCH_PLAIN)
+    {
+      printf("\n");
+      have_reference = TRUE;
+    }
+    else if(!memcmp(reference, output, out_size))
+      printf(", identical\n");
+    else
+    {
+      double max_diff;
+      size_t differing;
+      const size_t n = (size_t)roi_out.width * roi_out.height * piece->dsc_out.channels;
+      const gboolean ok = _compare(&piece->dsc_out, reference, output, n, options->tolerance, &max_diff,
+                                   &differing);
+      printf(", max difference %g", max_diff);
+      if(ok)
+        printf(", within tolerance\n");
+      else
+      {
+        printf(", %zu of %zu values differ by more than %g\n", differing, n, options->tolerance);
+        failed++;
+      }
+    }
+  }
+
+#ifdef HAVE_OPENCL
+  if(pipe->devid >= 0) dt_opencl_unlock_device(pipe->devid);
+  pipe->devid = -1;
+#endif
+
+  // the blend of process() with its input, each run on a fresh copy of the reference
+  if(blend && have_reference)
+  {
+    int64_t *traffic = malloc(sizeof(int64_t) * options->runs);
+    for(int r = 0; r < options->runs; r++)
+    {
+      memcpy(output, reference, out_size);
+      dt_bench_traffic_t t;
+      _traffic_start(&t);
+      const double start = dt_get_wtime();
+      dt_develop_blend_process(module, piece, input, output, &roi_in, &roi_out);
+      seconds[r] = dt_get_wtime() - start;
+      traffic[r] = _traffic_stop(&t);
+    }
+    qsort(seconds, options->runs, sizeof(double), _compare_double);
+    printf("  %-8s %9.1f MPix/s", "blend",
+           roi_out.width * roi_out.height / fmax(seconds[options->runs / 2], 1e-9) * 1e-6);
+    int64_t least = traffic[0];
+    for(int r = 1; r < options->runs; r++) least = (least < 0 || traffic[r] < 0) ? -1 : MIN(least, traffic[r]);
+    if(least >= 0)
+      printf(", %.1f MB from memory\n", least / (1024.0 * 1024.0));
+    else
+      printf(", memory traffic not available\n");
+    free(traffic);
+  }
+
+cleanup:
+  if(blend) dt_iop_commit_params(module, module->params, &blend_params, pipe, piece);
+  free(seconds);
+  dt_free_align(input);
+  dt_free_align(reference);
+  dt_free_align(output);
+  piece->enabled = enabled;
+  return failed;
+}
+
+static gboolean _selected(const dt_iop_module_t *module, gchar **ops)
+{
+  if(!ops) return TRUE;
+  for(gchar **op = ops; *op; op++)
+    if(!strcmp(*op, module->op)) return TRUE;
+  return FALSE;
+}
+
+int main(int argc, char *arg[])
+{
+  bindtextdomain(GETTEXT_PACKAGE, DARKTABLE_LOCALEDIR);
+  bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
+  textdomain(GETTEXT_PACKAGE);
+
+  if(!gtk_parse_args(&argc, &arg)) exit(1);
+
+  // parse command line arguments
+  char *input_filename = NULL;
+  char *xmp_filename = NULL;
+  int file_counter = 0;
+  int synthetic_width = 1536, synthetic_height = 1024;
+  gchar **ops = NULL;
+  dt_dev_pixelpipe_type_t pipe_type = DT_DEV_PIXELPIPE_EXPORT;
+  dt_bench_iop_options_t options = { .size = 1024, .runs = 3 };
+
+  int k;
+  for(k = 1; k < argc; k++)
+  {
+    if(arg[k][0] == '-')
+    {
+      if(!strcmp(arg[k], "--help"))
+      {
+        usage(arg[0]);
+        exit(1);
+      }
+      else if(!strcmp(arg[k], "--synthetic") && argc > k + 1)
+      {
+        k++;
+        if(sscanf(arg[k], "%dx%d", &synthetic_width, &synthetic_height) != 2 || synthetic_width <= 0
+           || synthetic_height <= 0)
+        {
+          fprintf(stderr, "invalid size for --synthetic: %s\n", arg[k]);
+          usage(arg[0]);
+          exit(1);
+        }
+      }
+      else if(!strcmp(arg[k], "--module") && argc > k + 1)
+      {
+        k++;
+        g_strfreev(ops);
+        ops = g_strsplit(arg[k], ",", -1);
+      }
+      else if(!strcmp(arg[k], "--pipe") && argc > k + 1)
+      {
+        k++;
+        if(!strcmp(arg[k], "export"))
+          pipe_type = DT_DEV_PIXELPIPE_EXPORT;
+        else if(!strcmp(arg[k], "full"))
+          pipe_type = DT_DEV_PIXELPIPE_FULL;
+        else if(!strcmp(arg[k], "preview"))
+          pipe_type = DT_DEV_PIXELPIPE_PREVIEW;
+        else if(!strcmp(arg[k], "thumbnail"))
+          pipe_type = DT_DEV_PIXELPIPE_THUMBNAIL;
+        else
+        {
+          fprintf(stderr, "unknown pipe type: %s\n", arg[k]);
+          usage(arg[0]);
+          exit(1);
+        }
+      }
+      else if(!strcmp(arg[k], "--size") && argc > k + 1)
+      {
+        k++;
+        options.size = MAX(atoi(arg[k]), 0);
+      }
+      else if(!strcmp(arg[k], "--roi") && argc > k + 1)
+      {
+        k++;
+        options.crop.x = options.crop.y = 0;
+        if(sscanf(arg[k], "%dx%d+%d+%d", &options.crop.width, &options.crop.height, &options.crop.x,
+                  &options.crop.y) < 2 || options.crop.width <= 0 || options.crop.height <= 0
+           || options.crop.x < 0 || options.crop.y < 0)
+        {
+          fprintf(stderr, "invalid region of interest: %s\n", arg[k]);
+          usage(arg[0]);
+          exit(1);
+        }
+      }
+      else if(!strcmp(arg[k], "--input") && argc > k + 1)
+      {
+        k++;
+        options.real_input = !strcmp(arg[k], "pipe");
+      }
+      else if(!strcmp(arg[k], "--tiling"))
+      {
+        options.tiling = TRUE;
+      }
+      else if(!strcmp(arg[k], "--blend"))
+      {
+        options.blend = TRUE;
+      }
+      else if(!strcmp(arg[k], "--mask-blur") && argc > k + 1)
+      {
+        k++;
+        options.mask_blur = g_ascii_strtod(arg[k], NULL);
+      }
+      else if(!strcmp(arg[k], "--runs") && argc > k + 1)
+      {
+        k++;
+        options.runs = MAX(atoi(arg[k]), 1);
+      }
+      else if(!strcmp(arg[k], "--tolerance") && argc > k + 1)
+      {
+        k++;
+        options.tolerance = MAX(g_ascii_strtod(arg[k], NULL), 0.0);
+      }
+      else if(!strcmp(arg[k], "--core"))
+      {
+        // everything from here on should be passed to the core
+        k++;
+        break;
+      }
+    }
+    else
+    {
+      if(file_counter == 0)
+        input_filename = arg[k];
+      else if(file_counter == 1)
+        xmp_filename = arg[k];
+      file_counter++;
+    }
+  }
+
+  int m_argc = 0;
+  char **m_arg = malloc((5 + argc - k + 1) * sizeof(char *));
+  m_arg[m_argc++] = "darktable-bench-iop";
+  m_arg[m_argc++] = "--library";
+  m_arg[m_argc++] = ":memory:";
+  m_arg[m_argc++] = "--conf";
+  m_arg[m_argc++] = "write_sidecar_files=FALSE";
+  for(; k < argc; k++) m_arg[m_argc++] = arg[k];
+  m_arg[m_argc] = NULL;
+
+  if(file_counter > 2)
+  {
+    usage(arg[0]);
+    free(m_arg);
+    exit(1);
+  }
+
+  // init dt without gui and without data.db:
+  if(dt_init(m_argc, m_arg, FALSE, FALSE, NULL))
+  {
+    free(m_arg);
+    exit(1);
+  }
+
+  // without an image the modules are set up by a synthetic one, which leaves out the raw modules
+  gchar *tmpdir = NULL;
+  gchar *synthetic_filename = NULL;
+  if(!input_filename)
+  {
+    tmpdir = g_dir_make_tmp("darktable-bench-XXXXXX", NULL);
+    if(tmpdir)
+    {
+      synthetic_filename = g_build_filename(tmpdir, "synthetic.pfm", NULL);
+      if(dt_bench_synthetic_write_pfm(synthetic_filename, synthetic_width, synthetic_height))
+      {
+        g_free(synthetic_filename);
+        synthetic_filename = NULL;
+      }
+    }
+    if(!synthetic_filename)
+    {
+      fprintf(stderr, "error: can't write the synthetic image\n");
+      free(m_arg);
+      exit(1);
+    }
+    input_filename = synthetic_filename;
+  }
+
+  dt_film_t film;
+  gchar *directory = g_path_get_dirname(input_filename);
+  const int filmid = dt_film_new(&film, directory);
+  const int imgid = dt_image_import(filmid, input_filename, TRUE);
+  g_free(directory);
+  if(!imgid)
+  {
+    fprintf(stderr, _("error: can't open file %s"), input_filename);
+    fprintf(stderr, "\n");
+    free(m_arg);
+    exit(1);
+  }
+
+  // attach xmp, if requested:
+  if(xmp_filename)
+  {
+    dt_image_t *image = dt_image_cache_get(darktable.image_cache, imgid, 'w');
+    dt_exif_xmp_read(image, xmp_filename, 1);
+    // don't write new xmp:
+    dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+  }
+
+  dt_develop_t dev;
+  dt_dev_init(&dev, 0);
+  dt_dev_load_image(&dev, imgid);
+
+  int failed = 0;
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  dt_dev_pixelpipe_t pipe;
+  int res = buf.buf && buf.width && buf.height;
+  if(res)
+  {
+    const int wd = dev.image_storage.width, ht = dev.image_storage.height;
+    switch(pipe_type)
+    {
+      case DT_DEV_PIXELPIPE_FULL:
+        res = dt_dev_pixelpipe_init(&pipe);
+        break;
+      case DT_DEV_PIXELPIPE_PREVIEW:
+        res = dt_dev_pixelpipe_init_preview(&pipe);
+        break;
+      case DT_DEV_PIXELPIPE_THUMBNAIL:
+        res = dt_dev_pixelpipe_init_thumbnail(&pipe, wd, ht);
+        break;
+      default:
+        res = dt_dev_pixelpipe_init_export(&pipe, wd, ht, IMAGEIO_RGB | IMAGEIO_FLOAT);
+        break;
+    }
+  }
+  if(!res)
+  {
+    fprintf(stderr, "error: can't set up the pixelpipe for %s\n", input_filename);
+    failed = 1;
+  }
+  else
+  {
+    // the preview pipe would get a downscaled mipmap, all the pipes get the full image here
+    dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
+    dt_dev_pixelpipe_create_nodes(&pipe, &dev);
+    dt_dev_pixelpipe_synch_all(&pipe, &dev);
+
+    int tested = 0;
+    for(GList *nodes = pipe.nodes; nodes; nodes = g_list_next(nodes))
+    {
+      dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+      if(!_selected(piece->module, ops)) continue;
+      // modules that don't apply to this image, like the raw ones for a pfm
+      if(piece->module->hide_enable_button && !piece->module->enabled)
+      {
+        if(ops) printf("\n%s doesn't apply to this image\n", piece->module->op);
+        continue;
+      }
+
+      const int res_module = _test_module(&dev, &pipe, nodes, &options);
+      if(res_module) failed++;
+      tested++;
+    }
+    printf("\n%d modules tested, %d failed or differ\n", tested, failed);
+
+    dt_dev_pixelpipe_cleanup(&pipe);
+  }
+
+  dt_dev_cleanup(&dev);
+  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  g_strfreev(ops);
+
+  dt_cleanup();
+
+  if(synthetic_filename)
+  {
+    g_unlink(synthetic_filename);
+    g_rmdir(tmpdir);
+  }
+  g_free(synthetic_filename);
+  g_free(tmpdir);
+  free(m_arg);
+
+  return failed ? 1 : 0;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
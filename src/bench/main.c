@@ -0,0 +1,594 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2018 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+/*
+ * darktable-bench runs the export pixelpipe on a set of images a number of times, at the given sizes and
+ * openmp thread counts, without gui and without touching the user's library. it reports the time the pipe
+ * took, the time spent in each module instance (from the tracer in common/profiling.h) and a checksum of the
+ * 8-bit output, so that optimizations can be checked for speed and for changed output in one go. the results
+ * can be written as json and compared against such a file from an earlier build.
+ *
+ * the images are raws (each with an optional xmp) and/or a synthetic float image, which skips the raw
+ * specific modules but needs no corpus at all. all of them run in the same process, so the peak resident
+ * memory is only reported for the run as a whole: run one configuration per invocation to compare it.
+ */
+
+#include "bench/synthetic.h"
+#include "common/darktable.h"
+#include "common/debug.h"
+#include "common/exif.h"
+#include "common/film.h"
+#include "common/image.h"
+#include "common/image_cache.h"
+#include "common/imageio.h"
+#include "common/mipmap_cache.h"
+#include "common/profiling.h"
+#include "develop/develop.h"
+#include "develop/imageop.h"
+#include "develop/pixelpipe.h"
+
+#include <glib/gstdio.h>
+#include <inttypes.h>
+#include <json-glib/json-glib.h>
+#include <libintl.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+#include "win/main_wrapper.h"
+#endif
+
+typedef struct dt_bench_input_t
+{
+  const char *filename;
+  const char *xmp_filename;   // may be NULL
+  const char *name;           // in the output and the json, "synthetic" for the synthetic image
+  int imgid;
+} dt_bench_input_t;
+
+typedef struct dt_bench_result_t
+{
+  const char *input;          // name of the dt_bench_input_t
+  int size, threads;          // requested, 0 is full size
+  int width, height;          // of the output
+  double median, min;         // seconds per run
+  gchar *checksum;            // md5 of the output of the last run
+  GList *modules;             // dt_trace_total_t of category "module", over all runs
+} dt_bench_result_t;
+
+static void usage(const char *progname)
+{
+  fprintf(stderr, "usage: %s [<input file> [<xmp file>]]... [--synthetic <width>x<height>] [--runs <n>] "
+                  "[--size <max size>[,...]] [--threads <n>[,...]] [--output <json file>] "
+                  "[--baseline <json file>] [--tolerance <percent>] [--core <darktable options>]\n",
+          progname);
+}
+
+// comma separated list of non-negative numbers
+static GArray *_parse_list(const char *str)
+{
+  GArray *list = g_array_new(FALSE, FALSE, sizeof(int));
+  gchar **tokens = g_strsplit(str, ",", -1);
+  for(gchar **t = tokens; *t; t++)
+  {
+    const int v = MAX(atoi(*t), 0);
+    g_array_append_val(list, v);
+  }
+  g_strfreev(tokens);
+  return list;
+}
+
+static gboolean _is_xmp(const char *filename)
+{
+  const size_t len = strlen(filename);
+  return len > 4 && !g_ascii_strcasecmp(filename + len - 4, ".xmp");
+}
+
+static int _compare_double(const void *a, const void *b)
+{
+  const double x = *(const double *)a, y = *(const double *)b;
+  return (x > y) - (x < y);
+}
+
+// getrusage() only knows the peak of the whole process
+static long _peak_rss()
+{
+  struct rusage ru;
+  getrusage(RUSAGE_SELF, &ru);
+#ifdef __APPLE__
+  return ru.ru_maxrss / 1024; // bytes on macOS
+#else
+  return ru.ru_maxrss;
+#endif
+}
+
+// the pipe of an export to an 8-bit format without high quality processing. returns the seconds spent in
+// dt_dev_pixelpipe_process(), or a negative number on failure.
+static double _bench_run(const int imgid, const int size, int *width, int *height, gchar **checksum)
+{
+  dt_develop_t dev;
+  dt_dev_init(&dev, 0);
+  dt_dev_load_image(&dev, imgid);
+
+  double seconds = -1.0;
+  dt_mipmap_buffer_t buf;
+  dt_mipmap_cache_get(darktable.mipmap_cache, &buf, imgid, DT_MIPMAP_FULL, DT_MIPMAP_BLOCKING, 'r');
+  if(!buf.buf || !buf.width || !buf.height)
+  {
+    fprintf(stderr, "[bench] image `%s' is not available\n", dev.image_storage.filename);
+    goto error_early;
+  }
+
+  dt_dev_pixelpipe_t pipe;
+  if(!dt_dev_pixelpipe_init_export(&pipe, dev.image_storage.width, dev.image_storage.height,
+                                   IMAGEIO_RGB | IMAGEIO_INT8))
+  {
+    fprintf(stderr, "[bench] failed to allocate the pixelpipe\n");
+    goto error_early;
+  }
+
+  dt_dev_pixelpipe_set_input(&pipe, &dev, (float *)buf.buf, buf.width, buf.height, buf.iscale);
+  dt_dev_pixelpipe_create_nodes(&pipe, &dev);
+  dt_dev_pixelpipe_synch_all(&pipe, &dev);
+  dt_dev_pixelpipe_get_dimensions(&pipe, &dev, pipe.iwidth, pipe.iheight, &pipe.processed_width,
+                                  &pipe.processed_height);
+
+  const double scale = size > 0 ? fmin(1.0, fmin(size / (double)pipe.processed_width,
+                                                 size / (double)pipe.processed_height))
+                                : 1.0;
+  *width = scale * pipe.processed_width + .5f;
+  *height = scale * pipe.processed_height + .5f;
+
+  // like the export, downscale right after demosaic instead of in finalscale
+  dt_dev_pixelpipe_iop_t *finalscale = NULL;
+  for(GList *nodes = g_list_last(pipe.nodes); nodes; nodes = g_list_previous(nodes))
+  {
+    dt_dev_pixelpipe_iop_t *node = (dt_dev_pixelpipe_iop_t *)nodes->data;
+    if(!strcmp(node->module->op, "finalscale"))
+    {
+      finalscale = node;
+      break;
+    }
+  }
+  if(finalscale) finalscale->enabled = 0;
+
+  const double start = dt_get_wtime();
+  const int failed = dt_dev_pixelpipe_process(&pipe, &dev, 0, 0, *width, *height, scale);
+  if(!failed && pipe.backbuf)
+  {
+    seconds = dt_get_wtime() - start;
+    g_free(*checksum);
+    *checksum = g_compute_checksum_for_data(G_CHECKSUM_MD5, pipe.backbuf, (size_t)4 * *width * *height);
+  }
+  else
+    fprintf(stderr, "[bench] processing the pixelpipe failed\n");
+
+  dt_dev_pixelpipe_cleanup(&pipe);
+error_early:
+  dt_dev_cleanup(&dev);
+  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+  return seconds;
+}
+
+static void _set_threads(const int threads)
+{
+  darktable.num_openmp_threads = threads;
+#ifdef _OPENMP
+  omp_set_num_threads(threads);
+#endif
+}
+
+static int _bench_config(const dt_bench_input_t *input, const int size, const int threads, const int runs,
+                         dt_bench_result_t *result)
+{
+  const int imgid = input->imgid;
+  result->input = input->name;
+  result->size = size;
+  result->threads = threads;
+  _set_threads(threads);
+
+  // the first run loads the image into the mipmap cache and isn't counted
+  if(_bench_run(imgid, size, &result->width, &result->height, &result->checksum) < 0.0) return 1;
+
+  double *seconds = malloc(sizeof(double) * runs);
+  const guint mark = dt_trace_mark();
+  for(int r = 0; r < runs; r++)
+  {
+    seconds[r] = _bench_run(imgid, size, &result->width, &result->height, &result->checksum);
+    if(seconds[r] < 0.0)
+    {
+      free(seconds);
+      return 1;
+    }
+  }
+  result->modules = dt_trace_totals(mark, "module");
+
+  qsort(seconds, runs, sizeof(double), _compare_double);
+  result->median = runs % 2 ? seconds[runs / 2] : 0.5 * (seconds[runs / 2 - 1] + seconds[runs / 2]);
+  result->min = seconds[0];
+  free(seconds);
+  return 0;
+}
+
+static void _print_result(const dt_bench_result_t *result, const int runs)
+{
+  printf("\n%s, %dx%d, %d threads: median %.3f secs, min %.3f secs, output %s\n", result->input, result->width,
+         result->height, result->threads, result->median, result->min, result->checksum);
+  for(const GList *iter = result->modules; iter; iter = g_list_next(iter))
+  {
+    const dt_trace_total_t *total = (dt_trace_total_t *)iter->data;
+    printf("  %-24s %9.3f ms\n", total->name, total->duration / 1000.0 / runs);
+  }
+}
+
+static int _write_json(const char *filename, const int runs, GList *results, const long peak_rss)
+{
+  JsonBuilder *builder = json_builder_new();
+  json_builder_begin_object(builder);
+  json_builder_set_member_name(builder, "version");
+  json_builder_add_string_value(builder, darktable_package_version);
+  json_builder_set_member_name(builder, "runs");
+  json_builder_add_int_value(builder, runs);
+  json_builder_set_member_name(builder, "peak_rss_kb");
+  json_builder_add_int_value(builder, peak_rss);
+
+  json_builder_set_member_name(builder, "results");
+  json_builder_begin_array(builder);
+  for(const GList *iter = results; iter; iter = g_list_next(iter))
+  {
+    const dt_bench_result_t *result = (dt_bench_result_t *)iter->data;
+    json_builder_begin_object(builder);
+    json_builder_set_member_name(builder, "input");
+    json_builder_add_string_value(builder, result->input);
+    json_builder_set_member_name(builder, "size");
+    json_builder_add_int_value(builder, result->size);
+    json_builder_set_member_name(builder, "threads");
+    json_builder_add_int_value(builder, result->threads);
+    json_builder_set_member_name(builder, "width");
+    json_builder_add_int_value(builder, result->width);
+    json_builder_set_member_name(builder, "height");
+    json_builder_add_int_value(builder, result->height);
+    json_builder_set_member_name(builder, "median_ms");
+    json_builder_add_double_value(builder, result->median * 1000.0);
+    json_builder_set_member_name(builder, "min_ms");
+    json_builder_add_double_value(builder, result->min * 1000.0);
+    json_builder_set_member_name(builder, "checksum");
+    json_builder_add_string_value(builder, result->checksum);
+    json_builder_set_member_name(builder, "modules");
+    json_builder_begin_object(builder);
+    for(const GList *m = result->modules; m; m = g_list_next(m))
+    {
+      const dt_trace_total_t *total = (dt_trace_total_t *)m->data;
+      json_builder_set_member_name(builder, total->name);
+      json_builder_add_double_value(builder, total->duration / 1000.0 / runs);
+    }
+    json_builder_end_object(builder);
+    json_builder_end_object(builder);
+  }
+  json_builder_end_array(builder);
+  json_builder_end_object(builder);
+
+  JsonGenerator *generator = json_generator_new();
+  json_generator_set_pretty(generator, TRUE);
+  json_generator_set_root(generator, json_builder_get_root(builder));
+  GError *error = NULL;
+  const gboolean ok = json_generator_to_file(generator, filename, &error);
+  if(!ok)
+  {
+    fprintf(stderr, "[bench] could not write `%s': %s\n", filename, error->message);
+    g_error_free(error);
+  }
+  g_object_unref(generator);
+  g_object_unref(builder);
+  return !ok;
+}
+
+// returns the number of results that got slower than the tolerance or changed their output
+static int _compare_baseline(const char *filename, GList *results, const double tolerance)
+{
+  GError *error = NULL;
+  JsonParser *parser = json_parser_new();
+  if(!json_parser_load_from_file(parser, filename, &error))
+  {
+    fprintf(stderr, "[bench] could not read baseline `%s': %s\n", filename, error->message);
+    g_error_free(error);
+    g_object_unref(parser);
+    return 1;
+  }
+
+  JsonNode *root = json_parser_get_root(parser);
+  JsonArray *baseline = NULL;
+  if(root && JSON_NODE_HOLDS_OBJECT(root) && json_object_has_member(json_node_get_object(root), "results"))
+    baseline = json_object_get_array_member(json_node_get_object(root), "results");
+  if(!baseline)
+  {
+    fprintf(stderr, "[bench] `%s' is not a darktable-bench result\n", filename);
+    g_object_unref(parser);
+    return 1;
+  }
+
+  printf("\ncompared to %s:\n", filename);
+  int regressions = 0;
+  for(const GList *iter = results; iter; iter = g_list_next(iter))
+  {
+    const dt_bench_result_t *result = (dt_bench_result_t *)iter->data;
+    JsonObject *match = NULL;
+    for(guint k = 0; k < json_array_get_length(baseline) && !match; k++)
+    {
+      JsonObject *b = json_array_get_object_element(baseline, k);
+      if(json_object_has_member(b, "input")
+         && !g_strcmp0(json_object_get_string_member(b, "input"), result->input)
+         && json_object_get_int_member(b, "size") == result->size
+         && json_object_get_int_member(b, "threads") == result->threads)
+        match = b;
+    }
+    if(!match)
+    {
+      printf("  %s, size %d, %d threads: not in the baseline\n", result->input, result->size, result->threads);
+      continue;
+    }
+
+    const double before = json_object_get_double_member(match, "median_ms");
+    const double change = before > 0.0 ? 100.0 * (result->median * 1000.0 - before) / before : 0.0;
+    const gboolean same_output = !g_strcmp0(json_object_get_string_member(match, "checksum"), result->checksum);
+    const gboolean slower = change > tolerance;
+    printf("  %s, size %d, %d threads: %.3f -> %.3f ms (%+.1f%%)%s%s\n", result->input, result->size,
+           result->threads, before, result->median * 1000.0, change, slower ? ", slower" : "",
+           same_output ? "" : ", output changed");
+    if(slower || !same_output) regressions++;
+  }
+
+  g_object_unref(parser);
+  return regressions;
+}
+
+int main(int argc, char *arg[])
+{
+  bindtextdomain(GETTEXT_PACKAGE, DARKTABLE_LOCALEDIR);
+  bind_textdomain_codeset(GETTEXT_PACKAGE, "UTF-8");
+  textdomain(GETTEXT_PACKAGE);
+
+  if(!gtk_parse_args(&argc, &arg)) exit(1);
+
+  // parse command line arguments
+  GArray *inputs = g_array_new(FALSE, TRUE, sizeof(dt_bench_input_t));
+  char *output_filename = NULL;
+  char *baseline_filename = NULL;
+  int synthetic_width = 0, synthetic_height = 0;
+  int runs = 5;
+  double tolerance = 5.0;
+  GArray *sizes = NULL, *threads = NULL;
+
+  int k;
+  for(k = 1; k < argc; k++)
+  {
+    if(arg[k][0] == '-')
+    {
+      if(!strcmp(arg[k], "--help"))
+      {
+        usage(arg[0]);
+        exit(1);
+      }
+      else if(!strcmp(arg[k], "--synthetic") && argc > k + 1)
+      {
+        k++;
+        if(sscanf(arg[k], "%dx%d", &synthetic_width, &synthetic_height) != 2 || synthetic_width <= 0
+           || synthetic_height <= 0)
+        {
+          fprintf(stderr, "invalid size for --synthetic: %s\n", arg[k]);
+          usage(arg[0]);
+          exit(1);
+        }
+      }
+      else if(!strcmp(arg[k], "--runs") && argc > k + 1)
+      {
+        k++;
+        runs = MAX(atoi(arg[k]), 1);
+      }
+      else if(!strcmp(arg[k], "--size") && argc > k + 1)
+      {
+        k++;
+        if(sizes) g_array_free(sizes, TRUE);
+        sizes = _parse_list(arg[k]);
+      }
+      else if(!strcmp(arg[k], "--threads") && argc > k + 1)
+      {
+        k++;
+        if(threads) g_array_free(threads, TRUE);
+        threads = _parse_list(arg[k]);
+      }
+      else if(!strcmp(arg[k], "--output") && argc > k + 1)
+      {
+        k++;
+        output_filename = arg[k];
+      }
+      else if(!strcmp(arg[k], "--baseline") && argc > k + 1)
+      {
+        k++;
+        baseline_filename = arg[k];
+      }
+      else if(!strcmp(arg[k], "--tolerance") && argc > k + 1)
+      {
+        k++;
+        tolerance = MAX(g_ascii_strtod(arg[k], NULL), 0.0);
+      }
+      else if(!strcmp(arg[k], "--core"))
+      {
+        // everything from here on should be passed to the core
+        k++;
+        break;
+      }
+    }
+    else if(inputs->len && _is_xmp(arg[k])
+            && !g_array_index(inputs, dt_bench_input_t, inputs->len - 1).xmp_filename)
+    {
+      // an xmp goes with the image in front of it
+      g_array_index(inputs, dt_bench_input_t, inputs->len - 1).xmp_filename = arg[k];
+    }
+    else
+    {
+      const dt_bench_input_t input = { arg[k], NULL, arg[k], 0 };
+      g_array_append_val(inputs, input);
+    }
+  }
+
+  int m_argc = 0;
+  char **m_arg = malloc((5 + argc - k + 1) * sizeof(char *));
+  m_arg[m_argc++] = "darktable-bench";
+  m_arg[m_argc++] = "--library";
+  m_arg[m_argc++] = ":memory:";
+  m_arg[m_argc++] = "--conf";
+  m_arg[m_argc++] = "write_sidecar_files=FALSE";
+  for(; k < argc; k++) m_arg[m_argc++] = arg[k];
+  m_arg[m_argc] = NULL;
+
+  if(inputs->len == 0 && synthetic_width == 0)
+  {
+    usage(arg[0]);
+    free(m_arg);
+    exit(1);
+  }
+
+  // init dt without gui and without data.db:
+  if(dt_init(m_argc, m_arg, FALSE, FALSE, NULL))
+  {
+    free(m_arg);
+    exit(1);
+  }
+
+  // only keep the spans for the module timings, unless a trace file was asked for with --core --trace
+  if(!dt_trace_on) dt_trace_init(NULL);
+
+  if(!sizes)
+  {
+    sizes = g_array_new(FALSE, FALSE, sizeof(int));
+    const int full = 0;
+    g_array_append_val(sizes, full);
+  }
+  if(!threads)
+  {
+    threads = g_array_new(FALSE, FALSE, sizeof(int));
+    g_array_append_val(threads, darktable.num_openmp_threads);
+  }
+
+  gchar *tmpdir = NULL;
+  gchar *synthetic_filename = NULL;
+  if(synthetic_width)
+  {
+    tmpdir = g_dir_make_tmp("darktable-bench-XXXXXX", NULL);
+    if(tmpdir)
+    {
+      synthetic_filename = g_strdup_printf("%s%ssynthetic_%dx%d.pfm", tmpdir, G_DIR_SEPARATOR_S, synthetic_width,
+                                           synthetic_height);
+      if(dt_bench_synthetic_write_pfm(synthetic_filename, synthetic_width, synthetic_height))
+      {
+        g_free(synthetic_filename);
+        synthetic_filename = NULL;
+      }
+    }
+    if(!synthetic_filename)
+    {
+      fprintf(stderr, "error: can't write the synthetic image\n");
+      free(m_arg);
+      exit(1);
+    }
+    const dt_bench_input_t input = { synthetic_filename, NULL, "synthetic", 0 };
+    g_array_append_val(inputs, input);
+  }
+
+  for(guint i = 0; i < inputs->len; i++)
+  {
+    dt_bench_input_t *input = &g_array_index(inputs, dt_bench_input_t, i);
+    dt_film_t film;
+    gchar *directory = g_path_get_dirname(input->filename);
+    const int filmid = dt_film_new(&film, directory);
+    input->imgid = dt_image_import(filmid, input->filename, TRUE);
+    g_free(directory);
+    if(!input->imgid)
+    {
+      fprintf(stderr, _("error: can't open file %s"), input->filename);
+      fprintf(stderr, "\n");
+      free(m_arg);
+      exit(1);
+    }
+
+    // attach xmp, if requested:
+    if(input->xmp_filename)
+    {
+      dt_image_t *image = dt_image_cache_get(darktable.image_cache, input->imgid, 'w');
+      dt_exif_xmp_read(image, input->xmp_filename, 1);
+      // don't write new xmp:
+      dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+    }
+  }
+
+  printf("%u image%s, %d runs each\n", inputs->len, inputs->len > 1 ? "s" : "", runs);
+
+  const int default_threads = darktable.num_openmp_threads;
+  GList *results = NULL;
+  int failed = 0;
+  for(guint i = 0; i < inputs->len && !failed; i++)
+    for(guint s = 0; s < sizes->len && !failed; s++)
+      for(guint t = 0; t < threads->len && !failed; t++)
+      {
+        const int n = g_array_index(threads, int, t) ? g_array_index(threads, int, t) : default_threads;
+        dt_bench_result_t *result = calloc(1, sizeof(dt_bench_result_t));
+        failed = _bench_config(&g_array_index(inputs, dt_bench_input_t, i), g_array_index(sizes, int, s), n,
+                               runs, result);
+        if(!failed) _print_result(result, runs);
+        results = g_list_append(results, result);
+      }
+  _set_threads(default_threads);
+
+  const long peak_rss = _peak_rss();
+  if(!failed) printf("\npeak rss of the whole run %ld kB\n", peak_rss);
+
+  if(!failed && output_filename) failed = _write_json(output_filename, runs, results, peak_rss);
+  if(!failed && baseline_filename) failed = _compare_baseline(baseline_filename, results, tolerance);
+
+  for(GList *iter = results; iter; iter = g_list_next(iter))
+  {
+    dt_bench_result_t *result = (dt_bench_result_t *)iter->data;
+    g_list_free_full(result->modules, g_free);
+    g_free(result->checksum);
+    free(result);
+  }
+  g_list_free(results);
+  g_array_free(sizes, TRUE);
+  g_array_free(threads, TRUE);
+  g_array_free(inputs, TRUE);
+
+  dt_cleanup();
+
+  if(synthetic_filename)
+  {
+    g_unlink(synthetic_filename);
+    g_rmdir(tmpdir);
+  }
+  g_free(synthetic_filename);
+  g_free(tmpdir);
+  free(m_arg);
+
+  return failed ? 1 : 0;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
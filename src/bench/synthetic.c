@@ -0,0 +1,68 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2018 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bench/synthetic.h"
+
+#include <glib/gstdio.h>
+#include <math.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+void dt_bench_synthetic_fill(float *buf, const int width, const int height, const int ch, uint32_t seed)
+{
+  // a plain lcg, rand() differs between c libraries
+  uint32_t state = seed ? seed : 0x2545f491;
+  for(int j = 0; j < height; j++)
+    for(int i = 0; i < width; i++)
+    {
+      const float x = i / (float)width, y = j / (float)height;
+      const float gradient[4] = { x * x, 0.5f * (x + y), y, 0.0f };
+      float *out = buf + ((size_t)j * width + i) * ch;
+      for(int c = 0; c < ch; c++)
+      {
+        state = state * 1664525u + 1013904223u;
+        const float noise = ((state >> 8) / (float)(1 << 24) - 0.5f) * 0.02f;
+        // single channel buffers get the mid gradient, the fourth channel stays 0
+        const float g = ch == 1 ? gradient[1] : gradient[c];
+        out[c] = c == 3 ? 0.0f : fmaxf(0.0f, g + noise);
+      }
+    }
+}
+
+int dt_bench_synthetic_write_pfm(const char *filename, const int width, const int height)
+{
+  float *buf = malloc(sizeof(float) * 3 * width * height);
+  FILE *f = buf ? g_fopen(filename, "wb") : NULL;
+  if(!f)
+  {
+    free(buf);
+    return 1;
+  }
+
+  dt_bench_synthetic_fill(buf, width, height, 3, 0);
+  fprintf(f, "PF\n%d %d\n-1.0\n", width, height);
+  const size_t written = fwrite(buf, sizeof(float) * 3, (size_t)width * height, f);
+  free(buf);
+  fclose(f);
+  return written != (size_t)width * height;
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -0,0 +1,31 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2018 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+// fill width x height pixels of ch floats with smooth gradients plus a little noise, in [0, 1] roughly. the
+// same seed gives the same pixels on every machine, so outputs can be compared between builds.
+void dt_bench_synthetic_fill(float *buf, const int width, const int height, const int ch, uint32_t seed);
+// write such an image with three channels to a pfm file, which can be imported. returns 0 on success.
+int dt_bench_synthetic_write_pfm(const char *filename, const int width, const int height);
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
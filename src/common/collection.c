@@ -59,6 +59,13 @@ static uint32_t _dt_collection_compute_count(const dt_collection_t *collection);
  * we need 2 different since there are different kinds of signals we need to listen to. */
 static void _dt_collection_recount_callback_1(gpointer instace, gpointer user_data);
 static void _dt_collection_recount_callback_2(gpointer instance, uint8_t id, gpointer user_data);
+/* tag changes only need a recount if the query looks at tags, single imports only test the new image */
+static void _dt_collection_tag_changed_callback(gpointer instance, gpointer user_data);
+static void _dt_collection_image_import_callback(gpointer instance, guint imgid, gpointer user_data);
+/* drops the id snapshot whenever someone else changed the collection */
+static void _dt_collection_changed_callback(gpointer instance, gpointer user_data);
+/* makes sure the id snapshot matches the current query */
+static void _dt_collection_load_ids(const dt_collection_t *collection);
 
 /* determine image offset of specified imgid for the given collection */
 static int dt_collection_image_offset_with_collection(const dt_collection_t *collection, int imgid);
@@ -67,6 +74,9 @@ const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
 {
   dt_collection_t *collection = g_malloc0(sizeof(dt_collection_t));
 
+  dt_pthread_mutex_init(&collection->ids_lock, NULL);
+  collection->ids_position = g_hash_table_new(NULL, NULL);
+
   /* initialize collection context*/
   if(clone) /* if clone is provided let's copy it into this context */
   {
@@ -74,6 +84,8 @@ const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
     memcpy(&collection->store, &clone->store, sizeof(dt_collection_params_t));
     collection->where_ext = g_strdup(clone->where_ext);
     collection->query = g_strdup(clone->query);
+    collection->select_query = g_strdup(clone->select_query);
+    collection->depends_on = clone->depends_on;
     collection->clone = 1;
     collection->count = clone->count;
   }
@@ -83,17 +95,20 @@ const dt_collection_t *dt_collection_new(const dt_collection_t *clone)
   /* connect to all the signals that might indicate that the count of images matching the collection changed
    */
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_TAG_CHANGED,
-                            G_CALLBACK(_dt_collection_recount_callback_1), collection);
+                            G_CALLBACK(_dt_collection_tag_changed_callback), collection);
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_FILMROLLS_CHANGED,
                             G_CALLBACK(_dt_collection_recount_callback_1), collection);
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_FILMROLLS_REMOVED,
                             G_CALLBACK(_dt_collection_recount_callback_1), collection);
 
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_IMAGE_IMPORT,
-                            G_CALLBACK(_dt_collection_recount_callback_2), collection);
+                            G_CALLBACK(_dt_collection_image_import_callback), collection);
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_FILMROLLS_IMPORTED,
                             G_CALLBACK(_dt_collection_recount_callback_2), collection);
 
+  dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED,
+                            G_CALLBACK(_dt_collection_changed_callback), collection);
+
   return collection;
 }
 
@@ -103,7 +118,17 @@ void dt_collection_free(const dt_collection_t *collection)
                                (gpointer)collection);
   dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_dt_collection_recount_callback_2),
                                (gpointer)collection);
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_dt_collection_tag_changed_callback),
+                               (gpointer)collection);
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_dt_collection_image_import_callback),
+                               (gpointer)collection);
+  dt_control_signal_disconnect(darktable.signals, G_CALLBACK(_dt_collection_changed_callback),
+                               (gpointer)collection);
 
+  dt_pthread_mutex_destroy(&((dt_collection_t *)collection)->ids_lock);
+  g_hash_table_destroy(collection->ids_position);
+  g_free(collection->ids);
+  g_free(collection->select_query);
   g_free(collection->query);
   g_free(collection->where_ext);
   g_free((dt_collection_t *)collection);
@@ -200,6 +225,16 @@ int dt_collection_update(const dt_collection_t *collection)
                         (collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT) ? " " LIMIT_QUERY : "");
   result = _dt_collection_store(collection, query);
 
+  /* remember what the query depends on so image changes can be handled without counting everything again.
+   * both the rating filters and the rating sort use "flags & 7", the remove flag test doesn't. */
+  dt_collection_t *c = (dt_collection_t *)collection;
+  g_free(c->select_query);
+  c->select_query = g_strdup(selq);
+  c->depends_on = 0;
+  if(strstr(query, "flags & 7")) c->depends_on |= DT_COLLECTION_CHANGE_RATING;
+  if(strstr(query, "color_labels")) c->depends_on |= DT_COLLECTION_CHANGE_COLORLABEL;
+  if(strstr(query, "tagged_images") || strstr(query, "data.tags")) c->depends_on |= DT_COLLECTION_CHANGE_TAG;
+
   /* free memory used */
   g_free(sq);
   g_free(wq);
@@ -209,6 +244,7 @@ int dt_collection_update(const dt_collection_t *collection)
   /* update the cached count. collection isn't a real const anyway, we are writing to it in
    * _dt_collection_store, too. */
   ((dt_collection_t *)collection)->count = _dt_collection_compute_count(collection);
+  dt_collection_invalidate(collection);
   dt_collection_hint_message(collection);
 
   return result;
@@ -515,26 +551,216 @@ GList *dt_collection_get_all(const dt_collection_t *collection, int limit)
   return list;
 }
 
-int dt_collection_get_nth(const dt_collection_t *collection, int nth)
+void dt_collection_invalidate(const dt_collection_t *collection)
 {
-  if(nth < 0 || nth >= dt_collection_get_count(collection))
-    return -1;
+  dt_collection_t *c = (dt_collection_t *)collection;
+  dt_pthread_mutex_lock(&c->ids_lock);
+  c->ids_valid = FALSE;
+  dt_pthread_mutex_unlock(&c->ids_lock);
+}
+
+static void _dt_collection_load_ids(const dt_collection_t *collection)
+{
+  dt_collection_t *c = (dt_collection_t *)collection;
+
+  // make sure the query exists before we take the lock, building it might end up in here again
   const gchar *query = dt_collection_get_query(collection);
+
+  dt_pthread_mutex_lock(&c->ids_lock);
+  if(c->ids_valid || !query)
+  {
+    dt_pthread_mutex_unlock(&c->ids_lock);
+    return;
+  }
+
+  const double start = dt_get_wtime();
   sqlite3_stmt *stmt = NULL;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, nth);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, 1);
+  if(collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT)
+  {
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
+  }
+
+  g_hash_table_remove_all(c->ids_position);
+  c->ids_count = 0;
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    const int32_t id = sqlite3_column_int(stmt, 0);
+    if(c->ids_count == c->ids_alloc)
+    {
+      c->ids_alloc = MAX(2 * c->ids_alloc, 1024);
+      c->ids = g_realloc(c->ids, sizeof(int32_t) * c->ids_alloc);
+    }
+    c->ids[c->ids_count++] = id;
+    g_hash_table_insert(c->ids_position, GINT_TO_POINTER(id), GUINT_TO_POINTER(c->ids_count));
+  }
+  sqlite3_finalize(stmt);
+  c->ids_valid = TRUE;
 
+  dt_print(DT_DEBUG_PERF, "[collection] loaded %u image ids in %.3f secs\n", c->ids_count,
+           dt_get_wtime() - start);
+
+  dt_pthread_mutex_unlock(&c->ids_lock);
+}
+
+int dt_collection_get_nth(const dt_collection_t *collection, int nth)
+{
+  if(nth < 0) return -1;
+  _dt_collection_load_ids(collection);
+
+  dt_collection_t *c = (dt_collection_t *)collection;
   int result = -1;
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  dt_pthread_mutex_lock(&c->ids_lock);
+  if(nth < (int)c->ids_count) result = c->ids[nth];
+  dt_pthread_mutex_unlock(&c->ids_lock);
+
+  return result;
+}
+
+int dt_collection_get_range(const dt_collection_t *collection, int offset, int count, int32_t *ids)
+{
+  if(count <= 0) return 0;
+  offset = MAX(offset, 0);
+  _dt_collection_load_ids(collection);
+
+  dt_collection_t *c = (dt_collection_t *)collection;
+  int copied = 0;
+  dt_pthread_mutex_lock(&c->ids_lock);
+  if(offset < (int)c->ids_count)
   {
-    result  = sqlite3_column_int(stmt, 0);
+    copied = MIN(count, (int)c->ids_count - offset);
+    memcpy(ids, c->ids + offset, sizeof(int32_t) * copied);
   }
+  dt_pthread_mutex_unlock(&c->ids_lock);
+
+  return copied;
+}
+
+int dt_collection_get_position(const dt_collection_t *collection, int imgid)
+{
+  _dt_collection_load_ids(collection);
+
+  dt_collection_t *c = (dt_collection_t *)collection;
+  dt_pthread_mutex_lock(&c->ids_lock);
+  const int position = GPOINTER_TO_UINT(g_hash_table_lookup(c->ids_position, GINT_TO_POINTER(imgid))) - 1;
+  dt_pthread_mutex_unlock(&c->ids_lock);
 
+  return position;
+}
+
+/* runs the query restricted to imgid, or to the selected images if imgid <= 0. sqlite pushes the id test down
+ * into the query, so this only looks at those images. */
+static GHashTable *_dt_collection_matching_images(const dt_collection_t *collection, const int imgid)
+{
+  GHashTable *matching = g_hash_table_new(NULL, NULL);
+  sqlite3_stmt *stmt = NULL;
+  gchar *query = dt_util_dstrcat(NULL, "SELECT id FROM (%s) WHERE id %s", collection->select_query,
+                                 imgid > 0 ? "= ?1" : "IN (SELECT imgid FROM main.selected_images)");
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
+  if(imgid > 0) DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+    g_hash_table_add(matching, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
   sqlite3_finalize(stmt);
+  g_free(query);
+  return matching;
+}
 
-  return result;
+void dt_collection_images_changed(const dt_collection_t *collection, const dt_collection_change_t change,
+                                  const int imgid)
+{
+  dt_collection_t *c = (dt_collection_t *)collection;
+
+  // nothing in the query looks at what changed, so count and snapshot are still good
+  if(!(c->depends_on & change) || !c->select_query)
+  {
+    dt_collection_hint_message(collection);
+    return;
+  }
+
+  const double start = dt_get_wtime();
+
+  GList *changed = NULL;
+  if(imgid > 0)
+    changed = g_list_prepend(changed, GINT_TO_POINTER(imgid));
+  else
+  {
+    sqlite3_stmt *stmt = NULL;
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT imgid FROM main.selected_images", -1,
+                                &stmt, NULL);
+    while(sqlite3_step(stmt) == SQLITE_ROW)
+      changed = g_list_prepend(changed, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+    sqlite3_finalize(stmt);
+  }
+  GHashTable *matching = _dt_collection_matching_images(collection, imgid);
+
+  const gboolean resort = (change & DT_COLLECTION_CHANGE_RATING && c->params.sort == DT_COLLECTION_SORT_RATING)
+                          || (change & DT_COLLECTION_CHANGE_COLORLABEL
+                              && c->params.sort == DT_COLLECTION_SORT_COLOR);
+  int joined = 0, left = 0;
 
+  dt_pthread_mutex_lock(&c->ids_lock);
+  if(!c->ids_valid)
+  {
+    // we don't know which of the images were part of the collection before, count everything
+    dt_pthread_mutex_unlock(&c->ids_lock);
+    c->count = _dt_collection_compute_count(collection);
+    dt_collection_invalidate(collection);
+  }
+  else
+  {
+    GHashTable *gone = g_hash_table_new(NULL, NULL);
+    for(const GList *l = changed; l; l = g_list_next(l))
+    {
+      const gboolean was_in = g_hash_table_contains(c->ids_position, l->data);
+      const gboolean is_in = g_hash_table_contains(matching, l->data);
+      if(is_in && !was_in)
+        joined++;
+      else if(was_in && !is_in)
+      {
+        left++;
+        g_hash_table_add(gone, l->data);
+      }
+    }
+    c->count = c->count + joined - left;
+
+    if(joined || resort)
+    {
+      // new images need their place in the sort order, leave that to the database
+      c->ids_valid = FALSE;
+    }
+    else if(left)
+    {
+      // just drop the images from the snapshot, everything else keeps its order
+      uint32_t k = 0;
+      for(uint32_t i = 0; i < c->ids_count; i++)
+      {
+        const gpointer id = GINT_TO_POINTER(c->ids[i]);
+        if(g_hash_table_contains(gone, id))
+          g_hash_table_remove(c->ids_position, id);
+        else
+        {
+          if(k != i)
+          {
+            c->ids[k] = c->ids[i];
+            g_hash_table_insert(c->ids_position, id, GUINT_TO_POINTER(k + 1));
+          }
+          k++;
+        }
+      }
+      c->ids_count = k;
+    }
+    dt_pthread_mutex_unlock(&c->ids_lock);
+    g_hash_table_destroy(gone);
+  }
+
+  dt_print(DT_DEBUG_PERF, "[collection] %d changed images, %d joined and %d left the collection in %.3f secs\n",
+           g_list_length(changed), joined, left, dt_get_wtime() - start);
+
+  g_hash_table_destroy(matching);
+  g_list_free(changed);
+
+  dt_collection_hint_message(collection);
 }
 
 GList *dt_collection_get_selected(const dt_collection_t *collection, int limit)
@@ -882,17 +1108,19 @@ static gchar *get_query_string(const dt_collection_properties_t property, const
         query = dt_util_dstrcat(query, "(1=1)");
       else
       {
-        // Start query with a false statement to avoid special casing the first condition
-        query = dt_util_dstrcat(query, "((1=0)");
+        // no leading (1=0) here, a constant term in the OR keeps sqlite from using images_maker_model_index
+        query = dt_util_dstrcat(query, "(");
         GList *lists = NULL;
         dt_collection_get_makermodel(text, NULL, &lists);
+        if(!lists) query = dt_util_dstrcat(query, "1=0");
         GList *element = lists;
         while (element)
         {
           GList *tuple = element->data;
           char *mk = sqlite3_mprintf("%q", tuple->data);
           char *md = sqlite3_mprintf("%q", tuple->next->data);
-          query = dt_util_dstrcat(query, " OR (maker = '%s' AND model = '%s')", mk, md);
+          query = dt_util_dstrcat(query, "%s(maker = '%s' AND model = '%s')", element == lists ? "" : " OR ", mk,
+                                  md);
           sqlite3_free(mk);
           sqlite3_free(md);
           g_free(tuple->data);
@@ -1255,39 +1483,8 @@ void dt_collection_hint_message(const dt_collection_t *collection)
 
 static int dt_collection_image_offset_with_collection(const dt_collection_t *collection, int imgid)
 {
-  const gchar *qin = dt_collection_get_query(collection);
-  int offset = 0;
-  sqlite3_stmt *stmt;
-
-  if(qin)
-  {
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), qin, -1, &stmt, NULL);
-
-    // was the limit portion of the query tacked on?
-    if(collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT)
-    {
-      DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
-      DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
-    }
-
-    gboolean found = FALSE;
-
-    while(sqlite3_step(stmt) == SQLITE_ROW)
-    {
-      int id = sqlite3_column_int(stmt, 0);
-      if(imgid == id)
-      {
-        found = TRUE;
-        break;
-      }
-      offset++;
-    }
-
-    if(!found) offset = 0;
-
-    sqlite3_finalize(stmt);
-  }
-  return offset;
+  const int offset = dt_collection_get_position(collection, imgid);
+  return offset < 0 ? 0 : offset;
 }
 
 int dt_collection_image_offset(int imgid)
@@ -1300,6 +1497,7 @@ static void _dt_collection_recount_callback_1(gpointer instace, gpointer user_da
   dt_collection_t *collection = (dt_collection_t *)user_data;
   int old_count = collection->count;
   collection->count = _dt_collection_compute_count(collection);
+  dt_collection_invalidate(collection);
   if(!collection->clone)
   {
     if(old_count != collection->count) dt_collection_hint_message(collection);
@@ -1312,6 +1510,7 @@ static void _dt_collection_recount_callback_2(gpointer instance, uint8_t id, gpo
   dt_collection_t *collection = (dt_collection_t *)user_data;
   int old_count = collection->count;
   collection->count = _dt_collection_compute_count(collection);
+  dt_collection_invalidate(collection);
   if(!collection->clone)
   {
     if(old_count != collection->count) dt_collection_hint_message(collection);
@@ -1319,6 +1518,46 @@ static void _dt_collection_recount_callback_2(gpointer instance, uint8_t id, gpo
   }
 }
 
+static void _dt_collection_tag_changed_callback(gpointer instance, gpointer user_data)
+{
+  dt_collection_t *collection = (dt_collection_t *)user_data;
+
+  // the collect module and others have their own handlers for the tag list itself
+  if(!(collection->depends_on & DT_COLLECTION_CHANGE_TAG)) return;
+
+  _dt_collection_recount_callback_1(instance, user_data);
+}
+
+static void _dt_collection_image_import_callback(gpointer instance, guint imgid, gpointer user_data)
+{
+  dt_collection_t *collection = (dt_collection_t *)user_data;
+
+  if(!collection->select_query)
+  {
+    _dt_collection_recount_callback_2(instance, 0, user_data);
+    return;
+  }
+
+  // a new image can only add itself to the collection
+  GHashTable *matching = _dt_collection_matching_images(collection, imgid);
+  const gboolean joined = g_hash_table_size(matching) > 0;
+  g_hash_table_destroy(matching);
+  if(!joined) return;
+
+  collection->count++;
+  dt_collection_invalidate(collection);
+  if(!collection->clone)
+  {
+    dt_collection_hint_message(collection);
+    dt_control_signal_raise(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED);
+  }
+}
+
+static void _dt_collection_changed_callback(gpointer instance, gpointer user_data)
+{
+  dt_collection_invalidate((dt_collection_t *)user_data);
+}
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -18,6 +18,7 @@
 
 #pragma once
 
+#include "common/dtpthread.h"
 #include <glib.h>
 #include <inttypes.h>
 
@@ -102,6 +103,13 @@ typedef enum dt_collection_rating_comperator_t
   DT_COLLECTION_RATING_N_COMPS = 6
 } dt_collection_rating_comperator_t;
 
+typedef enum dt_collection_change_t
+{
+  DT_COLLECTION_CHANGE_RATING = 1 << 0,     // star rating or rejected state of images
+  DT_COLLECTION_CHANGE_COLORLABEL = 1 << 1, // color labels attached to images
+  DT_COLLECTION_CHANGE_TAG = 1 << 2         // tags attached to images
+} dt_collection_change_t;
+
 typedef struct dt_collection_params_t
 {
   /** flags for which query parts to use, see COLLECTION_QUERY_x defines... */
@@ -131,6 +139,18 @@ typedef struct dt_collection_t
   unsigned int count;
   dt_collection_params_t params;
   dt_collection_params_t store;
+
+  /** snapshot of the collected image ids in query order, materialized on first use after a change */
+  dt_pthread_mutex_t ids_lock;
+  int32_t *ids;
+  uint32_t ids_count, ids_alloc;
+  GHashTable *ids_position; // imgid -> position + 1
+  gboolean ids_valid;
+
+  /** the query without sort and limit, used to test single images against it, and the
+   * dt_collection_change_t flags of everything the query looks at */
+  gchar *select_query;
+  uint32_t depends_on;
 } dt_collection_t;
 
 
@@ -184,8 +204,20 @@ gchar *dt_collection_get_sort_query(const dt_collection_t *collection);
 
 /** get the count of query */
 uint32_t dt_collection_get_count(const dt_collection_t *collection);
-/** get the nth image in the query */
+/** drop the snapshot of collected image ids, call this when something changed that the query depends on */
+void dt_collection_invalidate(const dt_collection_t *collection);
+/** some images changed in the way given by change, imgid is the image or -1 for the selected images. instead
+ * of counting the whole collection again only the changed images are tested against the query, and the
+ * snapshot is kept when neither their membership nor the sort order changed. */
+void dt_collection_images_changed(const dt_collection_t *collection, const dt_collection_change_t change,
+                                  const int imgid);
+/** get the nth image in the query, -1 if out of range */
 int dt_collection_get_nth(const dt_collection_t *collection, int nth);
+/** copy up to count image ids starting at offset into ids, returns how many were copied. a negative offset
+ * counts as 0, just like an sql LIMIT. */
+int dt_collection_get_range(const dt_collection_t *collection, int offset, int count, int32_t *ids);
+/** get the position of imgid in the query, -1 if it is not part of the collection */
+int dt_collection_get_position(const dt_collection_t *collection, int imgid);
 /** get all image ids order as current selection. no more than limit many images are returned, <0 ==
  * unlimited */
 GList *dt_collection_get_all(const dt_collection_t *collection, int limit);
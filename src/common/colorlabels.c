@@ -73,6 +73,8 @@ void dt_colorlabels_toggle_label_selection(const int color)
 {
   sqlite3_stmt *stmt, *stmt2;
 
+  dt_database_start_transaction(darktable.db);
+
   // check if all images in selection have that color label, i.e. try to get those which do not have the label
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT imgid FROM main.selected_images WHERE imgid "
                                                              "NOT IN (SELECT a.imgid FROM main.selected_images AS "
@@ -104,7 +106,9 @@ void dt_colorlabels_toggle_label_selection(const int color)
   }
   sqlite3_finalize(stmt);
 
-  dt_collection_hint_message(darktable.collection);
+  dt_database_release_transaction(darktable.db);
+
+  dt_collection_images_changed(darktable.collection, DT_COLLECTION_CHANGE_COLORLABEL, -1);
 }
 
 void dt_colorlabels_toggle_label(const int imgid, const int color)
@@ -136,7 +140,7 @@ void dt_colorlabels_toggle_label(const int imgid, const int color)
   }
   sqlite3_finalize(stmt);
 
-  dt_collection_hint_message(darktable.collection);
+  dt_collection_images_changed(darktable.collection, DT_COLLECTION_CHANGE_COLORLABEL, imgid);
 }
 
 int dt_colorlabels_check_label(const int imgid, const int color)
@@ -45,10 +45,12 @@
 #include "common/image.h"
 #include "common/image_cache.h"
 #include "common/imageio_module.h"
+#include "common/mapped_file.h"
 #include "common/mipmap_cache.h"
 #include "common/noiseprofiles.h"
 #include "common/opencl.h"
 #include "common/points.h"
+#include "common/profiling.h"
 #include "common/resource_limits.h"
 #include "common/undo.h"
 #include "control/conf.h"
@@ -125,6 +127,7 @@ static int usage(const char *argv0)
 #endif
   printf(" [--conf <key>=<value>]");
   printf(" [--noiseprofiles <noiseprofiles json file>]");
+  printf(" [--trace <trace json file>]");
   printf("\n");
   return 1;
 }
@@ -311,6 +314,77 @@ static void dt_codepaths_init()
   }
 }
 
+/* parts of dt_init() that don't depend on each other run in their own thread. each one is started as soon as
+ * everything it needs is up and waited for right before the first code that needs its result. */
+typedef struct dt_init_task_t
+{
+  const char *name;
+  GThread *thread;
+  void (*run)(gpointer data);
+  gpointer data;
+  double time;
+} dt_init_task_t;
+
+typedef struct dt_init_opencl_args_t
+{
+  gboolean exclude_opencl;
+  gboolean print_statistics;
+} dt_init_opencl_args_t;
+
+static gpointer _init_task_run(gpointer data)
+{
+  dt_init_task_t *task = (dt_init_task_t *)data;
+  const double start = dt_get_wtime();
+  task->run(task->data);
+  task->time = dt_get_wtime() - start;
+  return NULL;
+}
+
+static void _init_task_start(dt_init_task_t *task, const char *name, void (*run)(gpointer data), gpointer data)
+{
+  task->name = name;
+  task->run = run;
+  task->data = data;
+  task->time = 0.0;
+  task->thread = g_thread_new(name, _init_task_run, task);
+}
+
+static void _init_task_wait(dt_init_task_t *task)
+{
+  if(!task->thread) return;
+  const double start = dt_get_wtime();
+  g_thread_join(task->thread);
+  task->thread = NULL;
+  dt_print(DT_DEBUG_PERF, "[dt_init] %s took %.3f secs in the background, waited %.3f secs for it\n", task->name,
+           task->time, dt_get_wtime() - start);
+}
+
+/* prints how long the phase since *start took and starts the next one */
+static void _init_phase_done(const char *name, double *start)
+{
+  const double now = dt_get_wtime();
+  dt_print(DT_DEBUG_PERF, "[dt_init] %s took %.3f secs\n", name, now - *start);
+  *start = now;
+}
+
+static void _init_colorspaces(gpointer data)
+{
+  darktable.color_profiles = dt_colorspaces_init();
+}
+
+static void _init_opencl(gpointer data)
+{
+#ifdef HAVE_OPENCL
+  dt_init_opencl_args_t *args = (dt_init_opencl_args_t *)data;
+  dt_opencl_init(darktable.opencl, args->exclude_opencl, args->print_statistics);
+#endif
+}
+
+static void _init_noiseprofiles(gpointer data)
+{
+  darktable.noiseprofile_parser = dt_noiseprofile_init((const char *)data);
+}
+
 int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load_data, lua_State *L)
 {
 #ifndef __WIN32__
@@ -621,6 +695,12 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
         }
         g_free(keyval);
       }
+      else if(!strcmp(argv[k], "--trace") && argc > k + 1)
+      {
+        dt_trace_init(argv[++k]);
+        argv[k-1] = NULL;
+        argv[k] = NULL;
+      }
       else if(!strcmp(argv[k], "--noiseprofiles") && argc > k + 1)
       {
         noiseprofiles_from_command = argv[++k];
@@ -699,6 +779,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   // thread-safe init:
   dt_exif_init();
+  dt_mapped_file_init();
   char datadir[PATH_MAX] = { 0 };
   dt_loc_get_user_config_dir(datadir, sizeof(datadir));
   char darktablerc[PATH_MAX] = { 0 };
@@ -754,14 +835,20 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   // detect cpu features and decide which codepaths to enable
   dt_codepaths_init();
 
-  // get the list of color profiles
-  darktable.color_profiles = dt_colorspaces_init();
+  double phase_start = dt_get_wtime();
+  dt_init_task_t colorspaces_task = { 0 }, opencl_task = { 0 }, noiseprofiles_task = { 0 };
+  dt_init_opencl_args_t opencl_args = { exclude_opencl, print_statistics };
+
+  // get the list of color profiles, needed by the gui to set up the display profile
+  _init_task_start(&colorspaces_task, "color profiles", _init_colorspaces, NULL);
 
   // initialize the database
   darktable.db = dt_database_init(dbfilename_from_command, load_data);
+  _init_phase_done("database", &phase_start);
   if(darktable.db == NULL)
   {
     printf("ERROR : cannot open database\n");
+    _init_task_wait(&colorspaces_task);
     return 1;
   }
   else if(!dt_database_get_lock_acquired(darktable.db))
@@ -791,6 +878,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
     if(!image_loaded_elsewhere) dt_database_show_error(darktable.db);
 
+    _init_task_wait(&colorspaces_task);
     return 1;
   }
 
@@ -804,6 +892,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   if(init_gui && dt_conf_get_bool("run_crawler_on_start"))
   {
     changed_xmp_files = dt_control_crawler_run();
+    _init_phase_done("xmp crawler", &phase_start);
   }
 
   // FIXME: move there into dt_database_t
@@ -846,15 +935,18 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   dt_set_signal_handlers();
 #endif
 
+  _init_phase_done("control", &phase_start);
+
+  // probing the devices and compiling the kernels is the slowest part of the startup. everything up to the
+  // views runs meanwhile.
   darktable.opencl = (dt_opencl_t *)calloc(1, sizeof(dt_opencl_t));
-#ifdef HAVE_OPENCL
-  dt_opencl_init(darktable.opencl, exclude_opencl, print_statistics);
-#endif
+  _init_task_start(&opencl_task, "opencl", _init_opencl, &opencl_args);
 
   darktable.points = (dt_points_t *)calloc(1, sizeof(dt_points_t));
   dt_points_init(darktable.points, dt_get_num_threads());
 
-  darktable.noiseprofile_parser = dt_noiseprofile_init(noiseprofiles_from_command);
+  // only needed once denoiseprofile looks for a matching profile
+  _init_task_start(&noiseprofiles_task, "noise profiles", _init_noiseprofiles, noiseprofiles_from_command);
 
   // must come before mipmap_cache, because that one will need to access
   // image dimensions stored in here:
@@ -863,6 +955,9 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
   darktable.mipmap_cache = (dt_mipmap_cache_t *)calloc(1, sizeof(dt_mipmap_cache_t));
   dt_mipmap_cache_init(darktable.mipmap_cache);
+  _init_phase_done("caches", &phase_start);
+
+  _init_task_wait(&colorspaces_task);
 
   // The GUI must be initialized before the views, because the init()
   // functions of the views depend on darktable.control->accels_* to register
@@ -871,23 +966,42 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
   if(init_gui)
   {
     darktable.gui = (dt_gui_gtk_t *)calloc(1, sizeof(dt_gui_gtk_t));
-    if(dt_gui_gtk_init(darktable.gui)) return 1;
+    if(dt_gui_gtk_init(darktable.gui))
+    {
+      _init_task_wait(&opencl_task);
+      _init_task_wait(&noiseprofiles_task);
+      return 1;
+    }
     dt_bauhaus_init();
+    _init_phase_done("gui", &phase_start);
   }
   else
     darktable.gui = NULL;
 
+  // the views and the modules set up their opencl kernels and pipes
+  _init_task_wait(&opencl_task);
+  _init_task_wait(&noiseprofiles_task);
+  phase_start = dt_get_wtime();
+
+  // the first-run benchmark decides whether opencl gets used at all and is stored in the config, so it only
+  // runs once nothing else is going on
+  dt_opencl_benchmark_devices(darktable.opencl);
+  _init_phase_done("opencl benchmark", &phase_start);
+
   darktable.view_manager = (dt_view_manager_t *)calloc(1, sizeof(dt_view_manager_t));
   dt_view_manager_init(darktable.view_manager);
+  _init_phase_done("views", &phase_start);
 
   // check whether we were able to load darkroom view. if we failed, we'll crash everywhere later on.
   if(!darktable.develop) return 1;
 
   darktable.imageio = (dt_imageio_t *)calloc(1, sizeof(dt_imageio_t));
   dt_imageio_init(darktable.imageio);
+  _init_phase_done("imageio modules", &phase_start);
 
   // load the darkroom mode plugins once:
   dt_iop_load_modules_so();
+  _init_phase_done("processing modules", &phase_start);
 
   if(init_gui)
   {
@@ -926,6 +1040,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 
     // initialize undo struct
     darktable.undo = dt_undo_init();
+    _init_phase_done("utility modules and key accels", &phase_start);
   }
 
   if(darktable.unmuted & DT_DEBUG_MEMORY)
@@ -939,6 +1054,7 @@ int dt_init(int argc, char *argv[], const gboolean init_gui, const gboolean load
 /* init lua last, since it's user made stuff it must be in the real environment */
 #ifdef USE_LUA
   dt_lua_init(darktable.lua_state.state, lua_command);
+  _init_phase_done("lua", &phase_start);
 #endif
 
   if(init_gui)
@@ -1025,6 +1141,7 @@ void dt_cleanup()
     free(darktable.imageio);
     free(darktable.gui);
   }
+  dt_image_sidecar_cleanup();
   dt_image_cache_cleanup(darktable.image_cache);
   free(darktable.image_cache);
   dt_mipmap_cache_cleanup(darktable.mipmap_cache);
@@ -1067,7 +1184,9 @@ void dt_cleanup()
   dt_pthread_mutex_destroy(&(darktable.plugin_threadsafe));
   dt_pthread_mutex_destroy(&(darktable.capabilities_threadsafe));
 
+  dt_mapped_file_cleanup();
   dt_exif_cleanup();
+  dt_trace_cleanup();
 }
 
 void dt_print(dt_debug_thread_t thread, const char *msg, ...)
@@ -37,9 +37,12 @@
 
 // whenever _create_*_schema() gets changed you HAVE to bump this version and add an update path to
 // _upgrade_*_schema_step()!
-#define CURRENT_DATABASE_VERSION_LIBRARY 15
+#define CURRENT_DATABASE_VERSION_LIBRARY 17
 #define CURRENT_DATABASE_VERSION_DATA 1
 
+// upper limit for the read only connections open at the same time, further threads share the main handle
+#define MAX_READER_CONNECTIONS 8
+
 typedef struct dt_database_t
 {
   gboolean lock_acquired;
@@ -53,9 +56,31 @@ typedef struct dt_database_t
   /* ondisk DB */
   sqlite3 *handle;
 
+  /* in wal mode every thread asking for it gets its own read only connection, these are the open ones */
+  gboolean wal;
+  GList *readers;
+
+  /* savepoints all share one name on the shared connection, so only one thread at a time may have a
+     transaction open. recursive, as transactions nest. */
+  GRecMutex transaction_lock;
+  gint transaction_waiting; // threads blocked on the lock, so long batches can make way for them
+
   gchar *error_message, *error_dbfilename;
 } dt_database_t;
 
+/* a read only connection, it belongs to the thread that asked for it and is closed when that thread exits */
+typedef struct dt_database_reader_t
+{
+  dt_database_t *db;
+  sqlite3 *handle;
+} dt_database_reader_t;
+
+static void _database_reader_free(gpointer data);
+
+static GPrivate _database_reader = G_PRIVATE_INIT(_database_reader_free);
+// guards the readers lists, threads may exit while the database is destroyed
+static GMutex _database_readers_lock;
+
 
 /* migrates database from old place to new */
 static void _database_migrate_to_xdg_structure();
@@ -967,6 +992,42 @@ static int _upgrade_library_schema_step(dt_database_t *db, int version)
 
     sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
     new_version = 15;
+  }
+  else if(version == 15)
+  {
+    // 15 -> 16 add indices for the collect module: the date/time filters and sorting, the camera filter and
+    // the color label filter all ended up scanning the whole table
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_datetime_taken_index ON images (datetime_taken)",
+             "[init] can't create index `images_datetime_taken_index' in database\n");
+
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.images_maker_model_index ON images (maker, model)",
+             "[init] can't create index `images_maker_model_index' in database\n");
+
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.color_labels_color_index ON color_labels (color, imgid)",
+             "[init] can't create index `color_labels_color_index' in database\n");
+
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    new_version = 16;
+  }
+  else if(version == 16)
+  {
+    // 16 -> 17 keep the history of an image sorted by num in the index so it can be read without sorting, and
+    // index the masks by image. both are read and copied per image.
+    sqlite3_exec(db->handle, "BEGIN TRANSACTION", NULL, NULL, NULL);
+
+    TRY_EXEC("DROP INDEX IF EXISTS main.history_imgid_index",
+             "[init] can't drop index `history_imgid_index' from database\n");
+
+    TRY_EXEC("CREATE INDEX main.history_imgid_index ON history (imgid, num)",
+             "[init] can't create index `history_imgid_index' in database\n");
+
+    TRY_EXEC("CREATE INDEX IF NOT EXISTS main.mask_imgid_index ON mask (imgid)",
+             "[init] can't create index `mask_imgid_index' in database\n");
+
+    sqlite3_exec(db->handle, "COMMIT", NULL, NULL, NULL);
+    new_version = 17;
   } // maybe in the future, see commented out code elsewhere
     //   else if(version == XXX)
     //   {
@@ -1089,6 +1150,9 @@ static void _create_library_schema(dt_database_t *db)
   sqlite3_exec(db->handle, "CREATE INDEX main.images_group_id_index ON images (group_id)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.images_film_id_index ON images (film_id)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.images_filename_index ON images (filename)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.images_datetime_taken_index ON images (datetime_taken)", NULL, NULL,
+               NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.images_maker_model_index ON images (maker, model)", NULL, NULL, NULL);
   ////////////////////////////// selected_images
   sqlite3_exec(db->handle, "CREATE TABLE main.selected_images (imgid INTEGER PRIMARY KEY)", NULL, NULL, NULL);
   ////////////////////////////// history
@@ -1098,12 +1162,13 @@ static void _create_library_schema(dt_database_t *db)
       "operation VARCHAR(256), op_params BLOB, enabled INTEGER, "
       "blendop_params BLOB, blendop_version INTEGER, multi_priority INTEGER, multi_name VARCHAR(256))",
       NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "CREATE INDEX main.history_imgid_index ON history (imgid)", NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.history_imgid_index ON history (imgid, num)", NULL, NULL, NULL);
   ////////////////////////////// mask
   sqlite3_exec(db->handle,
                "CREATE TABLE main.mask (imgid INTEGER, formid INTEGER, form INTEGER, name VARCHAR(256), "
                "version INTEGER, points BLOB, points_count INTEGER, source BLOB)",
                NULL, NULL, NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.mask_imgid_index ON mask (imgid)", NULL, NULL, NULL);
   ////////////////////////////// tagged_images
   sqlite3_exec(db->handle, "CREATE TABLE main.tagged_images (imgid INTEGER, tagid INTEGER, "
                            "PRIMARY KEY (imgid, tagid))", NULL, NULL, NULL);
@@ -1115,6 +1180,8 @@ static void _create_library_schema(dt_database_t *db)
   sqlite3_exec(db->handle, "CREATE TABLE main.color_labels (imgid INTEGER, color INTEGER)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE UNIQUE INDEX main.color_labels_idx ON color_labels (imgid, color)", NULL, NULL,
                NULL);
+  sqlite3_exec(db->handle, "CREATE INDEX main.color_labels_color_index ON color_labels (color, imgid)", NULL, NULL,
+               NULL);
   ////////////////////////////// meta_data
   sqlite3_exec(db->handle, "CREATE TABLE main.meta_data (id INTEGER, key INTEGER, value VARCHAR)", NULL, NULL, NULL);
   sqlite3_exec(db->handle, "CREATE INDEX main.metadata_index ON meta_data (id, key)", NULL, NULL, NULL);
@@ -1540,6 +1607,7 @@ start:
   dt_database_t *db = (dt_database_t *)g_malloc0(sizeof(dt_database_t));
   db->dbfilename_data = g_strdup(dbfilename_data);
   db->dbfilename_library = g_strdup(dbfilename_library);
+  g_rec_mutex_init(&db->transaction_lock);
 
   /* having more than one instance of darktable using the same database is a bad idea */
   /* try to get locks for the databases */
@@ -1565,6 +1633,7 @@ start:
     fprintf(stderr, "[init] try `cp %s/darktablerc %s/darktablerc'\n", dbfilename_library, datadir);
     sqlite3_close(db->handle);
     g_free(dbname);
+    g_rec_mutex_clear(&db->transaction_lock);
     g_free(db->lockfile_data);
     g_free(db->dbfilename_data);
     g_free(db->lockfile_library);
@@ -1594,8 +1663,25 @@ start:
   sqlite3_finalize(stmt);
 
   // some sqlite3 config
-  sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
-  sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  if(dt_conf_get_bool("database/wal") && strcmp(dbfilename_library, ":memory:") && load_data)
+  {
+    // a write ahead log lets the reader connections see a consistent state while we are writing. it only works
+    // for databases on disk.
+    rc = sqlite3_prepare_v2(db->handle, "PRAGMA journal_mode = WAL", -1, &stmt, NULL);
+    if(rc == SQLITE_OK && sqlite3_step(stmt) == SQLITE_ROW)
+      db->wal = !g_ascii_strcasecmp((const char *)sqlite3_column_text(stmt, 0), "wal");
+    sqlite3_finalize(stmt);
+    if(!db->wal) fprintf(stderr, "[init] couldn't switch the database to wal mode\n");
+  }
+  if(db->wal)
+  {
+    sqlite3_exec(db->handle, "PRAGMA synchronous = NORMAL", NULL, NULL, NULL);
+  }
+  else
+  {
+    sqlite3_exec(db->handle, "PRAGMA synchronous = OFF", NULL, NULL, NULL);
+    sqlite3_exec(db->handle, "PRAGMA journal_mode = MEMORY", NULL, NULL, NULL);
+  }
   sqlite3_exec(db->handle, "PRAGMA page_size = 32768", NULL, NULL, NULL);
 
   /* now that we got functional databases that are locked for us we can make sure that the schema is set up */
@@ -1822,6 +1908,20 @@ error:
 
 void dt_database_destroy(const dt_database_t *db)
 {
+  // the readers have to go first, the last connection to close checkpoints the wal. threads that are still
+  // running only free what is left of theirs when they exit.
+  g_mutex_lock(&_database_readers_lock);
+  for(GList *l = db->readers; l; l = g_list_next(l))
+  {
+    dt_database_reader_t *reader = (dt_database_reader_t *)l->data;
+    sqlite3_close(reader->handle);
+    reader->handle = NULL;
+    reader->db = NULL;
+  }
+  g_list_free(db->readers);
+  ((dt_database_t *)db)->readers = NULL;
+  g_mutex_unlock(&_database_readers_lock);
+  g_rec_mutex_clear(&((dt_database_t *)db)->transaction_lock);
   sqlite3_close(db->handle);
   if (db->lockfile_data)
   {
@@ -1843,6 +1943,104 @@ sqlite3 *dt_database_get(const dt_database_t *db)
   return db ? db->handle : NULL;
 }
 
+static sqlite3 *_database_open_reader(const dt_database_t *db)
+{
+  sqlite3 *handle = NULL;
+  if(sqlite3_open_v2(db->dbfilename_library, &handle, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK)
+  {
+    fprintf(stderr, "[database] couldn't open a reader connection: %s\n", sqlite3_errmsg(handle));
+    sqlite3_close(handle);
+    return NULL;
+  }
+  sqlite3_busy_timeout(handle, 1000);
+
+  sqlite3_stmt *stmt;
+  int rc = sqlite3_prepare_v2(handle, "ATTACH DATABASE ?1 AS data", -1, &stmt, NULL);
+  sqlite3_bind_text(stmt, 1, db->dbfilename_data, -1, SQLITE_TRANSIENT);
+  if(rc != SQLITE_OK || sqlite3_step(stmt) != SQLITE_DONE)
+  {
+    fprintf(stderr, "[database] couldn't attach `%s' to a reader connection\n", db->dbfilename_data);
+    sqlite3_finalize(stmt);
+    sqlite3_close(handle);
+    return NULL;
+  }
+  sqlite3_finalize(stmt);
+
+  return handle;
+}
+
+static void _database_reader_free(gpointer data)
+{
+  dt_database_reader_t *reader = (dt_database_reader_t *)data;
+  g_mutex_lock(&_database_readers_lock);
+  // the connection is gone already when the database was destroyed first
+  if(reader->db)
+  {
+    reader->db->readers = g_list_remove(reader->db->readers, reader);
+    sqlite3_close(reader->handle);
+  }
+  g_mutex_unlock(&_database_readers_lock);
+  g_free(reader);
+}
+
+sqlite3 *dt_database_get_reader(const dt_database_t *db)
+{
+  if(!db) return NULL;
+  // whatever the writer has not committed yet is only visible on its own connection
+  if(!db->wal || !sqlite3_get_autocommit(db->handle)) return db->handle;
+
+  dt_database_reader_t *reader = (dt_database_reader_t *)g_private_get(&_database_reader);
+  if(reader && reader->db == db) return reader->handle;
+  // a thread only keeps one reader around, the one of a destroyed database can go
+  if(reader && reader->db) return db->handle;
+  if(reader) g_private_replace(&_database_reader, NULL);
+
+  dt_database_t *d = (dt_database_t *)db;
+  g_mutex_lock(&_database_readers_lock);
+  sqlite3 *handle = NULL;
+  if(g_list_length(d->readers) < MAX_READER_CONNECTIONS && (handle = _database_open_reader(db)))
+  {
+    reader = (dt_database_reader_t *)g_malloc(sizeof(dt_database_reader_t));
+    reader->db = d;
+    reader->handle = handle;
+    d->readers = g_list_prepend(d->readers, reader);
+    dt_print(DT_DEBUG_SQL, "[database] opened reader connection %u\n", g_list_length(d->readers));
+  }
+  g_mutex_unlock(&_database_readers_lock);
+  // closed again when this thread exits
+  if(handle) g_private_set(&_database_reader, reader);
+
+  return handle ? handle : db->handle;
+}
+
+void dt_database_start_transaction(const struct dt_database_t *db)
+{
+  // a RELEASE or ROLLBACK TO of another thread would act on our savepoint, wait until it is done
+  g_atomic_int_inc(&((dt_database_t *)db)->transaction_waiting);
+  g_rec_mutex_lock(&((dt_database_t *)db)->transaction_lock);
+  g_atomic_int_dec_and_test(&((dt_database_t *)db)->transaction_waiting);
+  // savepoints open a transaction when there is none and nest otherwise, where a plain BEGIN would fail
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "SAVEPOINT dt_transaction", NULL, NULL, NULL);
+}
+
+gboolean dt_database_transaction_waiting(const struct dt_database_t *db)
+{
+  return g_atomic_int_get(&((dt_database_t *)db)->transaction_waiting) > 0;
+}
+
+void dt_database_release_transaction(const struct dt_database_t *db)
+{
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "RELEASE SAVEPOINT dt_transaction", NULL, NULL, NULL);
+  g_rec_mutex_unlock(&((dt_database_t *)db)->transaction_lock);
+}
+
+void dt_database_rollback_transaction(const struct dt_database_t *db)
+{
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "ROLLBACK TO SAVEPOINT dt_transaction", NULL, NULL, NULL);
+  DT_DEBUG_SQLITE3_EXEC(db->handle, "RELEASE SAVEPOINT dt_transaction", NULL, NULL, NULL);
+  g_rec_mutex_unlock(&((dt_database_t *)db)->transaction_lock);
+}
+
 const gchar *dt_database_get_path(const struct dt_database_t *db)
 {
   return db->dbfilename_library;
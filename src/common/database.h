@@ -28,10 +28,24 @@ struct dt_database_t *dt_database_init(const char *alternative, const gboolean l
 void dt_database_destroy(const struct dt_database_t *);
 /** get handle */
 struct sqlite3 *dt_database_get(const struct dt_database_t *);
+/** get a read only handle for the calling thread. in wal mode this is a connection of its own that doesn't
+ *  serialize with the other threads and is closed when the thread exits, otherwise the shared handle. it can't
+ *  see the memory schema and must not be used for writing. */
+struct sqlite3 *dt_database_get_reader(const struct dt_database_t *);
 /** Returns database path */
 const gchar *dt_database_get_path(const struct dt_database_t *db);
 /** test if database was already locked by another instance */
 gboolean dt_database_get_lock_acquired(const struct dt_database_t *db);
+/** start a transaction on the shared connection. these nest (they are savepoints), so code that
+ *  batches work can wrap callees that open transactions of their own. */
+void dt_database_start_transaction(const struct dt_database_t *db);
+/** whether another thread waits to start a transaction. code holding one open over many writes should
+ *  commit then and start a new one. */
+gboolean dt_database_transaction_waiting(const struct dt_database_t *db);
+/** commit the innermost transaction started with dt_database_start_transaction() */
+void dt_database_release_transaction(const struct dt_database_t *db);
+/** undo everything since the innermost dt_database_start_transaction() and close it */
+void dt_database_rollback_transaction(const struct dt_database_t *db);
 /** show an error popup. this has to be postponed until after we tried using dbus to reach another instance */
 void dt_database_show_error(const struct dt_database_t *db);
 
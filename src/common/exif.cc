@@ -38,6 +38,7 @@ extern "C" {
 #include <cmath>
 #include <fstream>
 #include <iostream>
+#include <memory>
 #include <sstream>
 #include <string>
 
@@ -61,6 +62,7 @@ extern "C" {
 #include "common/image_cache.h"
 #include "common/imageio.h"
 #include "common/imageio_jpeg.h"
+#include "common/mapped_file.h"
 #include "common/metadata.h"
 #include "common/tags.h"
 #include "control/conf.h"
@@ -962,6 +964,17 @@ static void dt_exif_apply_global_overwrites(dt_image_t *img)
   }
 }
 
+typedef std::unique_ptr<dt_mapped_file_t, decltype(&dt_mapped_file_close)> dt_exif_mapped_file_t;
+
+// open an image for reading, preferring a (possibly already existing) shared mapping of the file.
+// exiv2's MemIo only references the data, so the mapping has to outlive the returned image.
+static std::unique_ptr<Exiv2::Image> _exif_open_mapped(const dt_exif_mapped_file_t &mapped, const char *path)
+{
+  if(mapped)
+    return std::unique_ptr<Exiv2::Image>(Exiv2::ImageFactory::open(mapped->data, (long)mapped->size));
+  return std::unique_ptr<Exiv2::Image>(Exiv2::ImageFactory::open(WIDEN(path)));
+}
+
 // TODO: can this blob also contain xmp and iptc data?
 int dt_exif_read_from_blob(dt_image_t *img, uint8_t *blob, const int size)
 {
@@ -988,7 +1001,8 @@ int dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char
 {
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
+    dt_exif_mapped_file_t mapped(dt_mapped_file_open(path), &dt_mapped_file_close);
+    std::unique_ptr<Exiv2::Image> image(_exif_open_mapped(mapped, path));
     assert(image.get() != 0);
     image->readMetadata();
 
@@ -1032,10 +1046,39 @@ int dt_exif_get_thumbnail(const char *path, uint8_t **buffer, size_t *size, char
   }
 }
 
-/** read the metadata of an image.
- * XMP data trumps IPTC data trumps EXIF data
- */
-int dt_exif_read(dt_image_t *img, const char *path)
+// apply the metadata of an already opened and parsed image to img
+static int _exif_read_image(dt_image_t *img, Exiv2::Image *image)
+{
+  bool res = true;
+
+  // EXIF metadata
+  Exiv2::ExifData &exifData = image->exifData();
+  if(!exifData.empty())
+    res = dt_exif_read_exif_data(img, exifData);
+  else
+    img->exif_inited = 1;
+
+  // these get overwritten by IPTC and XMP. is that how it should work?
+  dt_exif_apply_global_overwrites(img);
+
+  // IPTC metadata.
+  Exiv2::IptcData &iptcData = image->iptcData();
+  if(!iptcData.empty()) res = dt_exif_read_iptc_data(img, iptcData) && res;
+
+  // XMP metadata
+  Exiv2::XmpData &xmpData = image->xmpData();
+  if(!xmpData.empty()) res = dt_exif_read_xmp_data(img, xmpData, -1, true) && res;
+
+  // Initialize size - don't wait for full raw to be loaded to get this
+  // information. If use_embedded_thumbnail is set, it will take a
+  // change in development history to have this information
+  img->height = image->pixelHeight();
+  img->width = image->pixelWidth();
+
+  return res ? 0 : 1;
+}
+
+static void _exif_set_datetime_from_mtime(dt_image_t *img, const char *path)
 {
   // at least set datetime taken to something useful in case there is no exif data in this file (pfm, png,
   // ...)
@@ -1046,95 +1089,157 @@ int dt_exif_read(dt_image_t *img, const char *path)
     struct tm result;
     strftime(img->exif_datetime_taken, 20, "%Y:%m:%d %H:%M:%S", localtime_r(&statbuf.st_mtime, &result));
   }
+}
+
+/** read the metadata of an image.
+ * XMP data trumps IPTC data trumps EXIF data
+ */
+int dt_exif_read(dt_image_t *img, const char *path)
+{
+  _exif_set_datetime_from_mtime(img, path);
 
   try
   {
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
+    dt_exif_mapped_file_t mapped(dt_mapped_file_open(path), &dt_mapped_file_close);
+    std::unique_ptr<Exiv2::Image> image(_exif_open_mapped(mapped, path));
     assert(image.get() != 0);
     image->readMetadata();
-    bool res = true;
-
-    // EXIF metadata
-    Exiv2::ExifData &exifData = image->exifData();
-    if(!exifData.empty())
-      res = dt_exif_read_exif_data(img, exifData);
-    else
-      img->exif_inited = 1;
-
-    // these get overwritten by IPTC and XMP. is that how it should work?
-    dt_exif_apply_global_overwrites(img);
-
-    // IPTC metadata.
-    Exiv2::IptcData &iptcData = image->iptcData();
-    if(!iptcData.empty()) res = dt_exif_read_iptc_data(img, iptcData) && res;
+    return _exif_read_image(img, image.get());
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    std::string s(e.what());
+    std::cerr << "[exiv2] " << path << ": " << s << std::endl;
+    return 1;
+  }
+}
 
-    // XMP metadata
-    Exiv2::XmpData &xmpData = image->xmpData();
-    if(!xmpData.empty()) res = dt_exif_read_xmp_data(img, xmpData, -1, true) && res;
+struct dt_exif_prefetch_t
+{
+  std::string path, sidecar;
+  dt_exif_mapped_file_t mapped;         // exiv2 keeps reading from this, has to outlive image
+  std::unique_ptr<Exiv2::Image> image;   // NULL if the image couldn't be parsed
+  std::unique_ptr<Exiv2::Image> xmp;     // NULL if there is no (readable) sidecar
+  dt_exif_prefetch_t() : mapped(NULL, &dt_mapped_file_close) {}
+};
+
+dt_exif_prefetch_t *dt_exif_prefetch(const char *path, const char *sidecar)
+{
+  dt_exif_prefetch_t *prefetch = new dt_exif_prefetch_t;
+  prefetch->path = path;
+  try
+  {
+    prefetch->mapped.reset(dt_mapped_file_open(path));
+    prefetch->image = _exif_open_mapped(prefetch->mapped, path);
+    prefetch->image->readMetadata();
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    // reported when the metadata is applied, just like dt_exif_read() would
+    prefetch->image.reset();
+  }
 
-    // Initialize size - don't wait for full raw to be loaded to get this
-    // information. If use_embedded_thumbnail is set, it will take a
-    // change in development history to have this information
-    img->height = image->pixelHeight();
-    img->width = image->pixelWidth();
+  if(sidecar)
+  {
+    prefetch->sidecar = sidecar;
+    try
+    {
+      prefetch->xmp.reset(Exiv2::ImageFactory::open(WIDEN(sidecar)).release());
+      prefetch->xmp->readMetadata();
+    }
+    catch(Exiv2::AnyError &e)
+    {
+      prefetch->xmp.reset();
+    }
+  }
+  return prefetch;
+}
 
-    return res ? 0 : 1;
+int dt_exif_read_prefetched(dt_image_t *img, dt_exif_prefetch_t *prefetch)
+{
+  if(!prefetch) return 1;
+  _exif_set_datetime_from_mtime(img, prefetch->path.c_str());
+  if(!prefetch->image)
+  {
+    // parsing failed on the worker thread, try again here to get a proper error message
+    return dt_exif_read(img, prefetch->path.c_str());
+  }
+  try
+  {
+    return _exif_read_image(img, prefetch->image.get());
   }
   catch(Exiv2::AnyError &e)
   {
     std::string s(e.what());
-    std::cerr << "[exiv2] " << path << ": " << s << std::endl;
+    std::cerr << "[exiv2] " << prefetch->path << ": " << s << std::endl;
     return 1;
   }
 }
 
-int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path, const int compressed)
+void dt_exif_prefetch_free(dt_exif_prefetch_t *prefetch)
+{
+  delete prefetch;
+}
+
+int dt_exif_write_metadata(uint8_t *blob, uint32_t size, const char *xmp, const char *path, const int compressed)
 {
+  // nothing the format didn't already embed, spare us opening the file
+  if((!blob || size <= 6) && !xmp) return 1;
   try
   {
     std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(path)));
     assert(image.get() != 0);
     image->readMetadata();
-    Exiv2::ExifData &imgExifData = image->exifData();
-    Exiv2::ExifData blobExifData;
-    Exiv2::ExifParser::decode(blobExifData, blob + 6, size);
-    Exiv2::ExifData::const_iterator end = blobExifData.end();
-    Exiv2::ExifData::iterator it;
-    for(Exiv2::ExifData::const_iterator i = blobExifData.begin(); i != end; ++i)
+    if(blob && size > 6)
     {
-      // add() does not override! we need to delete existing key first.
-      Exiv2::ExifKey key(i->key());
-      if((it = imgExifData.findKey(key)) != imgExifData.end()) imgExifData.erase(it);
+      Exiv2::ExifData &imgExifData = image->exifData();
+      Exiv2::ExifData blobExifData;
+      Exiv2::ExifParser::decode(blobExifData, blob + 6, size - 6);
+      Exiv2::ExifData::const_iterator end = blobExifData.end();
+      Exiv2::ExifData::iterator it;
+      for(Exiv2::ExifData::const_iterator i = blobExifData.begin(); i != end; ++i)
+      {
+        // add() does not override! we need to delete existing key first.
+        Exiv2::ExifKey key(i->key());
+        if((it = imgExifData.findKey(key)) != imgExifData.end()) imgExifData.erase(it);
 
-      imgExifData.add(Exiv2::ExifKey(i->key()), &i->value());
-    }
+        imgExifData.add(Exiv2::ExifKey(i->key()), &i->value());
+      }
 
-    {
-      // Remove thumbnail
-      static const char *keys[] = {
-        "Exif.Thumbnail.Compression",
-        "Exif.Thumbnail.XResolution",
-        "Exif.Thumbnail.YResolution",
-        "Exif.Thumbnail.ResolutionUnit",
-        "Exif.Thumbnail.JPEGInterchangeFormat",
-        "Exif.Thumbnail.JPEGInterchangeFormatLength"
-      };
-      static const guint n_keys = G_N_ELEMENTS(keys);
-      dt_remove_exif_keys(imgExifData, keys, n_keys);
-    }
+      {
+        // Remove thumbnail
+        static const char *keys[] = {
+          "Exif.Thumbnail.Compression",
+          "Exif.Thumbnail.XResolution",
+          "Exif.Thumbnail.YResolution",
+          "Exif.Thumbnail.ResolutionUnit",
+          "Exif.Thumbnail.JPEGInterchangeFormat",
+          "Exif.Thumbnail.JPEGInterchangeFormatLength"
+        };
+        static const guint n_keys = G_N_ELEMENTS(keys);
+        dt_remove_exif_keys(imgExifData, keys, n_keys);
+      }
+
+      // only compressed images may set PixelXDimension and PixelYDimension
+      if(!compressed)
+      {
+        static const char *keys[] = {
+          "Exif.Photo.PixelXDimension",
+          "Exif.Photo.PixelYDimension"
+        };
+        static const guint n_keys = G_N_ELEMENTS(keys);
+        dt_remove_exif_keys(imgExifData, keys, n_keys);
+      }
 
-    // only compressed images may set PixelXDimension and PixelYDimension
-    if(!compressed)
+      imgExifData.sortByTag();
+    }
+    if(xmp)
     {
-      static const char *keys[] = {
-        "Exif.Photo.PixelXDimension",
-        "Exif.Photo.PixelYDimension"
-      };
-      static const guint n_keys = G_N_ELEMENTS(keys);
-      dt_remove_exif_keys(imgExifData, keys, n_keys);
+      Exiv2::XmpData xmpData;
+      if(Exiv2::XmpParser::decode(xmpData, xmp) != 0)
+        throw Exiv2::Error(1, "[exif write] failed to parse the xmp packet");
+      image->setXmpData(xmpData);
     }
-
-    imgExifData.sortByTag();
     image->writeMetadata();
   }
   catch(Exiv2::AnyError &e)
@@ -1146,6 +1251,11 @@ int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path, const int
   return 1;
 }
 
+int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path, const int compressed)
+{
+  return dt_exif_write_metadata(blob, size, NULL, path, compressed);
+}
+
 int dt_exif_read_blob(uint8_t **buf, const char *path, const int imgid, const int sRGB, const int out_width,
                       const int out_height, const int dng_mode)
 {
@@ -1977,18 +2087,11 @@ skip:
   return history_entries;
 }
 
-// need a write lock on *img (non-const) to write stars (and soon color labels).
-int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_only)
+// apply an already parsed xmp sidecar to img and the database
+static int _exif_xmp_read_image(dt_image_t *img, Exiv2::Image *image, const char *filename, const int history_only)
 {
-  // exclude pfm to avoid stupid errors on the console
-  const char *c = filename + strlen(filename) - 4;
-  if(c >= filename && !strcmp(c, ".pfm")) return 1;
   try
   {
-    // read xmp sidecar
-    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(filename)));
-    assert(image.get() != 0);
-    image->readMetadata();
     Exiv2::XmpData &xmpData = image->xmpData();
 
     sqlite3_stmt *stmt;
@@ -2129,7 +2232,7 @@ int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_on
       return 1;
     }
 
-    sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+    dt_database_start_transaction(darktable.db);
 
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM main.history WHERE imgid = ?1", -1,
                                 &stmt, NULL);
@@ -2233,24 +2336,53 @@ end:
 
     if(all_ok)
     {
-      sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+      dt_database_release_transaction(darktable.db);
     }
     else
     {
       std::cerr << "[exif] error reading history from '" << filename << "'" << std::endl;
-      sqlite3_exec(dt_database_get(darktable.db), "ROLLBACK TRANSACTION", NULL, NULL, NULL);
+      dt_database_rollback_transaction(darktable.db);
       return 1;
     }
 
   }
   catch(Exiv2::AnyError &e)
+  {
+    std::string s(e.what());
+    std::cerr << "[exiv2] " << filename << ": " << s << std::endl;
+    return 1;
+  }
+  return 0;
+}
+
+// need a write lock on *img (non-const) to write stars (and soon color labels).
+int dt_exif_xmp_read(dt_image_t *img, const char *filename, const int history_only)
+{
+  // exclude pfm to avoid stupid errors on the console
+  const char *c = filename + strlen(filename) - 4;
+  if(c >= filename && !strcmp(c, ".pfm")) return 1;
+  try
+  {
+    // read xmp sidecar
+    std::unique_ptr<Exiv2::Image> image(Exiv2::ImageFactory::open(WIDEN(filename)));
+    assert(image.get() != 0);
+    image->readMetadata();
+    return _exif_xmp_read_image(img, image.get(), filename, history_only);
+  }
+  catch(Exiv2::AnyError &e)
   {
     // actually nobody's interested in that if the file doesn't exist:
     // std::string s(e.what());
     // std::cerr << "[exiv2] " << filename << ": " << s << std::endl;
     return 1;
   }
-  return 0;
+}
+
+int dt_exif_xmp_read_prefetched(dt_image_t *img, dt_exif_prefetch_t *prefetch, const int history_only)
+{
+  // no sidecar, or it couldn't be parsed. same as dt_exif_xmp_read() failing to open it.
+  if(!prefetch || !prefetch->xmp) return 1;
+  return _exif_xmp_read_image(img, prefetch->xmp.get(), prefetch->sidecar.c_str(), history_only);
 }
 
 // helper to create an xmp data thing. throws exiv2 exceptions if stuff goes wrong.
@@ -2602,58 +2734,67 @@ char *dt_exif_xmp_read_string(const int imgid)
   }
 }
 
-int dt_exif_xmp_attach(const int imgid, const char *filename)
+// collect the metadata that goes into exported images. xmpData and iptcData are only replaced if the
+// source image can be read, then the sidecar and the database are added on top.
+static void _exif_xmp_read_export_data(const int imgid, Exiv2::XmpData &xmpData, Exiv2::IptcData &iptcData)
 {
+  char input_filename[PATH_MAX] = { 0 };
+  gboolean from_cache = TRUE;
+  dt_image_full_path(imgid, input_filename, sizeof(input_filename), &from_cache);
+
   try
   {
-    char input_filename[PATH_MAX] = { 0 };
-    gboolean from_cache = TRUE;
-    dt_image_full_path(imgid, input_filename, sizeof(input_filename), &from_cache);
-
-    std::unique_ptr<Exiv2::Image> img(Exiv2::ImageFactory::open(WIDEN(filename)));
-    // unfortunately it seems we have to read the metadata, to not erase the exif (which we just wrote).
-    // will make export slightly slower, oh well.
-    // img->clearXmpPacket();
-    img->readMetadata();
-
-    try
-    {
-      // initialize XMP and IPTC data with the one from the original file
-      std::unique_ptr<Exiv2::Image> input_image(Exiv2::ImageFactory::open(WIDEN(input_filename)));
-      if(input_image.get() != 0)
-      {
-        input_image->readMetadata();
-        img->setIptcData(input_image->iptcData());
-        img->setXmpData(input_image->xmpData());
-      }
-    }
-    catch(Exiv2::AnyError &e)
+    // initialize XMP and IPTC data with the one from the original file
+    std::unique_ptr<Exiv2::Image> input_image(Exiv2::ImageFactory::open(WIDEN(input_filename)));
+    if(input_image.get() != 0)
     {
-      std::cerr << "[xmp_attach] " << input_filename << ": caught exiv2 exception '" << e << "'\n";
+      input_image->readMetadata();
+      iptcData = input_image->iptcData();
+      xmpData = input_image->xmpData();
     }
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    std::cerr << "[xmp_attach] " << input_filename << ": caught exiv2 exception '" << e << "'\n";
+  }
 
-    Exiv2::XmpData &xmpData = img->xmpData();
+  // now add whatever we have in the sidecar XMP. this overwrites stuff from the source image
+  dt_image_path_append_version(imgid, input_filename, sizeof(input_filename));
+  g_strlcat(input_filename, ".xmp", sizeof(input_filename));
+  if(g_file_test(input_filename, G_FILE_TEST_EXISTS))
+  {
+    Exiv2::XmpData sidecarXmpData;
+    std::string xmpPacket;
 
-    // now add whatever we have in the sidecar XMP. this overwrites stuff from the source image
-    dt_image_path_append_version(imgid, input_filename, sizeof(input_filename));
-    g_strlcat(input_filename, ".xmp", sizeof(input_filename));
-    if(g_file_test(input_filename, G_FILE_TEST_EXISTS))
-    {
-      Exiv2::XmpData sidecarXmpData;
-      std::string xmpPacket;
+    Exiv2::DataBuf buf = Exiv2::readFile(WIDEN(input_filename));
+    xmpPacket.assign(reinterpret_cast<char *>(buf.pData_), buf.size_);
+    Exiv2::XmpParser::decode(sidecarXmpData, xmpPacket);
 
-      Exiv2::DataBuf buf = Exiv2::readFile(WIDEN(input_filename));
-      xmpPacket.assign(reinterpret_cast<char *>(buf.pData_), buf.size_);
-      Exiv2::XmpParser::decode(sidecarXmpData, xmpPacket);
+    for(Exiv2::XmpData::const_iterator it = sidecarXmpData.begin(); it != sidecarXmpData.end(); ++it)
+      xmpData.add(*it);
+  }
 
-      for(Exiv2::XmpData::const_iterator it = sidecarXmpData.begin(); it != sidecarXmpData.end(); ++it)
-        xmpData.add(*it);
-    }
+  dt_remove_known_keys(xmpData); // is this needed?
+  // last but not least attach what we have in DB to the XMP. in theory that should be
+  // the same as what we just copied over from the sidecar file, but you never know ...
+  dt_exif_xmp_read_data(xmpData, imgid);
+}
 
-    dt_remove_known_keys(xmpData); // is this needed?
-    // last but not least attach what we have in DB to the XMP. in theory that should be
-    // the same as what we just copied over from the sidecar file, but you never know ...
-    dt_exif_xmp_read_data(xmpData, imgid);
+int dt_exif_xmp_attach(const int imgid, const char *filename)
+{
+  try
+  {
+    std::unique_ptr<Exiv2::Image> img(Exiv2::ImageFactory::open(WIDEN(filename)));
+    // unfortunately it seems we have to read the metadata, to not erase the exif (which we just wrote).
+    // will make export slightly slower, oh well.
+    // img->clearXmpPacket();
+    img->readMetadata();
+
+    Exiv2::XmpData xmpData = img->xmpData();
+    Exiv2::IptcData iptcData = img->iptcData();
+    _exif_xmp_read_export_data(imgid, xmpData, iptcData);
+    img->setIptcData(iptcData);
+    img->setXmpData(xmpData);
 
     img->writeMetadata();
     return 0;
@@ -2665,6 +2806,31 @@ int dt_exif_xmp_attach(const int imgid, const char *filename)
   }
 }
 
+char *dt_exif_xmp_read_export_string(const int imgid)
+{
+  try
+  {
+    Exiv2::XmpData xmpData;
+    Exiv2::IptcData iptcData;
+    _exif_xmp_read_export_data(imgid, xmpData, iptcData);
+
+    // iptc doesn't fit into the packet, leave such images to dt_exif_xmp_attach()
+    if(!iptcData.empty()) return NULL;
+
+    std::string xmpPacket;
+    if(Exiv2::XmpParser::encode(xmpPacket, xmpData, Exiv2::XmpParser::useCompactFormat) != 0)
+    {
+      throw Exiv2::Error(1, "[xmp_read_export_string] failed to serialize xmp data");
+    }
+    return g_strdup(xmpPacket.c_str());
+  }
+  catch(Exiv2::AnyError &e)
+  {
+    std::cerr << "[xmp_read_export_string] caught exiv2 exception '" << e << "'\n";
+    return NULL;
+  }
+}
+
 // write xmp sidecar file:
 int dt_exif_xmp_write(const int imgid, const char *filename)
 {
@@ -30,6 +30,18 @@ extern "C" {
  * struct. returns 0 on success. */
 int dt_exif_read(dt_image_t *img, const char *path);
 
+/** metadata of an image (and its xmp sidecar) parsed ahead of time, see dt_exif_prefetch(). */
+typedef struct dt_exif_prefetch_t dt_exif_prefetch_t;
+
+/** open and parse the metadata of path and of the sidecar file (if not NULL) without touching
+ * the database or any image struct. safe to call from worker threads, used to parallelize import. */
+dt_exif_prefetch_t *dt_exif_prefetch(const char *path, const char *sidecar);
+/** same as dt_exif_read(), but using the prefetched metadata. */
+int dt_exif_read_prefetched(dt_image_t *img, dt_exif_prefetch_t *prefetch);
+/** same as dt_exif_xmp_read() on the sidecar, but using the prefetched metadata. */
+int dt_exif_xmp_read_prefetched(dt_image_t *img, dt_exif_prefetch_t *prefetch, const int history_only);
+void dt_exif_prefetch_free(dt_exif_prefetch_t *prefetch);
+
 /** read exif data to image struct from given data blob, wherever you got it from. */
 int dt_exif_read_from_blob(dt_image_t *img, uint8_t *blob, const int size);
 
@@ -41,12 +53,20 @@ int dt_exif_read_blob(uint8_t **blob, const char *path, const int imgid, const i
 /** write blob to file exif. merges with existing exif information.*/
 int dt_exif_write_blob(uint8_t *blob, uint32_t size, const char *path, const int compressed);
 
+/** like dt_exif_write_blob(), additionally replacing the xmp data with the given packet. blob and xmp may be
+ * NULL. this is the fallback for formats that can't embed the metadata while encoding. */
+int dt_exif_write_metadata(uint8_t *blob, uint32_t size, const char *xmp, const char *path, const int compressed);
+
 /** write xmp sidecar file. */
 int dt_exif_xmp_write(const int imgid, const char *filename);
 
 /** write xmp packet inside an image. */
 int dt_exif_xmp_attach(const int imgid, const char *filename);
 
+/** get the xmp packet dt_exif_xmp_attach() would write into an export of imgid. NULL if that's not possible
+ * without rewriting the exported file (the source image has iptc data). */
+char *dt_exif_xmp_read_export_string(const int imgid);
+
 /** get the xmp blob for imgid. */
 char *dt_exif_xmp_read_string(const int imgid);
 
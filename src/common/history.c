@@ -96,7 +96,7 @@ static void _dt_history_cleanup_multi_instance(int imgid, int minnum)
       }
       modules = g_list_next(modules);
     }
-    if (modules && (((dt_iop_module_so_t *)(modules->data))->flags() & IOP_FLAGS_ONE_INSTANCE))
+    if (modules && (((dt_iop_module_so_t *)(modules->data))->manifest_flags & IOP_FLAGS_ONE_INSTANCE))
     {
       // the current module is a single-instance one, so there's no point in trying to mess up our multi_priority value
       continue;
@@ -239,54 +239,25 @@ int dt_history_load_and_apply_on_selection(gchar *filename)
   return res;
 }
 
-int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboolean merge, GList *ops)
+// the statements pasting a history onto one image, prepared once for all images of a paste
+typedef struct dt_history_paste_t
 {
-  sqlite3_stmt *stmt;
-  if(imgid == dest_imgid) return 1;
-
-  if(imgid == -1)
-  {
-    dt_control_log(_("you need to copy history from an image before you paste it onto another"));
-    return 1;
-  }
-
-  // be sure the current history is written before pasting some other history data
-  const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
-  if(cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
+  gboolean merge;
+  GList *ops;
+  sqlite3_stmt *trim_history, *history_offset, *delete_history, *insert_history, *delete_masks, *insert_masks,
+      *history_end;
+} dt_history_paste_t;
 
-  /* if merge onto history stack, lets find history offest in destination image */
-  int32_t offs = 0;
-  if(merge)
-  {
-    /* apply on top of history stack */
-    // first trim the stack to get rid of whatever is above the selected entry
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "DELETE FROM main.history WHERE imgid = ?1 AND num >= (SELECT history_end "
-                                "FROM main.images WHERE id = imgid)", -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
-
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT IFNULL(MAX(num), -1)+1 FROM main.history WHERE imgid = ?1",
-                                -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    if(sqlite3_step(stmt) == SQLITE_ROW) offs = sqlite3_column_int(stmt, 0);
-  }
-  else
-  {
-    /* replace history stack */
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM main.history WHERE imgid = ?1", -1,
-                                &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    sqlite3_step(stmt);
-  }
-  sqlite3_finalize(stmt);
+static void _history_paste_init(dt_history_paste_t *p, int32_t imgid, gboolean merge, GList *ops)
+{
+  sqlite3_stmt *stmt;
+  p->merge = merge;
+  p->ops = ops;
 
   /* delete all items from the temp styles_items, this table is used only to get a ROWNUM of the results */
   DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "DELETE FROM memory.style_items", NULL, NULL, NULL);
 
-  /* copy history items from styles onto temp table */
+  /* copy history items from styles onto temp table, once for all destination images */
 
   //  prepare SQL request
   char req[2048];
@@ -316,13 +287,22 @@ int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboole
     }
     g_strlcat(req, ")", sizeof(req));
   }
+  g_strlcat(req, " ORDER BY num", sizeof(req));
 
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), req, -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
   sqlite3_finalize(stmt);
 
-  /* copy the history items into the history of the dest image */
+  // first trim the stack to get rid of whatever is above the selected entry
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "DELETE FROM main.history WHERE imgid = ?1 AND num >= (SELECT history_end "
+                              "FROM main.images WHERE id = imgid)", -1, &p->trim_history, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "SELECT IFNULL(MAX(num), -1)+1 FROM main.history WHERE imgid = ?1",
+                              -1, &p->history_offset, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM main.history WHERE imgid = ?1", -1,
+                              &p->delete_history, NULL);
   /* note: rowid starts at 1 while num has to start at 0! */
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "INSERT INTO main.history "
@@ -330,17 +310,70 @@ int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboole
                               "version,multi_priority,multi_name) SELECT "
                               "?1,?2+rowid-1,module,operation,op_params,enabled,blendop_params,blendop_"
                               "version,multi_priority,multi_name FROM memory.style_items",
-                              -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, offs);
+                              -1, &p->insert_history, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM main.mask WHERE imgid = ?1", -1,
+                              &p->delete_masks, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT INTO main.mask (imgid, formid, form, name, version, points, points_count, "
+                              "source) SELECT ?1, formid, form, name, version, points, points_count, source FROM "
+                              "main.mask WHERE imgid = ?2",
+                              -1, &p->insert_masks, NULL);
+  // always make the whole stack active
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "UPDATE main.images SET history_end = (SELECT MAX(num) + 1 FROM main.history "
+                              "WHERE imgid = ?1) WHERE id = ?1",
+                              -1, &p->history_end, NULL);
+}
+
+static void _history_paste_cleanup(dt_history_paste_t *p)
+{
+  sqlite3_finalize(p->trim_history);
+  sqlite3_finalize(p->history_offset);
+  sqlite3_finalize(p->delete_history);
+  sqlite3_finalize(p->insert_history);
+  sqlite3_finalize(p->delete_masks);
+  sqlite3_finalize(p->insert_masks);
+  sqlite3_finalize(p->history_end);
+}
+
+// run a prepared statement that doesn't return anything for one image and make it ready for the next one
+static void _history_paste_step(sqlite3_stmt *stmt, const int32_t imgid)
+{
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
   sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  sqlite3_reset(stmt);
+  sqlite3_clear_bindings(stmt);
+}
+
+static void _history_paste_on_image(dt_history_paste_t *p, int32_t imgid, int32_t dest_imgid)
+{
+  /* if merge onto history stack, lets find history offest in destination image */
+  int32_t offs = 0;
+  if(p->merge)
+  {
+    /* apply on top of history stack */
+    _history_paste_step(p->trim_history, dest_imgid);
+
+    DT_DEBUG_SQLITE3_BIND_INT(p->history_offset, 1, dest_imgid);
+    if(sqlite3_step(p->history_offset) == SQLITE_ROW) offs = sqlite3_column_int(p->history_offset, 0);
+    sqlite3_reset(p->history_offset);
+    sqlite3_clear_bindings(p->history_offset);
+  }
+  else
+  {
+    /* replace history stack */
+    _history_paste_step(p->delete_history, dest_imgid);
+  }
+
+  /* copy the history items into the history of the dest image */
+  DT_DEBUG_SQLITE3_BIND_INT(p->insert_history, 2, offs);
+  _history_paste_step(p->insert_history, dest_imgid);
 
-  if(merge && ops) _dt_history_cleanup_multi_instance(dest_imgid, offs);
+  if(p->merge && p->ops) _dt_history_cleanup_multi_instance(dest_imgid, offs);
 
   // we have to copy masks too
   // what to do with existing masks ?
-  if(merge)
+  if(p->merge)
   {
     // there's very little chance that we will have same shapes id.
     // but we may want to handle this case anyway
@@ -349,31 +382,14 @@ int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboole
   else
   {
     // let's remove all existing shapes
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "DELETE FROM main.mask WHERE imgid = ?1", -1, &stmt,
-                                NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-    sqlite3_step(stmt);
-    sqlite3_finalize(stmt);
+    _history_paste_step(p->delete_masks, dest_imgid);
   }
 
   // let's copy now
-  g_strlcpy(req, "INSERT INTO main.mask (imgid, formid, form, name, version, points, points_count, source) SELECT "
-                 "?1, formid, form, name, version, points, points_count, source FROM main.mask WHERE imgid = ?2",
-            sizeof(req));
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), req, -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, imgid);
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  DT_DEBUG_SQLITE3_BIND_INT(p->insert_masks, 2, imgid);
+  _history_paste_step(p->insert_masks, dest_imgid);
 
-  // always make the whole stack active
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "UPDATE main.images SET history_end = (SELECT MAX(num) + 1 FROM main.history "
-                              "WHERE imgid = ?1) WHERE id = ?1",
-                              -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dest_imgid);
-  sqlite3_step(stmt);
-  sqlite3_finalize(stmt);
+  _history_paste_step(p->history_end, dest_imgid);
 
   /* if current image in develop reload history */
   if(dt_dev_is_current_image(darktable.develop, dest_imgid))
@@ -386,6 +402,31 @@ int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboole
   dt_image_synch_xmp(dest_imgid);
 
   dt_mipmap_cache_remove(darktable.mipmap_cache, dest_imgid);
+}
+
+static gboolean _history_paste_check_source(int32_t imgid)
+{
+  if(imgid == -1)
+  {
+    dt_control_log(_("you need to copy history from an image before you paste it onto another"));
+    return FALSE;
+  }
+
+  // be sure the current history is written before pasting some other history data
+  const dt_view_t *cv = dt_view_manager_get_current_view(darktable.view_manager);
+  if(cv->view((dt_view_t *)cv) == DT_VIEW_DARKROOM) dt_dev_write_history(darktable.develop);
+  return TRUE;
+}
+
+int dt_history_copy_and_paste_on_image(int32_t imgid, int32_t dest_imgid, gboolean merge, GList *ops)
+{
+  if(imgid == dest_imgid) return 1;
+  if(!_history_paste_check_source(imgid)) return 1;
+
+  dt_history_paste_t p;
+  _history_paste_init(&p, imgid, merge, ops);
+  _history_paste_on_image(&p, imgid, dest_imgid);
+  _history_paste_cleanup(&p);
 
   return 0;
 }
@@ -476,28 +517,34 @@ int dt_history_copy_and_paste_on_selection(int32_t imgid, gboolean merge, GList
 {
   if(imgid < 0) return 1;
 
-  int res = 0;
+  GList *dest = NULL;
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                               "SELECT imgid FROM main.selected_images WHERE imgid != ?1", -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, imgid);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  while(sqlite3_step(stmt) == SQLITE_ROW) dest = g_list_prepend(dest, GINT_TO_POINTER(sqlite3_column_int(stmt, 0)));
+  sqlite3_finalize(stmt);
+
+  if(!dest) return 1;
+  dest = g_list_reverse(dest);
+
+  if(_history_paste_check_source(imgid))
   {
-    do
+    // one transaction and one set of statements for all the images
+    dt_database_start_transaction(darktable.db);
+    dt_history_paste_t p;
+    _history_paste_init(&p, imgid, merge, ops);
+    for(GList *l = dest; l; l = g_list_next(l))
     {
-      /* get imgid of selected image */
-      int32_t dest_imgid = sqlite3_column_int(stmt, 0);
-
       /* paste history stack onto image id */
-      dt_history_copy_and_paste_on_image(imgid, dest_imgid, merge, ops);
-
-    } while(sqlite3_step(stmt) == SQLITE_ROW);
+      _history_paste_on_image(&p, imgid, GPOINTER_TO_INT(l->data));
+    }
+    _history_paste_cleanup(&p);
+    dt_database_release_transaction(darktable.db);
   }
-  else
-    res = 1;
 
-  sqlite3_finalize(stmt);
-  return res;
+  g_list_free(dest);
+  return 0;
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -384,7 +384,7 @@ dt_image_orientation_t dt_image_get_orientation(const int imgid)
   dt_image_orientation_t orientation = ORIENTATION_NULL;
 
   // db lookup flip params
-  if(flip && flip->get_p)
+  if(flip && !dt_iop_so_load(flip) && flip->get_p)
   {
     sqlite3_stmt *stmt;
     DT_DEBUG_SQLITE3_PREPARE_V2(
@@ -575,6 +575,8 @@ void dt_image_remove(const int32_t imgid)
 
   if(dt_image_local_copy_reset(imgid)) return;
 
+  dt_image_cancel_sidecar_file(imgid);
+
   sqlite3_stmt *stmt;
   const dt_image_t *img = dt_image_cache_get(darktable.image_cache, imgid, 'r');
   int old_group_id = img->group_id;
@@ -751,7 +753,8 @@ void dt_image_read_duplicates(const uint32_t id, const char *filename)
 }
 
 
-static uint32_t dt_image_import_internal(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs, gboolean lua_locking)
+static uint32_t dt_image_import_internal(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs, gboolean lua_locking,
+                                         dt_exif_prefetch_t *prefetch)
 {
   char *normalized_filename = dt_util_normalize_path(filename);
   if(!normalized_filename || !g_file_test(normalized_filename, G_FILE_TEST_IS_REGULAR) || dt_util_get_file_size(normalized_filename) == 0)
@@ -947,13 +950,22 @@ static uint32_t dt_image_import_internal(const int32_t film_id, const char *file
   img->group_id = group_id;
 
   // read dttags and exif for database queries!
-  (void)dt_exif_read(img, normalized_filename);
-  char dtfilename[PATH_MAX] = { 0 };
-  g_strlcpy(dtfilename, normalized_filename, sizeof(dtfilename));
-  // dt_image_path_append_version(id, dtfilename, sizeof(dtfilename));
-  g_strlcat(dtfilename, ".xmp", sizeof(dtfilename));
+  int res;
+  if(prefetch)
+  {
+    (void)dt_exif_read_prefetched(img, prefetch);
+    res = dt_exif_xmp_read_prefetched(img, prefetch, 0);
+  }
+  else
+  {
+    (void)dt_exif_read(img, normalized_filename);
+    char dtfilename[PATH_MAX] = { 0 };
+    g_strlcpy(dtfilename, normalized_filename, sizeof(dtfilename));
+    // dt_image_path_append_version(id, dtfilename, sizeof(dtfilename));
+    g_strlcat(dtfilename, ".xmp", sizeof(dtfilename));
 
-  int res = dt_exif_xmp_read(img, dtfilename, 0);
+    res = dt_exif_xmp_read(img, dtfilename, 0);
+  }
 
   // write through to db, but not to xmp.
   dt_image_cache_write_release(darktable.image_cache, img, DT_IMAGE_CACHE_RELAXED);
@@ -1008,12 +1020,18 @@ static uint32_t dt_image_import_internal(const int32_t film_id, const char *file
 
 uint32_t dt_image_import(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs)
 {
-  return dt_image_import_internal(film_id, filename, override_ignore_jpegs, TRUE);
+  return dt_image_import_internal(film_id, filename, override_ignore_jpegs, TRUE, NULL);
+}
+
+uint32_t dt_image_import_prefetched(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs,
+                                    dt_exif_prefetch_t *prefetch)
+{
+  return dt_image_import_internal(film_id, filename, override_ignore_jpegs, TRUE, prefetch);
 }
 
 uint32_t dt_image_import_lua(const int32_t film_id, const char *filename, gboolean override_ignore_jpegs)
 {
-  return dt_image_import_internal(film_id, filename, override_ignore_jpegs, FALSE);
+  return dt_image_import_internal(film_id, filename, override_ignore_jpegs, FALSE, NULL);
 }
 
 void dt_image_init(dt_image_t *img)
@@ -1567,12 +1585,132 @@ void dt_image_write_sidecar_file(int imgid)
   }
 }
 
+// sidecar files waiting to be written by the background writer. an image that gets touched again before its
+// sidecar was written is only written once.
+static struct
+{
+  GMutex lock;
+  GCond cond;
+  GThread *thread;
+  GHashTable *pending; // imgid -> nothing
+  gint64 deadline;     // monotonic time at which the pending sidecars get written, set by the oldest one
+  gboolean quit;
+  uint64_t written, coalesced;
+} _sidecar_queue;
+
+static void _sidecar_queue_write_all(GHashTable *pending)
+{
+  GHashTableIter iter;
+  gpointer key;
+  g_hash_table_iter_init(&iter, pending);
+  while(g_hash_table_iter_next(&iter, &key, NULL)) dt_image_write_sidecar_file(GPOINTER_TO_INT(key));
+}
+
+static gpointer _sidecar_queue_run(gpointer data)
+{
+  g_mutex_lock(&_sidecar_queue.lock);
+  while(!_sidecar_queue.quit)
+  {
+    if(g_hash_table_size(_sidecar_queue.pending) == 0)
+    {
+      g_cond_wait(&_sidecar_queue.cond, &_sidecar_queue.lock);
+      continue;
+    }
+    // give the user some time to keep on changing the same images
+    if(g_cond_wait_until(&_sidecar_queue.cond, &_sidecar_queue.lock, _sidecar_queue.deadline)
+       && g_get_monotonic_time() < _sidecar_queue.deadline)
+      continue;
+
+    GHashTable *pending = _sidecar_queue.pending;
+    _sidecar_queue.pending = g_hash_table_new(NULL, NULL);
+    g_mutex_unlock(&_sidecar_queue.lock);
+
+    const double start = dt_get_wtime();
+    _sidecar_queue_write_all(pending);
+
+    g_mutex_lock(&_sidecar_queue.lock);
+    _sidecar_queue.written += g_hash_table_size(pending);
+    dt_print(DT_DEBUG_PERF, "[xmp] wrote %u sidecar files in %.3f secs, %" PRIu64 " written and %" PRIu64
+                            " writes coalesced so far\n",
+             g_hash_table_size(pending), dt_get_wtime() - start, _sidecar_queue.written,
+             _sidecar_queue.coalesced);
+    g_hash_table_destroy(pending);
+  }
+  g_mutex_unlock(&_sidecar_queue.lock);
+  return NULL;
+}
+
+void dt_image_queue_sidecar_file(const int imgid)
+{
+  if(imgid <= 0 || !dt_conf_get_bool("write_sidecar_files")) return;
+
+  const int delay = dt_conf_get_int("write_sidecar_files_delay");
+  if(delay <= 0)
+  {
+    dt_image_write_sidecar_file(imgid);
+    return;
+  }
+
+  g_mutex_lock(&_sidecar_queue.lock);
+  if(!_sidecar_queue.pending) _sidecar_queue.pending = g_hash_table_new(NULL, NULL);
+  if(!_sidecar_queue.thread && !_sidecar_queue.quit)
+    _sidecar_queue.thread = g_thread_new("sidecar writer", _sidecar_queue_run, NULL);
+
+  if(!_sidecar_queue.thread)
+  {
+    // shutting down already, don't leave it lying around
+    g_mutex_unlock(&_sidecar_queue.lock);
+    dt_image_write_sidecar_file(imgid);
+    return;
+  }
+
+  // the deadline is set by the first change only, pushing it back on every change would never write anything
+  // while the user keeps on editing
+  if(g_hash_table_size(_sidecar_queue.pending) == 0)
+    _sidecar_queue.deadline = g_get_monotonic_time() + (gint64)delay * G_TIME_SPAN_MILLISECOND;
+  if(g_hash_table_contains(_sidecar_queue.pending, GINT_TO_POINTER(imgid)))
+    _sidecar_queue.coalesced++;
+  else
+    g_hash_table_add(_sidecar_queue.pending, GINT_TO_POINTER(imgid));
+  g_cond_broadcast(&_sidecar_queue.cond);
+  g_mutex_unlock(&_sidecar_queue.lock);
+}
+
+void dt_image_cancel_sidecar_file(const int imgid)
+{
+  g_mutex_lock(&_sidecar_queue.lock);
+  if(_sidecar_queue.pending) g_hash_table_remove(_sidecar_queue.pending, GINT_TO_POINTER(imgid));
+  g_mutex_unlock(&_sidecar_queue.lock);
+}
+
+void dt_image_sidecar_cleanup()
+{
+  g_mutex_lock(&_sidecar_queue.lock);
+  _sidecar_queue.quit = TRUE;
+  GThread *thread = _sidecar_queue.thread;
+  _sidecar_queue.thread = NULL;
+  g_cond_broadcast(&_sidecar_queue.cond);
+  g_mutex_unlock(&_sidecar_queue.lock);
+
+  if(thread) g_thread_join(thread);
+
+  // whatever is still pending gets written right away
+  g_mutex_lock(&_sidecar_queue.lock);
+  GHashTable *pending = _sidecar_queue.pending;
+  _sidecar_queue.pending = NULL;
+  g_mutex_unlock(&_sidecar_queue.lock);
+  if(pending)
+  {
+    _sidecar_queue_write_all(pending);
+    g_hash_table_destroy(pending);
+  }
+}
 
 void dt_image_synch_xmp(const int selected)
 {
   if(selected > 0)
   {
-    dt_image_write_sidecar_file(selected);
+    dt_image_queue_sidecar_file(selected);
   }
   else if(dt_conf_get_bool("write_sidecar_files"))
   {
@@ -1582,7 +1720,7 @@ void dt_image_synch_xmp(const int selected)
     while(sqlite3_step(stmt) == SQLITE_ROW)
     {
       const int imgid = sqlite3_column_int(stmt, 0);
-      dt_image_write_sidecar_file(imgid);
+      dt_image_queue_sidecar_file(imgid);
     }
     sqlite3_finalize(stmt);
   }
@@ -213,6 +213,11 @@ void dt_image_print_exif(const dt_image_t *img, char *line, size_t line_len);
 void dt_image_read_duplicates(uint32_t id, const char *filename);
 /** imports a new image from raw/etc file and adds it to the data base and image cache. Use from threads other than lua.*/
 uint32_t dt_image_import(int32_t film_id, const char *filename, gboolean override_ignore_jpegs);
+/** same as dt_image_import(), but takes the image and sidecar metadata from a dt_exif_prefetch() done
+ * earlier, possibly on another thread. */
+struct dt_exif_prefetch_t;
+uint32_t dt_image_import_prefetched(int32_t film_id, const char *filename, gboolean override_ignore_jpegs,
+                                    struct dt_exif_prefetch_t *prefetch);
 /** imports a new image from raw/etc file and adds it to the data base and image cache. Use from lua thread.*/
 uint32_t dt_image_import_lua(int32_t film_id, const char *filename, gboolean override_ignore_jpegs);
 /** removes the given image from the database. */
@@ -281,6 +286,13 @@ gboolean dt_image_safe_remove(const int32_t imgid);
 void dt_image_local_copy_synch(void);
 // xmp functions:
 void dt_image_write_sidecar_file(int imgid);
+// write the sidecar file in the background after write_sidecar_files_delay, repeated requests are merged
+void dt_image_queue_sidecar_file(const int imgid);
+// drop a queued sidecar write, the image is going away
+void dt_image_cancel_sidecar_file(const int imgid);
+// write what is still queued and stop the background writer
+void dt_image_sidecar_cleanup();
+// queue the sidecar files of the given image, or the selected ones if selected <= 0
 void dt_image_synch_xmp(const int selected);
 void dt_image_synch_all_xmp(const gchar *pathname);
 
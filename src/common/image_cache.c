@@ -21,132 +21,159 @@
 #include "common/debug.h"
 #include "common/exif.h"
 #include "common/image.h"
+#include "common/utility.h"
 #include "control/conf.h"
 #include "develop/develop.h"
 
 #include <sqlite3.h>
 
-void dt_image_cache_allocate(void *data, dt_cache_entry_t *entry)
-{
-  entry->cost = sizeof(dt_image_t);
+#define IMAGE_CACHE_COLUMNS                                                                                   \
+  "id, group_id, film_id, width, height, filename, maker, model, lens, exposure, "                            \
+  "aperture, iso, focal_length, datetime_taken, flags, crop, orientation, focus_distance, "                   \
+  "raw_parameters, longitude, latitude, altitude, color_matrix, colorspace, version, raw_black, "             \
+  "raw_maximum"
 
-  dt_image_t *img = (dt_image_t *)g_malloc(sizeof(dt_image_t));
-  dt_image_init(img);
-  entry->data = img;
-  // load stuff from db and store in cache:
+// fill img from one row selected with IMAGE_CACHE_COLUMNS
+static void _image_cache_read_row(dt_image_t *img, sqlite3_stmt *stmt)
+{
   char *str;
-  sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(
-      dt_database_get(darktable.db),
-      "SELECT id, group_id, film_id, width, height, filename, maker, model, lens, exposure, "
-      "aperture, iso, focal_length, datetime_taken, flags, crop, orientation, focus_distance, "
-      "raw_parameters, longitude, latitude, altitude, color_matrix, colorspace, version, raw_black, "
-      "raw_maximum FROM main.images WHERE id = ?1",
-      -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, entry->key);
-  if(sqlite3_step(stmt) == SQLITE_ROW)
+  img->id = sqlite3_column_int(stmt, 0);
+  img->group_id = sqlite3_column_int(stmt, 1);
+  img->film_id = sqlite3_column_int(stmt, 2);
+  img->width = sqlite3_column_int(stmt, 3);
+  img->height = sqlite3_column_int(stmt, 4);
+  img->crop_x = img->crop_y = img->crop_width = img->crop_height = 0;
+  img->filename[0] = img->exif_maker[0] = img->exif_model[0] = img->exif_lens[0]
+      = img->exif_datetime_taken[0] = '\0';
+  str = (char *)sqlite3_column_text(stmt, 5);
+  if(str) g_strlcpy(img->filename, str, sizeof(img->filename));
+  str = (char *)sqlite3_column_text(stmt, 6);
+  if(str) g_strlcpy(img->exif_maker, str, sizeof(img->exif_maker));
+  str = (char *)sqlite3_column_text(stmt, 7);
+  if(str) g_strlcpy(img->exif_model, str, sizeof(img->exif_model));
+  str = (char *)sqlite3_column_text(stmt, 8);
+  if(str) g_strlcpy(img->exif_lens, str, sizeof(img->exif_lens));
+  img->exif_exposure = sqlite3_column_double(stmt, 9);
+  img->exif_aperture = sqlite3_column_double(stmt, 10);
+  img->exif_iso = sqlite3_column_double(stmt, 11);
+  img->exif_focal_length = sqlite3_column_double(stmt, 12);
+  str = (char *)sqlite3_column_text(stmt, 13);
+  if(str) g_strlcpy(img->exif_datetime_taken, str, sizeof(img->exif_datetime_taken));
+  img->flags = sqlite3_column_int(stmt, 14);
+  img->loader = LOADER_UNKNOWN;
+  img->exif_crop = sqlite3_column_double(stmt, 15);
+  img->orientation = sqlite3_column_int(stmt, 16);
+  img->exif_focus_distance = sqlite3_column_double(stmt, 17);
+  if(img->exif_focus_distance >= 0 && img->orientation >= 0) img->exif_inited = 1;
+  uint32_t tmp = sqlite3_column_int(stmt, 18);
+  memcpy(&img->legacy_flip, &tmp, sizeof(dt_image_raw_parameters_t));
+  if(sqlite3_column_type(stmt, 19) == SQLITE_FLOAT)
+    img->longitude = sqlite3_column_double(stmt, 19);
+  else
+    img->longitude = NAN;
+  if(sqlite3_column_type(stmt, 20) == SQLITE_FLOAT)
+    img->latitude = sqlite3_column_double(stmt, 20);
+  else
+    img->latitude = NAN;
+  if(sqlite3_column_type(stmt, 21) == SQLITE_FLOAT)
+    img->elevation = sqlite3_column_double(stmt, 21);
+  else
+    img->elevation = NAN;
+  const void *color_matrix = sqlite3_column_blob(stmt, 22);
+  if(color_matrix)
+    memcpy(img->d65_color_matrix, color_matrix, sizeof(img->d65_color_matrix));
+  else
+    img->d65_color_matrix[0] = NAN;
+  g_free(img->profile);
+  img->profile = NULL;
+  img->profile_size = 0;
+  img->colorspace = sqlite3_column_int(stmt, 23);
+  img->version = sqlite3_column_int(stmt, 24);
+  img->raw_black_level = sqlite3_column_int(stmt, 25);
+  for(uint8_t i = 0; i < 4; i++) img->raw_black_level_separate[i] = 0;
+  img->raw_white_point = sqlite3_column_int(stmt, 26);
+
+  // buffer size?
+  if(img->flags & DT_IMAGE_LDR)
   {
-    img->id = sqlite3_column_int(stmt, 0);
-    img->group_id = sqlite3_column_int(stmt, 1);
-    img->film_id = sqlite3_column_int(stmt, 2);
-    img->width = sqlite3_column_int(stmt, 3);
-    img->height = sqlite3_column_int(stmt, 4);
-    img->crop_x = img->crop_y = img->crop_width = img->crop_height = 0;
-    img->filename[0] = img->exif_maker[0] = img->exif_model[0] = img->exif_lens[0]
-        = img->exif_datetime_taken[0] = '\0';
-    str = (char *)sqlite3_column_text(stmt, 5);
-    if(str) g_strlcpy(img->filename, str, sizeof(img->filename));
-    str = (char *)sqlite3_column_text(stmt, 6);
-    if(str) g_strlcpy(img->exif_maker, str, sizeof(img->exif_maker));
-    str = (char *)sqlite3_column_text(stmt, 7);
-    if(str) g_strlcpy(img->exif_model, str, sizeof(img->exif_model));
-    str = (char *)sqlite3_column_text(stmt, 8);
-    if(str) g_strlcpy(img->exif_lens, str, sizeof(img->exif_lens));
-    img->exif_exposure = sqlite3_column_double(stmt, 9);
-    img->exif_aperture = sqlite3_column_double(stmt, 10);
-    img->exif_iso = sqlite3_column_double(stmt, 11);
-    img->exif_focal_length = sqlite3_column_double(stmt, 12);
-    str = (char *)sqlite3_column_text(stmt, 13);
-    if(str) g_strlcpy(img->exif_datetime_taken, str, sizeof(img->exif_datetime_taken));
-    img->flags = sqlite3_column_int(stmt, 14);
-    img->loader = LOADER_UNKNOWN;
-    img->exif_crop = sqlite3_column_double(stmt, 15);
-    img->orientation = sqlite3_column_int(stmt, 16);
-    img->exif_focus_distance = sqlite3_column_double(stmt, 17);
-    if(img->exif_focus_distance >= 0 && img->orientation >= 0) img->exif_inited = 1;
-    uint32_t tmp = sqlite3_column_int(stmt, 18);
-    memcpy(&img->legacy_flip, &tmp, sizeof(dt_image_raw_parameters_t));
-    if(sqlite3_column_type(stmt, 19) == SQLITE_FLOAT)
-      img->longitude = sqlite3_column_double(stmt, 19);
-    else
-      img->longitude = NAN;
-    if(sqlite3_column_type(stmt, 20) == SQLITE_FLOAT)
-      img->latitude = sqlite3_column_double(stmt, 20);
-    else
-      img->latitude = NAN;
-    if(sqlite3_column_type(stmt, 21) == SQLITE_FLOAT)
-      img->elevation = sqlite3_column_double(stmt, 21);
-    else
-      img->elevation = NAN;
-    const void *color_matrix = sqlite3_column_blob(stmt, 22);
-    if(color_matrix)
-      memcpy(img->d65_color_matrix, color_matrix, sizeof(img->d65_color_matrix));
+    img->buf_dsc.channels = 4;
+    img->buf_dsc.datatype = TYPE_FLOAT;
+  }
+  else if(img->flags & DT_IMAGE_HDR)
+  {
+    if(img->flags & DT_IMAGE_RAW)
+    {
+      img->buf_dsc.channels = 1;
+      img->buf_dsc.datatype = TYPE_FLOAT;
+    }
     else
-      img->d65_color_matrix[0] = NAN;
-    g_free(img->profile);
-    img->profile = NULL;
-    img->profile_size = 0;
-    img->colorspace = sqlite3_column_int(stmt, 23);
-    img->version = sqlite3_column_int(stmt, 24);
-    img->raw_black_level = sqlite3_column_int(stmt, 25);
-    for(uint8_t i = 0; i < 4; i++) img->raw_black_level_separate[i] = 0;
-    img->raw_white_point = sqlite3_column_int(stmt, 26);
-
-    // buffer size?
-    if(img->flags & DT_IMAGE_LDR)
     {
       img->buf_dsc.channels = 4;
       img->buf_dsc.datatype = TYPE_FLOAT;
     }
-    else if(img->flags & DT_IMAGE_HDR)
+  }
+  else
+  {
+    // raw
+    img->buf_dsc.channels = 1;
+    img->buf_dsc.datatype = TYPE_UINT16;
+  }
+}
+
+void dt_image_cache_allocate(void *data, dt_cache_entry_t *entry)
+{
+  dt_image_cache_t *cache = (dt_image_cache_t *)data;
+  entry->cost = sizeof(dt_image_t);
+
+  // maybe dt_image_cache_prefetch() already loaded this one for us
+  dt_pthread_mutex_lock(&cache->prefetch_lock);
+  dt_image_t *img = g_hash_table_lookup(cache->prefetched, GINT_TO_POINTER(entry->key));
+  if(img) g_hash_table_steal(cache->prefetched, GINT_TO_POINTER(entry->key));
+  dt_pthread_mutex_unlock(&cache->prefetch_lock);
+
+  if(!img)
+  {
+    img = (dt_image_t *)g_malloc(sizeof(dt_image_t));
+    dt_image_init(img);
+
+    // load stuff from db. we are called with the cache lock held, so the statement can be shared.
+    if(!cache->select_stmt)
+      DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                  "SELECT " IMAGE_CACHE_COLUMNS " FROM main.images WHERE id = ?1", -1,
+                                  &cache->select_stmt, NULL);
+    sqlite3_stmt *stmt = cache->select_stmt;
+    DT_DEBUG_SQLITE3_RESET(stmt);
+    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(stmt);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, entry->key);
+    if(sqlite3_step(stmt) == SQLITE_ROW)
     {
-      if(img->flags & DT_IMAGE_RAW)
-      {
-        img->buf_dsc.channels = 1;
-        img->buf_dsc.datatype = TYPE_FLOAT;
-      }
-      else
-      {
-        img->buf_dsc.channels = 4;
-        img->buf_dsc.datatype = TYPE_FLOAT;
-      }
+      _image_cache_read_row(img, stmt);
     }
     else
     {
-      // raw
-      img->buf_dsc.channels = 1;
-      img->buf_dsc.datatype = TYPE_UINT16;
+      img->id = -1;
+      fprintf(stderr, "[image_cache_allocate] failed to open image %d from database: %s\n", entry->key,
+              sqlite3_errmsg(dt_database_get(darktable.db)));
     }
+    DT_DEBUG_SQLITE3_RESET(stmt);
   }
-  else
-  {
-    img->id = -1;
-    fprintf(stderr, "[image_cache_allocate] failed to open image %d from database: %s\n", entry->key,
-            sqlite3_errmsg(dt_database_get(darktable.db)));
-  }
-  sqlite3_finalize(stmt);
+  entry->data = img;
   img->cache_entry = entry; // init backref
   // could downgrade lock write->read on entry->lock if we were using concurrencykit..
   dt_image_refresh_makermodel(img);
 }
 
-void dt_image_cache_deallocate(void *data, dt_cache_entry_t *entry)
+static void _image_cache_free_image(dt_image_t *img)
 {
-  dt_image_t *img = (dt_image_t *)entry->data;
   g_free(img->profile);
   g_free(img);
 }
 
+void dt_image_cache_deallocate(void *data, dt_cache_entry_t *entry)
+{
+  _image_cache_free_image((dt_image_t *)entry->data);
+}
+
 void dt_image_cache_init(dt_image_cache_t *cache)
 {
   // the image cache does no serialization.
@@ -160,6 +187,9 @@ void dt_image_cache_init(dt_image_cache_t *cache)
   dt_cache_init(&cache->cache, sizeof(dt_image_t), max_mem);
   dt_cache_set_allocate_callback(&cache->cache, &dt_image_cache_allocate, cache);
   dt_cache_set_cleanup_callback(&cache->cache, &dt_image_cache_deallocate, cache);
+  cache->select_stmt = NULL;
+  dt_pthread_mutex_init(&cache->prefetch_lock, NULL);
+  cache->prefetched = g_hash_table_new(NULL, NULL);
 
   dt_print(DT_DEBUG_CACHE, "[image_cache] has %d entries\n", num);
 }
@@ -167,6 +197,10 @@ void dt_image_cache_init(dt_image_cache_t *cache)
 void dt_image_cache_cleanup(dt_image_cache_t *cache)
 {
   dt_cache_cleanup(&cache->cache);
+  sqlite3_finalize(cache->select_stmt);
+  cache->select_stmt = NULL;
+  g_hash_table_destroy(cache->prefetched);
+  dt_pthread_mutex_destroy(&cache->prefetch_lock);
 }
 
 void dt_image_cache_print(dt_image_cache_t *cache)
@@ -197,6 +231,83 @@ dt_image_t *dt_image_cache_testget(dt_image_cache_t *cache, const uint32_t imgid
   return img;
 }
 
+// at most this many ids go into one sql query
+#define IMAGE_CACHE_PREFETCH_CHUNK 500
+
+static int _image_cache_prefetch_chunk(dt_image_cache_t *cache, const int32_t *imgids, const int count)
+{
+  gchar *query = NULL;
+  int missing = 0;
+  for(int k = 0; k < count; k++)
+  {
+    if(imgids[k] <= 0 || dt_cache_contains(&cache->cache, imgids[k])) continue;
+    query = dt_util_dstrcat(query, "%s%d",
+                            missing ? "," : "SELECT " IMAGE_CACHE_COLUMNS " FROM main.images WHERE id IN (",
+                            imgids[k]);
+    missing++;
+  }
+  if(!missing) return 0;
+  query = dt_util_dstrcat(query, ")");
+
+  // load all the missing rows in one go and park them where dt_image_cache_allocate() will pick them up
+  GList *loaded = NULL;
+  sqlite3_stmt *stmt;
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get_reader(darktable.db), query, -1, &stmt, NULL);
+  dt_pthread_mutex_lock(&cache->prefetch_lock);
+  while(sqlite3_step(stmt) == SQLITE_ROW)
+  {
+    dt_image_t *img = (dt_image_t *)g_malloc(sizeof(dt_image_t));
+    dt_image_init(img);
+    _image_cache_read_row(img, stmt);
+    if(g_hash_table_contains(cache->prefetched, GINT_TO_POINTER(img->id)))
+    {
+      _image_cache_free_image(img);
+      continue;
+    }
+    g_hash_table_insert(cache->prefetched, GINT_TO_POINTER(img->id), img);
+    loaded = g_list_prepend(loaded, GINT_TO_POINTER(img->id));
+  }
+  dt_pthread_mutex_unlock(&cache->prefetch_lock);
+  sqlite3_finalize(stmt);
+  g_free(query);
+
+  // now move them into the cache while they are fresh
+  for(GList *iter = loaded; iter; iter = g_list_next(iter))
+  {
+    const dt_image_t *img = dt_image_cache_get(cache, GPOINTER_TO_INT(iter->data), 'r');
+    dt_image_cache_read_release(cache, img);
+  }
+
+  // whatever is left got into the cache some other way in the meantime and must not be used later on
+  dt_pthread_mutex_lock(&cache->prefetch_lock);
+  for(GList *iter = loaded; iter; iter = g_list_next(iter))
+  {
+    dt_image_t *img = g_hash_table_lookup(cache->prefetched, iter->data);
+    if(!img) continue;
+    g_hash_table_remove(cache->prefetched, iter->data);
+    _image_cache_free_image(img);
+  }
+  dt_pthread_mutex_unlock(&cache->prefetch_lock);
+
+  g_list_free(loaded);
+  return missing;
+}
+
+void dt_image_cache_prefetch(dt_image_cache_t *cache, const int32_t *imgids, const int count)
+{
+  // don't bother to load more than the cache would keep anyways
+  const int num = MIN(count, cache->cache.cost_quota / sizeof(dt_image_t) / 2);
+  if(num <= 1) return;
+
+  const double start = dt_get_wtime();
+  int missing = 0;
+  for(int k = 0; k < num; k += IMAGE_CACHE_PREFETCH_CHUNK)
+    missing += _image_cache_prefetch_chunk(cache, imgids + k, MIN(IMAGE_CACHE_PREFETCH_CHUNK, num - k));
+
+  dt_print(DT_DEBUG_PERF, "[image_cache] prefetched %d of %d images in %.3f secs\n", missing, num,
+           dt_get_wtime() - start);
+}
+
 // drops the read lock on an image struct
 void dt_image_cache_read_release(dt_image_cache_t *cache, const dt_image_t *img)
 {
@@ -211,6 +322,11 @@ void dt_image_cache_read_release(dt_image_cache_t *cache, const dt_image_t *img)
 void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_image_cache_write_mode_t mode)
 {
   if(img->id <= 0) return;
+  if(mode == DT_IMAGE_CACHE_MEMORY)
+  {
+    dt_cache_release(&cache->cache, img->cache_entry);
+    return;
+  }
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(
       dt_database_get(darktable.db),
@@ -255,7 +371,7 @@ void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_i
   {
     // rest about sidecars:
     // also synch dttags file:
-    dt_image_write_sidecar_file(img->id);
+    dt_image_queue_sidecar_file(img->id);
   }
   dt_cache_release(&cache->cache, img->cache_entry);
 }
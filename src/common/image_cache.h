@@ -21,9 +21,17 @@
 #include "common/cache.h"
 #include "common/image.h"
 
+#include <sqlite3.h>
+
 typedef struct dt_image_cache_t
 {
   dt_cache_t cache;
+
+  // reused for single image lookups, protected by the cache lock
+  sqlite3_stmt *select_stmt;
+  // images loaded in bulk by dt_image_cache_prefetch(), waiting to be moved into the cache
+  dt_pthread_mutex_t prefetch_lock;
+  GHashTable *prefetched;
 }
 dt_image_cache_t;
 
@@ -34,7 +42,9 @@ typedef enum dt_image_cache_write_mode_t
   // always write to database and xmp
   DT_IMAGE_CACHE_SAFE = 0,
   // only write to db and do xmp only during shutdown
-  DT_IMAGE_CACHE_RELAXED = 1
+  DT_IMAGE_CACHE_RELAXED = 1,
+  // write neither, the caller has updated the db already
+  DT_IMAGE_CACHE_MEMORY = 2
 }
 dt_image_cache_write_mode_t;
 
@@ -55,12 +65,17 @@ dt_image_t *dt_image_cache_get(dt_image_cache_t *cache, const uint32_t imgid, ch
 // is currently unavailable.
 dt_image_t *dt_image_cache_testget(dt_image_cache_t *cache, const uint32_t imgid, char mode);
 
+// loads all of the given images that are not cached yet with a single query.
+// use this before walking over many images to avoid one sql round trip per image.
+void dt_image_cache_prefetch(dt_image_cache_t *cache, const int32_t *imgids, const int count);
+
 // drops the read lock on an image struct
 void dt_image_cache_read_release(dt_image_cache_t *cache, const dt_image_t *img);
 
 // drops the write privileges on an image struct.
 // this triggers a write-through to sql, and if the setting
 // is present, also to xmp sidecar files (safe setting).
+// in memory mode only the struct is updated.
 void dt_image_cache_write_release(dt_image_cache_t *cache, dt_image_t *img, dt_image_cache_write_mode_t mode);
 
 // remove the image from the cache
@@ -170,6 +170,12 @@ error:
   return res;
 }
 
+int dt_imageio_get_encode_threads()
+{
+  const int threads = dt_conf_get_int("plugins/imageio/format/encode_threads");
+  return threads > 0 ? MIN(threads, dt_get_num_threads()) : dt_get_num_threads();
+}
+
 void dt_imageio_flip_buffers(char *out, const char *in, const size_t bpp, const int wd, const int ht,
                              const int fwd, const int fht, const int stride,
                              const dt_image_orientation_t orientation)
@@ -524,6 +530,242 @@ void dt_imageio_to_fractional(float in, uint32_t *num, uint32_t *den)
   }
 }
 
+// an exported image waiting in the write queue. owns its pixels, exif blob, xmp packet and a private copy
+// of the format parameters, so the export job is free to go on with the next image.
+typedef struct dt_imageio_export_write_t
+{
+  uint32_t imgid;
+  char *filename;
+  dt_imageio_module_format_t *format;
+  dt_imageio_module_data_t *format_params;
+  void *buf;
+  size_t size;
+  uint8_t *exif;
+  int exif_len;
+  char *xmp;
+  gboolean copy_metadata;
+  dt_imageio_module_storage_t *storage;
+  dt_imageio_module_data_t *storage_params;
+  int num, total;
+  struct dt_imageio_export_batch_t *batch;
+} dt_imageio_export_write_t;
+
+// the queued writes of one export job. each export job runs on a single thread and flushes before it ends,
+// so the batch is kept per thread and dt_imageio_export_flush() only waits for the calling job's writes.
+typedef struct dt_imageio_export_batch_t
+{
+  int pending;
+  int failed;
+} dt_imageio_export_batch_t;
+
+static GPrivate _export_batch = G_PRIVATE_INIT(g_free);
+
+// a single writer thread: encoding already runs multi-threaded where the format allows it,
+// and the point is to overlap i/o with the pixelpipe of the next image.
+static struct
+{
+  GMutex lock;
+  GCond done;
+  GThreadPool *pool;
+  size_t bytes;   // pixel memory held by queued writes
+  int pending;    // of all batches
+} _export_queue;
+
+static int _imageio_export_with_flags(const uint32_t imgid, const char *filename,
+                                      dt_imageio_module_format_t *format, dt_imageio_module_data_t *format_params,
+                                      const int32_t ignore_exif, const int32_t display_byteorder,
+                                      const gboolean high_quality, const gboolean upscale,
+                                      const int32_t thumbnail_export, const char *filter,
+                                      const gboolean copy_metadata, dt_imageio_module_storage_t *storage,
+                                      dt_imageio_module_data_t *storage_params, int num, int total,
+                                      const gboolean async);
+
+static void _export_finalize(const uint32_t imgid, const char *filename, dt_imageio_module_format_t *format,
+                             dt_imageio_module_data_t *format_params, const gboolean attach_xmp,
+                             const int32_t thumbnail_export, dt_imageio_module_storage_t *storage,
+                             dt_imageio_module_data_t *storage_params)
+{
+  /* now write xmp into that container, if possible and not embedded by the format already */
+  if(attach_xmp && (format->flags(format_params) & FORMAT_FLAGS_SUPPORT_XMP))
+  {
+    dt_exif_xmp_attach(imgid, filename);
+    // no need to cancel the export if this fail
+  }
+
+  if(!thumbnail_export && strcmp(format->mime(format_params), "memory")
+    && !(format->flags(format_params) & FORMAT_FLAGS_NO_TMPFILE))
+  {
+    dt_control_signal_raise(darktable.signals, DT_SIGNAL_IMAGE_EXPORT_TMPFILE, imgid, filename, format,
+                            format_params, storage, storage_params);
+  }
+}
+
+// the user only gets to hear about an export once the file is actually written
+static void _export_report(const char *filename, const int num, const int total)
+{
+  printf("[export_job] exported to `%s'\n", filename);
+  const char *trunc = filename + strlen(filename) - 32;
+  if(trunc < filename) trunc = filename;
+  dt_control_log(ngettext("%d/%d exported to `%s%s'", "%d/%d exported to `%s%s'", num), num, total,
+                 trunc != filename ? ".." : "", trunc);
+}
+
+static dt_imageio_export_batch_t *_export_batch_get()
+{
+  dt_imageio_export_batch_t *batch = (dt_imageio_export_batch_t *)g_private_get(&_export_batch);
+  if(!batch)
+  {
+    batch = g_new0(dt_imageio_export_batch_t, 1);
+    g_private_set(&_export_batch, batch);
+  }
+  return batch;
+}
+
+static size_t _export_queue_budget()
+{
+  const int mb = dt_conf_get_int("plugins/imageio/export/write_queue_memory");
+  return mb > 0 ? (size_t)mb << 20 : 0;
+}
+
+static void _export_write_free(dt_imageio_export_write_t *w)
+{
+  if(!w) return;
+  w->format->free_params(w->format, w->format_params);
+  dt_free_align(w->buf);
+  free(w->exif);
+  g_free(w->xmp);
+  g_free(w->filename);
+  free(w);
+}
+
+// returns NULL if the write can't be deferred, the caller then has to write synchronously.
+// on success the exif blob and the xmp packet are owned by the returned item.
+static dt_imageio_export_write_t *_export_write_new(const uint32_t imgid, const char *filename,
+                                                    dt_imageio_module_format_t *format,
+                                                    dt_imageio_module_data_t *format_params, const void *pixels,
+                                                    const size_t size, uint8_t *exif, const int exif_len,
+                                                    char *xmp, const gboolean copy_metadata,
+                                                    dt_imageio_module_storage_t *storage,
+                                                    dt_imageio_module_data_t *storage_params, int num, int total)
+{
+  if(_export_queue_budget() == 0) return NULL;
+  if(format->flags(format_params) & FORMAT_FLAGS_NO_ASYNC_WRITE) return NULL;
+  if(!strcmp(format->mime(format_params), "memory")) return NULL;
+
+  dt_imageio_export_write_t *w = (dt_imageio_export_write_t *)calloc(1, sizeof(dt_imageio_export_write_t));
+  if(!w) return NULL;
+  // the module may keep private state (encoder structs, file handles) after the serialized part,
+  // so get a fresh struct from it and only copy the parameters over.
+  w->format_params = format->get_params(format);
+  w->buf = dt_alloc_align(64, size);
+  if(!w->format_params || !w->buf)
+  {
+    if(w->format_params) format->free_params(format, w->format_params);
+    dt_free_align(w->buf);
+    free(w);
+    return NULL;
+  }
+  memcpy(w->format_params, format_params, format->params_size(format));
+  memcpy(w->buf, pixels, size);
+
+  w->imgid = imgid;
+  w->filename = g_strdup(filename);
+  w->format = format;
+  w->size = size;
+  w->exif = exif;
+  w->exif_len = exif_len;
+  w->xmp = xmp;
+  w->copy_metadata = copy_metadata;
+  w->storage = storage;
+  w->storage_params = storage_params;
+  w->num = num;
+  w->total = total;
+  return w;
+}
+
+static void _export_write_run(gpointer data, gpointer user_data)
+{
+  dt_imageio_export_write_t *w = (dt_imageio_export_write_t *)data;
+  const double start = dt_get_wtime();
+
+  const int res = w->format->write_image(w->format_params, w->filename, w->buf, w->exif, w->exif_len, w->xmp,
+                                         w->imgid, w->num, w->total);
+  if(res)
+  {
+    // don't leave the empty file behind that reserved the name
+    GStatBuf st;
+    if(!g_stat(w->filename, &st) && st.st_size == 0) g_unlink(w->filename);
+    fprintf(stderr, "[export] could not write to file: `%s'!\n", w->filename);
+    dt_control_log(_("could not export to file `%s'!"), w->filename);
+  }
+  else
+  {
+    _export_finalize(w->imgid, w->filename, w->format, w->format_params, w->copy_metadata && !w->xmp, FALSE,
+                     w->storage, w->storage_params);
+    _export_report(w->filename, w->num, w->total);
+  }
+
+  dt_print(DT_DEBUG_PERF, "[export] wrote `%s' in %.3f secs\n", w->filename, dt_get_wtime() - start);
+
+  const size_t size = w->size;
+  dt_imageio_export_batch_t *batch = w->batch;
+  _export_write_free(w);
+
+  g_mutex_lock(&_export_queue.lock);
+  _export_queue.bytes -= size;
+  _export_queue.pending--;
+  batch->pending--;
+  if(res) batch->failed++;
+  g_cond_broadcast(&_export_queue.done);
+  g_mutex_unlock(&_export_queue.lock);
+}
+
+static void _export_write_push(dt_imageio_export_write_t *w)
+{
+  const size_t budget = _export_queue_budget();
+  const double start = dt_get_wtime();
+
+  g_mutex_lock(&_export_queue.lock);
+  if(!_export_queue.pool)
+    _export_queue.pool = g_thread_pool_new(_export_write_run, NULL, 1, FALSE, NULL);
+
+  // backpressure: block the pipeline while the queued pixels exceed the memory budget. an image that is
+  // larger than the whole budget on its own still goes through once the queue has drained.
+  while(_export_queue.bytes > 0 && _export_queue.bytes + w->size > budget)
+    g_cond_wait(&_export_queue.done, &_export_queue.lock);
+
+  dt_print(DT_DEBUG_PERF, "[export] queued `%s', waited %.3f secs for the write queue\n", w->filename,
+           dt_get_wtime() - start);
+
+  w->batch = _export_batch_get();
+  _export_queue.bytes += w->size;
+  _export_queue.pending++;
+  w->batch->pending++;
+  g_thread_pool_push(_export_queue.pool, w, NULL);
+  g_mutex_unlock(&_export_queue.lock);
+}
+
+int dt_imageio_export_flush()
+{
+  dt_imageio_export_batch_t *batch = _export_batch_get();
+  g_mutex_lock(&_export_queue.lock);
+  while(batch->pending > 0) g_cond_wait(&_export_queue.done, &_export_queue.lock);
+  const int failed = batch->failed;
+  batch->failed = 0;
+  g_mutex_unlock(&_export_queue.lock);
+  return failed;
+}
+
+void dt_imageio_export_cleanup()
+{
+  g_mutex_lock(&_export_queue.lock);
+  while(_export_queue.pending > 0) g_cond_wait(&_export_queue.done, &_export_queue.lock);
+  GThreadPool *pool = _export_queue.pool;
+  _export_queue.pool = NULL;
+  g_mutex_unlock(&_export_queue.lock);
+  if(pool) g_thread_pool_free(pool, FALSE, TRUE);
+}
+
 int dt_imageio_export(const uint32_t imgid, const char *filename, dt_imageio_module_format_t *format,
                       dt_imageio_module_data_t *format_params, const gboolean high_quality, const gboolean upscale,
                       const gboolean copy_metadata, dt_imageio_module_storage_t *storage,
@@ -531,12 +773,29 @@ int dt_imageio_export(const uint32_t imgid, const char *filename, dt_imageio_mod
 {
   if(strcmp(format->mime(format_params), "x-copy") == 0)
     /* This is a just a copy, skip process and just export */
-    return format->write_image(format_params, filename, NULL, NULL, 0, imgid, num, total);
+    return format->write_image(format_params, filename, NULL, NULL, 0, NULL, imgid, num, total);
   else
     return dt_imageio_export_with_flags(imgid, filename, format, format_params, 0, 0, high_quality, upscale,
                                         0, NULL, copy_metadata, storage, storage_params, num, total);
 }
 
+int dt_imageio_export_async(const uint32_t imgid, const char *filename, dt_imageio_module_format_t *format,
+                            dt_imageio_module_data_t *format_params, const gboolean high_quality,
+                            const gboolean upscale, const gboolean copy_metadata,
+                            dt_imageio_module_storage_t *storage, dt_imageio_module_data_t *storage_params,
+                            int num, int total)
+{
+  if(strcmp(format->mime(format_params), "x-copy") == 0)
+  {
+    const int res = format->write_image(format_params, filename, NULL, NULL, 0, NULL, imgid, num, total);
+    if(!res) _export_report(filename, num, total);
+    return res;
+  }
+  else
+    return _imageio_export_with_flags(imgid, filename, format, format_params, 0, 0, high_quality, upscale, 0,
+                                      NULL, copy_metadata, storage, storage_params, num, total, TRUE);
+}
+
 // internal function: to avoid exif blob reading + 8-bit byteorder flag + high-quality override
 int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
                                  dt_imageio_module_format_t *format, dt_imageio_module_data_t *format_params,
@@ -545,6 +804,20 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
                                  const char *filter, const gboolean copy_metadata,
                                  dt_imageio_module_storage_t *storage,
                                  dt_imageio_module_data_t *storage_params, int num, int total)
+{
+  return _imageio_export_with_flags(imgid, filename, format, format_params, ignore_exif, display_byteorder,
+                                    high_quality, upscale, thumbnail_export, filter, copy_metadata, storage,
+                                    storage_params, num, total, FALSE);
+}
+
+static int _imageio_export_with_flags(const uint32_t imgid, const char *filename,
+                                      dt_imageio_module_format_t *format, dt_imageio_module_data_t *format_params,
+                                      const int32_t ignore_exif, const int32_t display_byteorder,
+                                      const gboolean high_quality, const gboolean upscale,
+                                      const int32_t thumbnail_export, const char *filter,
+                                      const gboolean copy_metadata, dt_imageio_module_storage_t *storage,
+                                      dt_imageio_module_data_t *storage_params, int num, int total,
+                                      const gboolean async)
 {
   dt_develop_t dev;
   dt_dev_init(&dev, 0);
@@ -851,44 +1124,56 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
   format_params->width = processed_width;
   format_params->height = processed_height;
 
+  int length = 0;
+  uint8_t *exif_profile = NULL; // Exif data should be 65536 bytes max, but if original size is close to that,
+                                // adding new tags could make it go over that... so let it be and see what
+                                // happens when we write the image
   if(!ignore_exif)
   {
-    int length;
-    uint8_t *exif_profile = NULL; // Exif data should be 65536 bytes max, but if original size is close to that,
-                                  // adding new tags could make it go over that... so let it be and see what
-                                  // happens when we write the image
     char pathname[PATH_MAX] = { 0 };
     gboolean from_cache = TRUE;
     dt_image_full_path(imgid, pathname, sizeof(pathname), &from_cache);
     // last param is dng mode, it's false here
     length = dt_exif_read_blob(&exif_profile, pathname, imgid, sRGB, processed_width, processed_height, 0);
+  }
 
-    res = format->write_image(format_params, filename, outbuf, exif_profile, length, imgid, num, total);
+  // formats supporting xmp embed the packet while encoding. only if we can't get one, the finished file
+  // has to be opened again by dt_exif_xmp_attach()
+  char *xmp = NULL;
+  if(copy_metadata && (format->flags(format_params) & FORMAT_FLAGS_SUPPORT_XMP))
+    xmp = dt_exif_xmp_read_export_string(imgid);
 
-    free(exif_profile);
-  }
-  else
+  if(async && !thumbnail_export)
   {
-    res = format->write_image(format_params, filename, outbuf, NULL, 0, imgid, num, total);
+    // hand the pixels over to the write queue and let the caller go on with the next image
+    dt_imageio_export_write_t *w
+        = _export_write_new(imgid, filename, format, format_params, outbuf,
+                            (size_t)processed_width * processed_height * 4 * (bpp / 8), exif_profile, length,
+                            xmp, copy_metadata, storage, storage_params, num, total);
+    if(w)
+    {
+      dt_dev_pixelpipe_cleanup(&pipe);
+      dt_dev_cleanup(&dev);
+      dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
+      _export_write_push(w);
+      return 0;
+    }
   }
 
+  res = format->write_image(format_params, filename, outbuf, exif_profile, length, xmp, imgid, num, total);
+
+  free(exif_profile);
+
   dt_dev_pixelpipe_cleanup(&pipe);
   dt_dev_cleanup(&dev);
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
 
-  /* now write xmp into that container, if possible */
-  if(copy_metadata && (format->flags(format_params) & FORMAT_FLAGS_SUPPORT_XMP))
-  {
-    dt_exif_xmp_attach(imgid, filename);
-    // no need to cancel the export if this fail
-  }
+  _export_finalize(imgid, filename, format, format_params, copy_metadata && !xmp, thumbnail_export, storage,
+                   storage_params);
+  g_free(xmp);
 
-  if(!thumbnail_export && strcmp(format->mime(format_params), "memory")
-    && !(format->flags(format_params) & FORMAT_FLAGS_NO_TMPFILE))
-  {
-    dt_control_signal_raise(darktable.signals, DT_SIGNAL_IMAGE_EXPORT_TMPFILE, imgid, filename, format,
-                            format_params, storage, storage_params);
-  }
+  // the write queue reports its own writes, report the ones it couldn't take here
+  if(async && !res) _export_report(filename, num, total);
 
   return res;
 
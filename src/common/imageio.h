@@ -78,6 +78,21 @@ int dt_imageio_export_with_flags(const uint32_t imgid, const char *filename,
                                  const gboolean copy_metadata, dt_imageio_module_storage_t *storage,
                                  dt_imageio_module_data_t *storage_params, int num, int total);
 
+// like dt_imageio_export(), but only runs the pixelpipe and hands the result over to the export write queue,
+// which encodes and writes the file in the background. the file is only guaranteed to exist after
+// dt_imageio_export_flush(). falls back to a synchronous export for formats that can't be deferred.
+// the user is told about each exported image once its file is written.
+int dt_imageio_export_async(const uint32_t imgid, const char *filename, struct dt_imageio_module_format_t *format,
+                            struct dt_imageio_module_data_t *format_params, const gboolean high_quality,
+                            const gboolean upscale, const gboolean copy_metadata,
+                            dt_imageio_module_storage_t *storage, dt_imageio_module_data_t *storage_params,
+                            int num, int total);
+// wait until the exports queued by the calling thread's job are written, returns the number of those writes
+// that failed since its last flush
+int dt_imageio_export_flush();
+// wait for all queued exports and shut down the export write queue
+void dt_imageio_export_cleanup();
+
 size_t dt_imageio_write_pos(int i, int j, int wd, int ht, float fwd, float fht,
                             dt_image_orientation_t orientation);
 
@@ -96,6 +111,9 @@ void dt_imageio_flip_buffers_ui8_to_float(float *out, const uint8_t *in, const f
                                           const int fht, const int stride,
                                           const dt_image_orientation_t orientation);
 
+// number of threads format modules should use to compress their output
+int dt_imageio_get_encode_threads();
+
 // allocate buffer and return 0 on success along with largest jpg thumbnail from raw.
 int dt_imageio_large_thumbnail(const char *filename, uint8_t **buffer, int32_t *width, int32_t *height,
                                dt_colorspaces_color_profile_type_t *color_space);
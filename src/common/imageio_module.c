@@ -325,6 +325,9 @@ void dt_imageio_init(dt_imageio_t *iio)
 
 void dt_imageio_cleanup(dt_imageio_t *iio)
 {
+  // pending exports still need their format modules
+  dt_imageio_export_cleanup();
+
   while(iio->plugins_format)
   {
     dt_imageio_module_format_t *module = (dt_imageio_module_format_t *)(iio->plugins_format->data);
@@ -32,6 +32,7 @@ extern "C" {
 #include "common/exif.h"
 #include "common/file_location.h"
 #include "common/imageio_rawspeed.h"
+#include "common/mapped_file.h"
 #include "imageio.h"
 #include <stdint.h>
 }
@@ -112,6 +113,10 @@ uint32_t dt_rawspeed_crop_dcraw_filters(uint32_t filters, uint32_t crop_x, uint3
 dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filename,
                                              dt_mipmap_buffer_t *mbuf)
 {
+  // map the file before reading exif so exiv2 gets to share the same mapping
+  std::unique_ptr<dt_mapped_file_t, decltype(&dt_mapped_file_close)> mapped(dt_mapped_file_open(filename),
+                                                                            &dt_mapped_file_close);
+
   if(!img->exif_inited) (void)dt_exif_read(img, filename);
 
   char filen[PATH_MAX] = { 0 };
@@ -125,7 +130,14 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
   {
     dt_rawspeed_load_meta();
 
-    m = f.readFile();
+    // rawspeed buffers can't address more than 4GB, let the file reader deal with those. its bit pumps also
+    // read up to Buffer::padding bytes past the end, which a mapping only has if the file doesn't end close
+    // to a page boundary (the rest of the last page reads as zeros). pages are at least 4k everywhere.
+    const size_t page_tail = mapped ? (4096 - mapped->size % 4096) % 4096 : 0;
+    if(mapped && mapped->size <= UINT32_MAX - Buffer::padding && page_tail >= Buffer::padding)
+      m.reset(new Buffer(mapped->data, (Buffer::size_type)mapped->size));
+    else
+      m = f.readFile();
 
     RawParser t(m.get());
     d = t.getDecoder(meta);
@@ -220,6 +232,7 @@ dt_imageio_retval_t dt_imageio_open_rawspeed(dt_image_t *img, const char *filena
     /* free auto pointers on spot */
     d.reset();
     m.reset();
+    mapped.reset();
 
     // Grab the WB
     for(int i = 0; i < 4; i++) img->wb_coeffs[i] = r->metadata.wbCoeffs[i];
@@ -0,0 +1,118 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2018 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "common/mapped_file.h"
+#include "common/darktable.h"
+
+#ifndef __WIN32__
+#include <sys/mman.h>
+#endif
+
+// path -> dt_mapped_file_t *, only holds mappings that are currently referenced
+static GHashTable *_mapped_files = NULL;
+static dt_pthread_mutex_t _mapped_files_mutex;
+
+void dt_mapped_file_init()
+{
+  dt_pthread_mutex_init(&_mapped_files_mutex, NULL);
+  _mapped_files = g_hash_table_new(g_str_hash, g_str_equal);
+}
+
+void dt_mapped_file_cleanup()
+{
+  if(!_mapped_files) return;
+  // everyone should have closed their files by now
+  if(g_hash_table_size(_mapped_files) > 0)
+    fprintf(stderr, "[mapped_file] %u files still mapped on shutdown\n", g_hash_table_size(_mapped_files));
+  g_hash_table_destroy(_mapped_files);
+  _mapped_files = NULL;
+  dt_pthread_mutex_destroy(&_mapped_files_mutex);
+}
+
+dt_mapped_file_t *dt_mapped_file_open(const char *filename)
+{
+  if(!_mapped_files || !filename || !*filename) return NULL;
+
+  dt_pthread_mutex_lock(&_mapped_files_mutex);
+
+  dt_mapped_file_t *file = (dt_mapped_file_t *)g_hash_table_lookup(_mapped_files, filename);
+  if(file)
+  {
+    file->ref++;
+    dt_pthread_mutex_unlock(&_mapped_files_mutex);
+    return file;
+  }
+
+  GError *error = NULL;
+  GMappedFile *map = g_mapped_file_new(filename, FALSE, &error);
+  if(!map)
+  {
+    dt_print(DT_DEBUG_CACHE, "[mapped_file] can't map `%s': %s\n", filename, error->message);
+    g_error_free(error);
+    dt_pthread_mutex_unlock(&_mapped_files_mutex);
+    return NULL;
+  }
+
+  const size_t size = g_mapped_file_get_length(map);
+  if(size == 0)
+  {
+    // empty files have no mapping, nothing to share
+    g_mapped_file_unref(map);
+    dt_pthread_mutex_unlock(&_mapped_files_mutex);
+    return NULL;
+  }
+
+  file = (dt_mapped_file_t *)g_malloc0(sizeof(dt_mapped_file_t));
+  file->filename = g_strdup(filename);
+  file->map = map;
+  file->data = (const uint8_t *)g_mapped_file_get_contents(map);
+  file->size = size;
+  file->ref = 1;
+
+#if !defined(__WIN32__) && defined(POSIX_MADV_SEQUENTIAL)
+  // decoders walk the file front to back, let the kernel read ahead generously
+  posix_madvise((void *)file->data, file->size, POSIX_MADV_SEQUENTIAL);
+#endif
+
+  g_hash_table_insert(_mapped_files, file->filename, file);
+
+  dt_pthread_mutex_unlock(&_mapped_files_mutex);
+  return file;
+}
+
+void dt_mapped_file_close(dt_mapped_file_t *file)
+{
+  if(!file) return;
+
+  dt_pthread_mutex_lock(&_mapped_files_mutex);
+  if(--file->ref > 0)
+  {
+    dt_pthread_mutex_unlock(&_mapped_files_mutex);
+    return;
+  }
+  g_hash_table_remove(_mapped_files, file->filename);
+  dt_pthread_mutex_unlock(&_mapped_files_mutex);
+
+  g_mapped_file_unref(file->map);
+  g_free(file->filename);
+  g_free(file);
+}
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
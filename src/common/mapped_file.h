@@ -0,0 +1,60 @@
+/*
+    This file is part of darktable,
+    copyright (c) 2018 darktable developers.
+
+    darktable is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    darktable is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with darktable.  If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+
+#include <glib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** a read-only, reference counted memory mapping of an input file.
+ * all users asking for the same path while a mapping is alive share it, so
+ * rawspeed, exiv2 and the embedded thumbnail loader only pull the file into
+ * the page cache once. */
+typedef struct dt_mapped_file_t
+{
+  char *filename;
+  const uint8_t *data;
+  size_t size;
+  GMappedFile *map;
+  uint32_t ref;
+} dt_mapped_file_t;
+
+/** set up the registry of live mappings. */
+void dt_mapped_file_init();
+void dt_mapped_file_cleanup();
+
+/** get a mapping of filename, either a new one or a new reference to an existing one.
+ * returns NULL if the file can't be mapped, callers are expected to fall back to
+ * regular reads in that case. */
+dt_mapped_file_t *dt_mapped_file_open(const char *filename);
+
+/** drop a reference obtained by dt_mapped_file_open(). the mapping goes away with the last one. */
+void dt_mapped_file_close(dt_mapped_file_t *file);
+
+#ifdef __cplusplus
+}
+#endif
+
+// modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
+// vim: shiftwidth=2 expandtab tabstop=2 cindent
+// kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
@@ -31,6 +31,7 @@ static void dt_metadata_set_xmp(int id, const char *key, const char *value)
 
   if(id == -1)
   {
+    dt_database_start_transaction(darktable.db);
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
                                 "DELETE FROM main.meta_data WHERE id IN (SELECT imgid FROM main.selected_images) "
                                 "AND key = ?1",
@@ -50,6 +51,7 @@ static void dt_metadata_set_xmp(int id, const char *key, const char *value)
       sqlite3_step(stmt);
       sqlite3_finalize(stmt);
     }
+    dt_database_release_transaction(darktable.db);
   }
   else
   {
@@ -25,6 +25,7 @@
 #include "common/imageio.h"
 #include "common/imageio_jpeg.h"
 #include "common/imageio_module.h"
+#include "common/mapped_file.h"
 #include "control/conf.h"
 #include "control/jobs.h"
 #include "develop/imageop_math.h"
@@ -1107,7 +1108,7 @@ static int _bpp(dt_imageio_module_data_t *data)
 }
 
 static int _write_image(dt_imageio_module_data_t *data, const char *filename, const void *in, void *exif,
-                        int exif_len, int imgid, int num, int total)
+                        int exif_len, const char *xmp, int imgid, int num, int total)
 {
   _dummy_data_t *d = (_dummy_data_t *)data;
   memcpy(d->buf, in, data->width * data->height * sizeof(uint32_t));
@@ -1133,6 +1134,10 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
     return;
   }
 
+  // keep the input mapped while we try the embedded thumbnail and possibly the full
+  // raw decode afterwards, so both are served from one read of the file
+  dt_mapped_file_t *mapped = dt_mapped_file_open(filename);
+
   const int altered = dt_image_altered(imgid);
   int res = 1;
 
@@ -1229,6 +1234,8 @@ static void _init_8(uint8_t *buf, uint32_t *width, uint32_t *height, float *isca
     }
   }
 
+  dt_mapped_file_close(mapped);
+
   // fprintf(stderr, "[mipmap init 8] export image %u finished (sizes %d %d => %d %d)!\n", imgid, wd, ht,
   // dat.head.width, dat.head.height);
 
@@ -707,63 +707,6 @@ finally:
     cl->gaussian = dt_gaussian_init_cl_global();
     cl->interpolation = dt_interpolation_init_cl_global();
     cl->local_laplacian = dt_local_laplacian_init_cl_global();
-
-    char checksum[64];
-    snprintf(checksum, sizeof(checksum), "%u", cl->crc);
-    char *oldchecksum = dt_conf_get_string("opencl_checksum");
-
-    // check if the configuration (OpenCL device setup) has changed, indicated by checksum != oldchecksum
-    if(strcmp(oldchecksum, checksum) != 0)
-    {
-      // store new checksum value in config
-      dt_conf_set_string("opencl_checksum", checksum);
-      // do CPU bencharking
-      float tcpu = dt_opencl_benchmark_cpu(1024, 1024, 5, 100.0f);
-      // get best benchmarking value of all detected OpenCL devices
-      float tgpumin = INFINITY;
-      for(int n = 0; n < cl->num_devs; n++)
-      {
-        float tgpu = cl->dev[n].benchmark = dt_opencl_benchmark_gpu(n, 1024, 1024, 5, 100.0f);
-        tgpumin = fmin(tgpu, tgpumin);
-      }
-      dt_print(DT_DEBUG_OPENCL, "[opencl_init] benchmarking results: %f seconds for fastest GPU versus %f seconds for CPU.\n",
-           tgpumin, tcpu);
-
-      if(tcpu <= 1.5f * tgpumin)
-      {
-        // de-activate opencl for darktable in case of too slow GPU(s). user can always manually overrule this later.
-        cl->enabled = FALSE;
-        dt_conf_set_bool("opencl", FALSE);
-        dt_print(DT_DEBUG_OPENCL, "[opencl_init] due to a slow GPU the opencl flag has been set to OFF.\n");
-        dt_control_log(_("due to a slow GPU hardware acceleration via opencl has been de-activated."));
-      }
-      else if(cl->num_devs >= 2)
-      {
-        // set scheduling profile to "multiple GPUs" if more than one device has been found
-        dt_conf_set_string("opencl_scheduling_profile", "multiple GPUs");
-        dt_print(DT_DEBUG_OPENCL, "[opencl_init] set scheduling profile for multipe GPUs.\n");
-        dt_control_log(_("multiple GPUs detected - opencl scheduling profile has been set accordingly."));
-      }
-      else if(tcpu >= 6.0f * tgpumin)
-      {
-        // set scheduling profile to "very fast GPU" if CPU is way too slow
-        dt_conf_set_string("opencl_scheduling_profile", "very fast GPU");
-        dt_print(DT_DEBUG_OPENCL, "[opencl_init] set scheduling profile for very fast GPU.\n");
-        dt_control_log(_("very fast GPU detected - opencl scheduling profile has been set accordingly."));
-      }
-      else
-      {
-        // set scheduling profile to "default"
-        dt_conf_set_string("opencl_scheduling_profile", "default");
-        dt_print(DT_DEBUG_OPENCL, "[opencl_init] set scheduling profile to default.\n");
-        dt_control_log(_("opencl scheduling profile set to default."));
-      }
-    }
-    g_free(oldchecksum);
-
-    // apply config settings for scheduling profile: sets device priorities and pixelpipe synchronization timeout
-    dt_opencl_scheduling_profile_t profile = dt_opencl_get_scheduling_profile();
-    dt_opencl_apply_scheduling_profile(profile);
   }
   else // initialization failed
   {
@@ -800,6 +743,68 @@ finally:
   return;
 }
 
+void dt_opencl_benchmark_devices(dt_opencl_t *cl)
+{
+  if(!cl->inited) return;
+
+  char checksum[64];
+  snprintf(checksum, sizeof(checksum), "%u", cl->crc);
+  char *oldchecksum = dt_conf_get_string("opencl_checksum");
+
+  // check if the configuration (OpenCL device setup) has changed, indicated by checksum != oldchecksum
+  if(strcmp(oldchecksum, checksum) != 0)
+  {
+    // store new checksum value in config
+    dt_conf_set_string("opencl_checksum", checksum);
+    // do CPU bencharking
+    float tcpu = dt_opencl_benchmark_cpu(1024, 1024, 5, 100.0f);
+    // get best benchmarking value of all detected OpenCL devices
+    float tgpumin = INFINITY;
+    for(int n = 0; n < cl->num_devs; n++)
+    {
+      float tgpu = cl->dev[n].benchmark = dt_opencl_benchmark_gpu(n, 1024, 1024, 5, 100.0f);
+      tgpumin = fmin(tgpu, tgpumin);
+    }
+    dt_print(DT_DEBUG_OPENCL, "[opencl_init] benchmarking results: %f seconds for fastest GPU versus %f seconds for CPU.\n",
+         tgpumin, tcpu);
+
+    if(tcpu <= 1.5f * tgpumin)
+    {
+      // de-activate opencl for darktable in case of too slow GPU(s). user can always manually overrule this later.
+      cl->enabled = FALSE;
+      dt_conf_set_bool("opencl", FALSE);
+      dt_print(DT_DEBUG_OPENCL, "[opencl_init] due to a slow GPU the opencl flag has been set to OFF.\n");
+      dt_control_log(_("due to a slow GPU hardware acceleration via opencl has been de-activated."));
+    }
+    else if(cl->num_devs >= 2)
+    {
+      // set scheduling profile to "multiple GPUs" if more than one device has been found
+      dt_conf_set_string("opencl_scheduling_profile", "multiple GPUs");
+      dt_print(DT_DEBUG_OPENCL, "[opencl_init] set scheduling profile for multipe GPUs.\n");
+      dt_control_log(_("multiple GPUs detected - opencl scheduling profile has been set accordingly."));
+    }
+    else if(tcpu >= 6.0f * tgpumin)
+    {
+      // set scheduling profile to "very fast GPU" if CPU is way too slow
+      dt_conf_set_string("opencl_scheduling_profile", "very fast GPU");
+      dt_print(DT_DEBUG_OPENCL, "[opencl_init] set scheduling profile for very fast GPU.\n");
+      dt_control_log(_("very fast GPU detected - opencl scheduling profile has been set accordingly."));
+    }
+    else
+    {
+      // set scheduling profile to "default"
+      dt_conf_set_string("opencl_scheduling_profile", "default");
+      dt_print(DT_DEBUG_OPENCL, "[opencl_init] set scheduling profile to default.\n");
+      dt_control_log(_("opencl scheduling profile set to default."));
+    }
+  }
+  g_free(oldchecksum);
+
+  // apply config settings for scheduling profile: sets device priorities and pixelpipe synchronization timeout
+  dt_opencl_scheduling_profile_t profile = dt_opencl_get_scheduling_profile();
+  dt_opencl_apply_scheduling_profile(profile);
+}
+
 void dt_opencl_cleanup(dt_opencl_t *cl)
 {
   if(cl->inited)
@@ -182,6 +182,10 @@ int dt_opencl_get_device_info(dt_opencl_t *cl, cl_device_id device, cl_device_in
 /** inits the opencl subsystem. */
 void dt_opencl_init(dt_opencl_t *cl, const gboolean exclude_opencl, const gboolean print_statistics);
 
+/** benchmarks the devices against the cpu if the device setup changed since the last run, to pick whether
+ *  opencl is used and the scheduling profile, then applies the profile. must not run next to other work. */
+void dt_opencl_benchmark_devices(dt_opencl_t *cl);
+
 /** cleans up the opencl subsystem. */
 void dt_opencl_cleanup(dt_opencl_t *cl);
 
@@ -380,6 +384,9 @@ static inline void dt_opencl_init(dt_opencl_t *cl, const gboolean exclude_opencl
   dt_conf_set_bool("opencl", FALSE);
   dt_print(DT_DEBUG_OPENCL, "[opencl_init] this version of darktable was built without opencl support\n");
 }
+static inline void dt_opencl_benchmark_devices(dt_opencl_t *cl)
+{
+}
 static inline void dt_opencl_cleanup(dt_opencl_t *cl)
 {
 }
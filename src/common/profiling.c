@@ -17,27 +17,174 @@
 */
 
 #include "common/profiling.h"
+#include "common/dtpthread.h"
 
-dt_timer_t *dt_timer_start_with_name(const char *file, const char *function, const char *description)
+#include <glib/gstdio.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <unistd.h>
+
+// a long session can produce a lot of spans, stop recording after this many (56 bytes each)
+#define DT_TRACE_MAX_SPANS (1 << 22)
+
+typedef struct dt_trace_record_t
+{
+  const char *category; // interned
+  const char *name;     // interned
+  const char *pipe;     // interned or NULL
+  int64_t start, duration;
+  size_t bytes;
+  int tid;
+} dt_trace_record_t;
+
+int dt_trace_on = 0;
+
+static dt_pthread_mutex_t _trace_mutex;
+static GArray *_trace_records = NULL;
+static gchar *_trace_filename = NULL;
+static int _trace_dropped = 0;
+static int _trace_threads = 0;
+static __thread int _trace_tid = 0;
+
+void dt_trace_init(const char *filename)
+{
+  dt_pthread_mutex_init(&_trace_mutex, NULL);
+  _trace_records = g_array_new(FALSE, FALSE, sizeof(dt_trace_record_t));
+  _trace_filename = g_strdup(filename);
+  dt_trace_on = 1;
+}
+
+// small numbers in order of first use read better than pthread ids
+static int _trace_thread_id()
+{
+  if(!_trace_tid) _trace_tid = g_atomic_int_add(&_trace_threads, 1) + 1;
+  return _trace_tid;
+}
+
+void dt_trace_end(const dt_trace_span_t *span, const char *pipe, size_t bytes)
 {
-  dt_timer_t *t = g_malloc(sizeof(dt_timer_t));
-  t->file = file;
-  t->function = function;
-  t->timer = g_timer_new();
-  t->description = description;
-  return t;
+  if(!span->start || !dt_trace_on) return;
+
+  // the strings often belong to modules or jobs which are gone by the time the trace is written
+  const dt_trace_record_t record = { g_intern_string(span->category), g_intern_string(span->name),
+                                     pipe ? g_intern_string(pipe) : NULL, span->start,
+                                     g_get_monotonic_time() - span->start, bytes, _trace_thread_id() };
+
+  dt_pthread_mutex_lock(&_trace_mutex);
+  // nothing to add to once the trace is written
+  if(_trace_records && _trace_records->len < DT_TRACE_MAX_SPANS)
+    g_array_append_val(_trace_records, record);
+  else if(_trace_records)
+    _trace_dropped++;
+  dt_pthread_mutex_unlock(&_trace_mutex);
 }
 
-void dt_timer_stop_with_name(dt_timer_t *t)
+guint dt_trace_mark()
 {
-  g_assert(t != NULL);
-  g_timer_stop(t->timer);
-  gulong ms = 0;
-  fprintf(stderr, "Timer %s in function %s took %.3f seconds to execute.\n", t->description, t->function,
-          g_timer_elapsed(t->timer, &ms));
-  g_timer_destroy(t->timer);
-  g_free(t);
+  if(!dt_trace_on) return 0;
+  dt_pthread_mutex_lock(&_trace_mutex);
+  const guint mark = _trace_records ? _trace_records->len : 0;
+  dt_pthread_mutex_unlock(&_trace_mutex);
+  return mark;
 }
+
+GList *dt_trace_totals(guint mark, const char *category)
+{
+  if(!dt_trace_on) return NULL;
+
+  // interned strings compare by pointer
+  category = category ? g_intern_string(category) : NULL;
+  GList *totals = NULL;
+  GHashTable *index = g_hash_table_new(g_direct_hash, g_direct_equal);
+
+  dt_pthread_mutex_lock(&_trace_mutex);
+  for(guint k = mark; _trace_records && k < _trace_records->len; k++)
+  {
+    const dt_trace_record_t *r = &g_array_index(_trace_records, dt_trace_record_t, k);
+    if(category && r->category != category) continue;
+
+    // category and name interned and joined, so that a single pointer identifies the pair
+    gchar *key = g_strdup_printf("%s\x1f%s", r->category, r->name);
+    const char *ikey = g_intern_string(key);
+    g_free(key);
+
+    dt_trace_total_t *total = g_hash_table_lookup(index, ikey);
+    if(!total)
+    {
+      total = g_malloc0(sizeof(dt_trace_total_t));
+      total->category = r->category;
+      total->name = r->name;
+      g_hash_table_insert(index, (gpointer)ikey, total);
+      totals = g_list_prepend(totals, total);
+    }
+    total->duration += r->duration;
+    total->bytes += r->bytes;
+    total->count++;
+  }
+  dt_pthread_mutex_unlock(&_trace_mutex);
+
+  g_hash_table_destroy(index);
+  return g_list_reverse(totals);
+}
+
+static void _trace_write_string(FILE *f, const char *s)
+{
+  fputc('"', f);
+  for(; *s; s++)
+  {
+    if(*s == '"' || *s == '\\')
+      fprintf(f, "\\%c", *s);
+    else if((unsigned char)*s < 0x20)
+      fprintf(f, "\\u%04x", *s);
+    else
+      fputc(*s, f);
+  }
+  fputc('"', f);
+}
+
+void dt_trace_cleanup()
+{
+  if(!dt_trace_on) return;
+  dt_trace_on = 0;
+
+  dt_pthread_mutex_lock(&_trace_mutex);
+  // without a filename the spans were only recorded for dt_trace_totals()
+  FILE *f = _trace_filename ? g_fopen(_trace_filename, "wb") : NULL;
+  if(f)
+  {
+    const int pid = getpid();
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+    for(guint k = 0; k < _trace_records->len; k++)
+    {
+      const dt_trace_record_t *r = &g_array_index(_trace_records, dt_trace_record_t, k);
+      fprintf(f, "{\"ph\":\"X\",\"cat\":");
+      _trace_write_string(f, r->category);
+      fprintf(f, ",\"name\":");
+      _trace_write_string(f, r->name);
+      fprintf(f, ",\"pid\":%d,\"tid\":%d,\"ts\":%" PRId64 ",\"dur\":%" PRId64 ",\"args\":{\"bytes\":%zu", pid,
+              r->tid, r->start, r->duration, r->bytes);
+      if(r->pipe)
+      {
+        fprintf(f, ",\"pipe\":");
+        _trace_write_string(f, r->pipe);
+      }
+      fprintf(f, "}}%s\n", k + 1 < _trace_records->len ? "," : "");
+    }
+    fprintf(f, "]}\n");
+    fclose(f);
+    fprintf(stderr, "[trace] wrote %u spans to %s\n", _trace_records->len, _trace_filename);
+  }
+  else if(_trace_filename)
+    fprintf(stderr, "[trace] could not write %s\n", _trace_filename);
+  if(_trace_dropped) fprintf(stderr, "[trace] dropped %d spans over the limit\n", _trace_dropped);
+
+  g_array_free(_trace_records, TRUE);
+  _trace_records = NULL;
+  g_free(_trace_filename);
+  _trace_filename = NULL;
+  dt_pthread_mutex_unlock(&_trace_mutex);
+}
+
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
 // kate: tab-indents: off; indent-width 2; replace-tabs on; indent-mode cstyle; remove-trailing-spaces modified;
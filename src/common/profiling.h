@@ -18,38 +18,59 @@
 
 #pragma once
 
-#include "gui/gtk.h"
-
-
-#ifdef USE_DARKTABLE_PROFILING
-#define TIMER_START(name, description)                                                                       \
-  dt_timer_t *name = dt_timer_start_with_name(__FILE__, __FUNCTION__, description)
-#else
-#define TIMER_START(name, description)                                                                       \
-  {                                                                                                          \
-  }
-#endif
-
-#ifdef USE_DARKTABLE_PROFILING
-#define TIMER_STOP(name) dt_timer_stop_with_name(name)
-#else
-#define TIMER_STOP(name)                                                                                     \
-  {                                                                                                          \
-  }
-#endif
-
-#ifdef USE_DARKTABLE_PROFILING
-typedef struct dt_timer_t
+#include <glib.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+ * runtime tracer, enabled with --trace <file>. all spans recorded until darktable quits are written to that
+ * file as trace event json, which chrome://tracing and https://ui.perfetto.dev show as a flame chart per
+ * thread. spans of the same thread nest by their time, so there is no need to keep track of parents.
+ */
+
+typedef struct dt_trace_span_t
+{
+  const char *category;
+  const char *name;
+  int64_t start; // g_get_monotonic_time() when the span was opened, 0 if tracing is off
+} dt_trace_span_t;
+
+// set by dt_trace_init(), read by the inline functions below to keep disabled spans cheap
+extern int dt_trace_on;
+
+// start recording, the trace is written to filename by dt_trace_cleanup(). NULL only records, for
+// dt_trace_totals().
+void dt_trace_init(const char *filename);
+// write the trace file and free all spans
+void dt_trace_cleanup();
+
+// open a span. category and name only need to be valid until dt_trace_end().
+static inline dt_trace_span_t dt_trace_begin(const char *category, const char *name)
+{
+  const dt_trace_span_t span = { category, name, dt_trace_on ? g_get_monotonic_time() : 0 };
+  return span;
+}
+
+// close a span and record it along with the pipe it ran in (may be NULL) and the bytes it read and wrote
+void dt_trace_end(const dt_trace_span_t *span, const char *pipe, size_t bytes);
+
+// the spans of one category and name added up
+typedef struct dt_trace_total_t
 {
-  const char *file;
-  const char *function;
-  const char *description;
-  GTimer *timer;
-} dt_timer_t;
-
-dt_timer_t *dt_timer_start_with_name(const char *file, const char *function, const char *description);
-void dt_timer_stop_with_name(dt_timer_t *);
-#endif
+  const char *category, *name; // interned
+  int64_t duration;            // in microseconds
+  size_t bytes;
+  int count;
+} dt_trace_total_t;
+
+// position in the recorded spans, to add up the ones after it with dt_trace_totals()
+guint dt_trace_mark();
+// list of dt_trace_total_t of the spans recorded since mark, in the order they first appeared. category may
+// be NULL for all of them. free with g_list_free_full(list, g_free).
+GList *dt_trace_totals(guint mark, const char *category);
+
+#define TIMER_START(name, description) dt_trace_span_t name = dt_trace_begin(__FUNCTION__, description)
+#define TIMER_STOP(name) dt_trace_end(&(name), NULL, 0)
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
 // vim: shiftwidth=2 expandtab tabstop=2 cindent
@@ -37,7 +37,25 @@ void dt_ratings_apply_to_image(int imgid, int rating)
   // synch through:
   dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_SAFE);
 
-  dt_collection_hint_message(darktable.collection);
+  dt_collection_images_changed(darktable.collection, DT_COLLECTION_CHANGE_RATING, imgid);
+}
+
+static int32_t _ratings_cache_job_run(dt_job_t *job)
+{
+  GArray *ratings = dt_control_job_get_params(job);
+  for(guint i = 0; i < ratings->len; i += 2)
+  {
+    dt_image_t *image = dt_image_cache_get(darktable.image_cache, g_array_index(ratings, int, i), 'w');
+    image->flags = (image->flags & ~0x7) | g_array_index(ratings, int, i + 1);
+    // the write release of whoever held it has put the old rating back into the db
+    dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_RELAXED);
+  }
+  return 0;
+}
+
+static void _ratings_cache_job_cleanup(void *data)
+{
+  g_array_free((GArray *)data, TRUE);
 }
 
 void dt_ratings_apply_to_selection(int rating)
@@ -50,23 +68,67 @@ void dt_ratings_apply_to_selection(int rating)
     else
       dt_control_log(ngettext("applying rating %d to %d image", "applying rating %d to %d images", count),
                      rating, count);
-#if 0 // not updating cache
-    gchar query[1024]= {0};
-    g_snprintf(query,sizeof(query), "UPDATE main.images SET flags=(flags & ~7) | (7 & %d) WHERE id IN "
-                                    "(SELECT imgid FROM main.selected_images)", rating);
-    DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), query, NULL, NULL, NULL);
-#endif
-
-    /* for each selected image update rating */
+    dt_database_start_transaction(darktable.db);
+
+    /* update all selected images at once. one star is a toggle, just like in dt_ratings_apply_to_image() */
     sqlite3_stmt *stmt;
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT imgid FROM main.selected_images", -1, &stmt,
-                                NULL);
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "UPDATE main.images SET flags = (flags & ~7) | "
+                                "(CASE WHEN ?2 AND (flags & 7) = 1 THEN 0 ELSE (7 & ?1) END) "
+                                "WHERE id IN (SELECT imgid FROM main.selected_images)",
+                                -1, &stmt, NULL);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, rating);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, rating == 1 && !dt_conf_get_bool("rating_one_double_tap"));
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+
+    /* remember the new ratings for the image structs that are cached */
+    GArray *ratings = g_array_new(FALSE, FALSE, sizeof(int));
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "SELECT id, flags & 7 FROM main.images "
+                                "WHERE id IN (SELECT imgid FROM main.selected_images)",
+                                -1, &stmt, NULL);
     while(sqlite3_step(stmt) == SQLITE_ROW)
     {
-      dt_ratings_apply_to_image(sqlite3_column_int(stmt, 0), rating);
+      const int imgid = sqlite3_column_int(stmt, 0);
+      if(!dt_cache_contains(&darktable.image_cache->cache, imgid)) continue;
+      const int new_rating = sqlite3_column_int(stmt, 1);
+      g_array_append_val(ratings, imgid);
+      g_array_append_val(ratings, new_rating);
     }
     sqlite3_finalize(stmt);
 
+    dt_database_release_transaction(darktable.db);
+
+    /* the cached image structs get the new ratings as well, without writing them back. dropping them instead
+       would race with whoever holds one for writing, their write release would put the old rating back. */
+    GArray *busy = g_array_new(FALSE, FALSE, sizeof(int));
+    for(guint i = 0; i < ratings->len; i += 2)
+    {
+      dt_image_t *image = dt_image_cache_testget(darktable.image_cache, g_array_index(ratings, int, i), 'w');
+      if(image)
+      {
+        image->flags = (image->flags & ~0x7) | g_array_index(ratings, int, i + 1);
+        dt_image_cache_write_release(darktable.image_cache, image, DT_IMAGE_CACHE_MEMORY);
+      }
+      else
+        g_array_append_vals(busy, &g_array_index(ratings, int, i), 2);
+    }
+    g_array_free(ratings, TRUE);
+
+    /* the ones in use are waited for in the background, off the gui thread */
+    dt_job_t *job = busy->len ? dt_control_job_create(&_ratings_cache_job_run, "update cached ratings") : NULL;
+    if(job)
+    {
+      dt_control_job_set_params(job, busy, _ratings_cache_job_cleanup);
+      dt_control_add_job(darktable.control, DT_JOB_QUEUE_SYSTEM_BG, job);
+    }
+    else
+      g_array_free(busy, TRUE);
+
+    dt_image_synch_xmp(-1);
+    dt_collection_images_changed(darktable.collection, DT_COLLECTION_CHANGE_RATING, -1);
+
     /* redraw view */
     /* dt_control_queue_redraw_center() */
     /* needs to be called in the caller function */
@@ -231,11 +231,13 @@ void dt_tag_attach(guint tagid, gint imgid)
 
 void dt_tag_attach_list(GList *tags, gint imgid)
 {
+  dt_database_start_transaction(darktable.db);
   GList *child = NULL;
   if((child = g_list_first(tags)) != NULL) do
     {
       _attach_tag(GPOINTER_TO_INT(child->data), imgid);
     } while((child = g_list_next(child)) != NULL);
+  dt_database_release_transaction(darktable.db);
 
   dt_tag_update_used_tags();
 
@@ -247,6 +249,7 @@ void dt_tag_attach_string_list(const gchar *tags, gint imgid)
   gchar **tokens = g_strsplit(tags, ",", 0);
   if(tokens)
   {
+    dt_database_start_transaction(darktable.db);
     gchar **entry = tokens;
     while(*entry)
     {
@@ -264,6 +267,7 @@ void dt_tag_attach_string_list(const gchar *tags, gint imgid)
       }
       entry++;
     }
+    dt_database_release_transaction(darktable.db);
 
     dt_tag_update_used_tags();
 
@@ -289,8 +289,8 @@ static float envelope(const float xx)
 }
 
 static int dt_control_merge_hdr_process(dt_imageio_module_data_t *datai, const char *filename,
-                                        const void *const ivoid, void *exif, int exif_len, int imgid, int num,
-                                        int total)
+                                        const void *const ivoid, void *exif, int exif_len, const char *xmp,
+                                        int imgid, int num, int total)
 {
   dt_control_merge_hdr_format_t *data = (dt_control_merge_hdr_format_t *)datai;
   dt_control_merge_hdr_t *d = data->d;
@@ -1213,6 +1213,16 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   dt_tag_new("darktable|changed", &tagid);
   dt_tag_new("darktable|exported", &etagid);
 
+  // get the image structs of the whole batch from the db in one go
+  int32_t *imgids = malloc(sizeof(int32_t) * total);
+  if(imgids)
+  {
+    int k = 0;
+    for(const GList *l = t; l; l = g_list_next(l)) imgids[k++] = GPOINTER_TO_INT(l->data);
+    dt_image_cache_prefetch(darktable.image_cache, imgids, k);
+    free(imgids);
+  }
+
   while(t && dt_control_job_get_state(job) != DT_JOB_STATE_CANCELLED)
   {
     if(!t)
@@ -1256,7 +1266,17 @@ static int32_t dt_control_export_job_run(dt_job_t *job)
   }
   params->index = NULL;
 
-  if(mstorage->finalize_store) mstorage->finalize_store(mstorage, sdata);
+  // storages may hand files to the write queue, they have to be on disk before finalizing. a failed write
+  // stops the export just like a failing store() does.
+  const int failed = dt_imageio_export_flush();
+  if(failed)
+  {
+    dt_control_log(ngettext("%d image could not be exported", "%d images could not be exported", failed),
+                   failed);
+    dt_control_job_cancel(job);
+  }
+  else if(mstorage->finalize_store)
+    mstorage->finalize_store(mstorage, sdata);
 
 end:
   // all threads free their fdata
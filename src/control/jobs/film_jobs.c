@@ -17,7 +17,10 @@
 */
 #include "control/jobs/film_jobs.h"
 #include "common/darktable.h"
+#include "common/exif.h"
 #include "common/film.h"
+#include "common/image.h"
+#include "common/mipmap_cache.h"
 #include <stdlib.h>
 
 typedef struct dt_film_import1_t
@@ -133,6 +136,107 @@ int _film_filename_cmp(gchar *a, gchar *b)
   return ret;
 }
 
+/* number of images written to the database per transaction at most. a transaction blocks all others, so
+   it is also committed after DT_FILM_IMPORT_BATCH_SECS or as soon as another thread wants to start one. */
+#define DT_FILM_IMPORT_BATCH_SIZE 256
+#define DT_FILM_IMPORT_BATCH_SECS 0.05
+
+typedef struct dt_film_import_item_t
+{
+  gchar *filename;
+  dt_exif_prefetch_t *prefetch;
+  gboolean ready;
+} dt_film_import_item_t;
+
+typedef struct dt_film_import_pipe_t
+{
+  dt_film_import_item_t *items;
+  guint total;
+  guint queued;    // items handed to the thread pool so far
+  guint lookahead; // how far the parsers may run ahead of the writer
+  GThreadPool *pool;
+  GMutex mutex;
+  GCond cond;
+} dt_film_import_pipe_t;
+
+static void _film_import_prefetch(gpointer data, gpointer user_data)
+{
+  dt_film_import_item_t *item = (dt_film_import_item_t *)data;
+  dt_film_import_pipe_t *pipe = (dt_film_import_pipe_t *)user_data;
+
+  // no database access in here, that's all left for the writer
+  dt_exif_prefetch_t *prefetch = NULL;
+  gchar *normalized = dt_util_normalize_path(item->filename);
+  if(normalized)
+  {
+    gchar *sidecar = g_strconcat(normalized, ".xmp", NULL);
+    prefetch = dt_exif_prefetch(normalized, sidecar);
+    g_free(sidecar);
+    g_free(normalized);
+  }
+
+  g_mutex_lock(&pipe->mutex);
+  item->prefetch = prefetch;
+  item->ready = TRUE;
+  g_cond_broadcast(&pipe->cond);
+  g_mutex_unlock(&pipe->mutex);
+}
+
+static void _film_import_pipe_init(dt_film_import_pipe_t *pipe, GList *images, const guint total)
+{
+  const int threads = dt_get_num_threads();
+  pipe->items = (dt_film_import_item_t *)calloc(total, sizeof(dt_film_import_item_t));
+  pipe->total = total;
+  pipe->queued = 0;
+  // parsed metadata and mapped files are kept until the writer gets to them, so don't run off too far
+  pipe->lookahead = 4 * threads;
+  g_mutex_init(&pipe->mutex);
+  g_cond_init(&pipe->cond);
+  pipe->pool = g_thread_pool_new(_film_import_prefetch, pipe, threads, FALSE, NULL);
+
+  guint i = 0;
+  for(GList *image = images; image && i < total; image = g_list_next(image), i++)
+    pipe->items[i].filename = (gchar *)image->data;
+}
+
+/* wait until the metadata of image i has been parsed, keeping the thread pool busy meanwhile */
+static dt_film_import_item_t *_film_import_pipe_get(dt_film_import_pipe_t *pipe, const guint i)
+{
+  const guint until = MIN(pipe->total, i + pipe->lookahead);
+  for(; pipe->queued < until; pipe->queued++)
+    g_thread_pool_push(pipe->pool, &pipe->items[pipe->queued], NULL);
+
+  dt_film_import_item_t *item = &pipe->items[i];
+  g_mutex_lock(&pipe->mutex);
+  while(!item->ready) g_cond_wait(&pipe->cond, &pipe->mutex);
+  g_mutex_unlock(&pipe->mutex);
+  return item;
+}
+
+static void _film_import_pipe_release(dt_film_import_pipe_t *pipe, const guint i)
+{
+  dt_exif_prefetch_free(pipe->items[i].prefetch);
+  pipe->items[i].prefetch = NULL;
+}
+
+static void _film_import_pipe_cleanup(dt_film_import_pipe_t *pipe)
+{
+  // wait for stragglers, then drop whatever the writer didn't consume
+  g_thread_pool_free(pipe->pool, FALSE, TRUE);
+  for(guint i = 0; i < pipe->total; i++) dt_exif_prefetch_free(pipe->items[i].prefetch);
+  free(pipe->items);
+  g_mutex_clear(&pipe->mutex);
+  g_cond_clear(&pipe->cond);
+}
+
+static void _film_import_queue_thumbnails(GList *imgids)
+{
+  // the queue for these may push out stale requests, so later batches win over earlier ones
+  for(GList *iter = imgids; iter; iter = g_list_next(iter))
+    dt_mipmap_cache_get(darktable.mipmap_cache, NULL, GPOINTER_TO_INT(iter->data), DT_MIPMAP_2,
+                        DT_MIPMAP_PREFETCH, 'r');
+}
+
 static void dt_film_import1(dt_job_t *job, dt_film_t *film)
 {
   gboolean recursive = dt_conf_get_bool("ui_last/import_recursive");
@@ -199,13 +303,24 @@ static void dt_film_import1(dt_job_t *job, dt_film_t *film)
   g_snprintf(message, sizeof(message) - 1, ngettext("importing %d image", "importing %d images", total), total);
   dt_control_job_set_progress_message(job, message);
 
+  /* the import runs as a pipeline: metadata of the files ahead of us gets parsed on a
+     thread pool while this thread is the only one writing to the database, in batches. */
+  dt_film_import_pipe_t pipe;
+  _film_import_pipe_init(&pipe, images, total);
+
+  const double start = dt_get_wtime();
+  double batch_start = start;
+  GList *batch = NULL;
+  guint batch_size = 0, imported = 0;
+
+  dt_database_start_transaction(darktable.db);
 
   /* loop thru the images and import to current film roll */
   dt_film_t *cfr = film;
-  GList *image = g_list_first(images);
-  do
+  for(guint i = 0; i < total; i++)
   {
-    gchar *cdn = g_path_get_dirname((const gchar *)image->data);
+    dt_film_import_item_t *item = _film_import_pipe_get(&pipe, i);
+    gchar *cdn = g_path_get_dirname(item->filename);
 
     /* check if we need to initialize a new filmroll */
     if(!cfr || g_strcmp0(cfr->dirname, cdn) != 0)
@@ -253,13 +368,43 @@ static void dt_film_import1(dt_job_t *job, dt_film_t *film)
     g_free(cdn);
 
     /* import image */
-    dt_image_import(cfr->id, (const gchar *)image->data, FALSE);
+    const uint32_t imgid = dt_image_import_prefetched(cfr->id, item->filename, FALSE, item->prefetch);
+    _film_import_pipe_release(&pipe, i);
+    if(imgid) batch = g_list_prepend(batch, GINT_TO_POINTER(imgid));
+    batch_size++;
+    imported++;
+
+    const double now = dt_get_wtime();
+    if(batch_size >= DT_FILM_IMPORT_BATCH_SIZE || imported == total
+       || now - batch_start >= DT_FILM_IMPORT_BATCH_SECS || dt_database_transaction_waiting(darktable.db))
+    {
+      /* one commit per batch instead of one per statement */
+      dt_database_release_transaction(darktable.db);
+
+      dt_print(DT_DEBUG_PERF, "[film_import] %u/%u images, %.1f images/s (%.1f images/s overall)\n", imported,
+               total, batch_size / MAX(now - batch_start, 1e-6), imported / MAX(now - start, 1e-6));
+      batch_size = 0;
+
+      /* the images are visible to everyone now, get their thumbnails going */
+      _film_import_queue_thumbnails(batch);
+      g_list_free(batch);
+      batch = NULL;
+
+      /* let whoever is waiting have the database first, we would most likely get the lock right back */
+      while(dt_database_transaction_waiting(darktable.db)) g_usleep(1000);
+      if(imported < total) dt_database_start_transaction(darktable.db);
+      batch_start = dt_get_wtime();
+    }
 
     fraction += 1.0 / total;
     dt_control_job_set_progress(job, fraction);
+  }
 
+  _film_import_pipe_cleanup(&pipe);
 
-  } while((image = g_list_next(image)) != NULL);
+  const double elapsed = dt_get_wtime() - start;
+  dt_print(DT_DEBUG_PERF, "[film_import] imported %u images in %.3f secs (%.1f images/s)\n", total, elapsed,
+           total / MAX(elapsed, 1e-6));
 
   g_list_free_full(images, g_free);
 
@@ -18,6 +18,7 @@
 */
 #include "blend.h"
 #include "common/gaussian.h"
+#include "common/profiling.h"
 #include "control/control.h"
 #include "develop/imageop.h"
 #include "develop/masks.h"
@@ -542,6 +543,28 @@ static void _blend_normal_unbounded(const _blend_buffer_desc_t *bd, const float
   }
 }
 
+/* first and one past the last pixel of a mask row that isn't zero, x0 == x1 if the whole row is zero */
+static inline void _blend_row_span(const float *const mask, const int width, int *x0, int *x1)
+{
+  int a = 0, b = width;
+  while(a < b && mask[a] == 0.0f) a++;
+  while(b > a && mask[b - 1] == 0.0f) b--;
+  *x0 = a;
+  *x1 = b;
+}
+
+/* what _blend_normal_unbounded() gives for the pixels from to to with a mask of zero: the input, and the mask
+ * in alpha unless the input's alpha is kept for mask display */
+static inline void _blend_passthrough(const _blend_buffer_desc_t *bd, const float *a, float *b, const int from,
+                                      const int to, const int keep_alpha)
+{
+  for(size_t j = (size_t)from * bd->ch; j < (size_t)to * bd->ch; j += bd->ch)
+  {
+    for(int k = 0; k < bd->bch; k++) b[j + k] = a[j + k];
+    if(bd->ch == 4 && bd->cst != iop_cs_RAW) b[j + 3] = keep_alpha ? a[j + 3] : 0.0f;
+  }
+}
+
 /* lighten */
 static void _blend_lighten(const _blend_buffer_desc_t *bd, const float *a, float *b, const float *mask,
                            int flag)
@@ -2791,9 +2814,9 @@ _blend_row_func *dt_develop_choose_blend_func(const unsigned int blend_mode)
   return blend;
 }
 
-void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
-                              const void *const ivoid, void *const ovoid, const struct dt_iop_roi_t *const roi_in,
-                              const struct dt_iop_roi_t *const roi_out)
+static void _develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                                   const void *const ivoid, void *const ovoid,
+                                   const struct dt_iop_roi_t *const roi_in, const struct dt_iop_roi_t *const roi_out)
 {
   const int ch = piece->colors;           // the number of channels in the buffer
   const int bch = (ch == 1) ? 1 : ch - 1; // the number of channels to blend (all but alpha)
@@ -2862,17 +2885,17 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
 
   float *const mask = _mask;
 
-  if(mask_mode == DEVELOP_MASK_ENABLED)
-  {
-    /* blend uniformly (no drawn or parametric mask) */
+  /* where the mask of each row comes from before the parametric mask is combined with it: a constant fill, or
+   * the drawn mask, possibly inverted */
+  int drawn = 0, invert = 0;
+  float fill = opacity;
 
-    const size_t buffsize = (size_t)roi_out->width * roi_out->height;
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-    for(size_t i = 0; i < buffsize; i++) mask[i] = opacity;
-  }
-  else
+  /* a suppressed mask is just the global opacity, like no mask at all */
+  const int suppress = self->suppress_mask && self->dev->gui_attached && (self == self->dev->gui_module)
+                       && (piece->pipe == self->dev->pipe) && (mask_mode & DEVELOP_MASK_BOTH);
+  const int parametric = mask_mode != DEVELOP_MASK_ENABLED && !suppress;
+
+  if(parametric)
   {
     /* we blend with a drawn and/or parametric mask */
 
@@ -2882,60 +2905,107 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
     if(form && (!(self->flags() & IOP_FLAGS_NO_MASKS)) && (d->mask_mode & DEVELOP_MASK_MASK))
     {
       dt_masks_group_render_roi(self, piece, form, roi_out, mask);
+      drawn = 1;
 
-      if(d->mask_combine & DEVELOP_COMBINE_MASKS_POS)
-      {
-        // if we have a mask and this flag is set -> invert the mask
-        const size_t buffsize = (size_t)roi_out->width * roi_out->height;
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-        for(size_t i = 0; i < buffsize; i++) mask[i] = 1.0f - mask[i];
-      }
+      // if we have a mask and this flag is set -> invert the mask
+      invert = (d->mask_combine & DEVELOP_COMBINE_MASKS_POS) != 0;
     }
     else if((!(self->flags() & IOP_FLAGS_NO_MASKS)) && (d->mask_mode & DEVELOP_MASK_MASK))
     {
       // no form defined but drawn mask active
       // we fill the buffer with 1.0f or 0.0f depending on mask_combine
-      const float fill = (d->mask_combine & DEVELOP_COMBINE_MASKS_POS) ? 0.0f : 1.0f;
-      const size_t buffsize = (size_t)roi_out->width * roi_out->height;
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-      for(size_t i = 0; i < buffsize; i++) mask[i] = fill;
+      fill = (d->mask_combine & DEVELOP_COMBINE_MASKS_POS) ? 0.0f : 1.0f;
     }
     else
     {
       // we fill the buffer with 1.0f or 0.0f depending on mask_combine
-      const float fill = (d->mask_combine & DEVELOP_COMBINE_INCL) ? 0.0f : 1.0f;
-      const size_t buffsize = (size_t)roi_out->width * roi_out->height;
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-      for(size_t i = 0; i < buffsize; i++) mask[i] = fill;
+      fill = (d->mask_combine & DEVELOP_COMBINE_INCL) ? 0.0f : 1.0f;
     }
+  }
+
+  /* without the inclusive or inverting combine modes, pixels the drawn mask doesn't cover stay at zero
+   * whatever the parametric mask says, so only the span a small form covers needs to be looked at */
+  const int form_bounded = (mask_mode & DEVELOP_MASK_MASK)
+                           && !(d->mask_combine & (DEVELOP_COMBINE_INCL | DEVELOP_COMBINE_INV));
+
+  const int maskblur = parametric && fabs(d->radius) > 0.1f;
+  const int gaussian = d->radius > 0.0f ? 1 : 0;
+  const float radius = fabs(d->radius);
+
+  /* normal blending leaves the input untouched where the mask is zero, so with a small form most of the
+   * frame is just copied */
+  const int sparse = blend == _blend_normal_unbounded && !(request_mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY);
+  const int keep_alpha = (mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK) && cst != iop_cs_RAW;
+
+  /* each row of the mask only depends on the same row of the image, so the mask is made and applied in one
+   * sweep while the row is in the cache. only a blurred mask has to be complete before blending. */
+  const int sweeps = maskblur ? 2 : 1;
+  const double start = dt_get_wtime();
+
+  for(int sweep = 0; sweep < sweeps; sweep++)
+  {
+    const int make_mask = sweep == 0;
+    const int apply_mask = sweep == sweeps - 1;
 
 #ifdef _OPENMP
 #pragma omp parallel for default(none)
 #endif
     for(size_t y = 0; y < roi_out->height; y++)
     {
-
       size_t iindex = ((size_t)(y + yoffs) * iwidth + xoffs) * ch;
       size_t oindex = (size_t)y * roi_out->width * ch;
       _blend_buffer_desc_t bd = { .cst = cst, .stride = (size_t)roi_out->width * ch, .ch = ch, .bch = bch };
       float *in = (float *)ivoid + iindex;
       float *out = (float *)ovoid + oindex;
       float *m = (float *)mask + y * roi_out->width;
-      _blend_make_mask(&bd, d->blendif, d->blendif_parameters, d->mask_mode, d->mask_combine, opacity, in,
-                       out, m);
-    }
 
-    const int maskblur = fabs(d->radius) <= 0.1f ? 0 : 1;
-    const int gaussian = d->radius > 0.0f ? 1 : 0;
-    const float radius = fabs(d->radius);
+      if(make_mask)
+      {
+        if(!drawn)
+          for(int x = 0; x < roi_out->width; x++) m[x] = fill;
+        else if(invert)
+          for(int x = 0; x < roi_out->width; x++) m[x] = 1.0f - m[x];
+
+        if(parametric)
+        {
+          _blend_buffer_desc_t mbd = bd;
+          int x0 = 0, x1 = roi_out->width;
+          if(form_bounded)
+          {
+            _blend_row_span(m, roi_out->width, &x0, &x1);
+            mbd.stride = (size_t)(x1 - x0) * ch;
+          }
+          _blend_make_mask(&mbd, d->blendif, d->blendif_parameters, d->mask_mode, d->mask_combine, opacity,
+                           in + (size_t)x0 * ch, out + (size_t)x0 * ch, m + x0);
+        }
+      }
+
+      if(!apply_mask) continue;
+
+      /* now apply blending with per-pixel opacity value as defined in mask */
+      if(sparse)
+      {
+        int x0, x1;
+        _blend_row_span(m, roi_out->width, &x0, &x1);
+        _blend_passthrough(&bd, in, out, 0, x0, keep_alpha);
+        _blend_passthrough(&bd, in, out, x1, roi_out->width, keep_alpha);
+        if(x0 == x1) continue;
+        bd.stride = (size_t)(x1 - x0) * ch;
+        in += (size_t)x0 * ch;
+        out += (size_t)x0 * ch;
+        m += x0;
+      }
+
+      if(request_mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY)
+        display_channel(&bd, in, out, m, request_mask_display);
+      else
+        blend(&bd, in, out, m, blendflag);
+
+      if(keep_alpha)
+        for(size_t j = 0; j < bd.stride; j += 4) out[j + 3] = in[j + 3];
+    }
 
-    if(maskblur)
+    if(make_mask && maskblur)
     {
       if(gaussian)
       {
@@ -2956,43 +3026,10 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
         // potential further blend algorithm (bilateral grid?)
       }
     }
-
-    /* check if mask should be suppressed temporarily (i.e. just set to global
-     * opacity value) */
-    if(self->suppress_mask && self->dev->gui_attached && (self == self->dev->gui_module)
-       && (piece->pipe == self->dev->pipe) && (mask_mode & DEVELOP_MASK_BOTH))
-    {
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-      for(size_t k = 0; k < (size_t)roi_out->height * roi_out->width; k++)
-      {
-        mask[k] = opacity;
-      }
-    }
   }
 
-/* now apply blending with per-pixel opacity value as defined in mask */
-#ifdef _OPENMP
-#pragma omp parallel for default(none)
-#endif
-  for(size_t y = 0; y < roi_out->height; y++)
-  {
-    size_t iindex = ((size_t)(y + yoffs) * iwidth + xoffs) * ch;
-    size_t oindex = (size_t)y * roi_out->width * ch;
-    _blend_buffer_desc_t bd = { .cst = cst, .stride = (size_t)roi_out->width * ch, .ch = ch, .bch = bch };
-    float *in = (float *)ivoid + iindex;
-    float *out = (float *)ovoid + oindex;
-    float *m = (float *)mask + y * roi_out->width;
-
-    if(request_mask_display & DT_DEV_PIXELPIPE_DISPLAY_ANY)
-      display_channel(&bd, in, out, m, request_mask_display);
-    else
-      blend(&bd, in, out, m, blendflag);
-
-    if((mask_display & DT_DEV_PIXELPIPE_DISPLAY_MASK) && cst != iop_cs_RAW)
-      for(size_t j = 0; j < bd.stride; j += 4) out[j + 3] = in[j + 3];
-  }
+  dt_print(DT_DEBUG_PERF, "[blend] %s: %d sweep%s over %dx%d took %0.04f sec\n", self->op, sweeps,
+           sweeps > 1 ? "s" : "", roi_out->width, roi_out->height, dt_get_wtime() - start);
 
   /* register if _this_ module should expose mask or display channel */
   if(request_mask_display & (DT_DEV_PIXELPIPE_DISPLAY_MASK | DT_DEV_PIXELPIPE_DISPLAY_CHANNEL))
@@ -3003,10 +3040,21 @@ void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelp
   dt_free_align(_mask);
 }
 
+void dt_develop_blend_process(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                              const void *const ivoid, void *const ovoid, const struct dt_iop_roi_t *const roi_in,
+                              const struct dt_iop_roi_t *const roi_out)
+{
+  dt_trace_span_t span = dt_trace_begin("blend", self->op);
+  _develop_blend_process(self, piece, ivoid, ovoid, roi_in, roi_out);
+  dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(piece->pipe->type),
+               sizeof(float) * piece->colors
+                   * ((size_t)roi_in->width * roi_in->height + (size_t)roi_out->width * roi_out->height));
+}
+
 #ifdef HAVE_OPENCL
-int dt_develop_blend_process_cl(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
-                                cl_mem dev_in, cl_mem dev_out, const struct dt_iop_roi_t *roi_in,
-                                const struct dt_iop_roi_t *roi_out)
+static int _develop_blend_process_cl(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                                     cl_mem dev_in, cl_mem dev_out, const struct dt_iop_roi_t *roi_in,
+                                     const struct dt_iop_roi_t *roi_out)
 {
   dt_develop_blend_params_t *d = (dt_develop_blend_params_t *)piece->blendop_data;
   cl_int err = -999;
@@ -3296,6 +3344,18 @@ error:
   dt_print(DT_DEBUG_OPENCL, "[opencl_blendop] couldn't enqueue kernel! %d\n", err);
   return FALSE;
 }
+
+int dt_develop_blend_process_cl(struct dt_iop_module_t *self, struct dt_dev_pixelpipe_iop_t *piece,
+                                cl_mem dev_in, cl_mem dev_out, const struct dt_iop_roi_t *roi_in,
+                                const struct dt_iop_roi_t *roi_out)
+{
+  dt_trace_span_t span = dt_trace_begin("blend", self->op);
+  const int success = _develop_blend_process_cl(self, piece, dev_in, dev_out, roi_in, roi_out);
+  dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(piece->pipe->type),
+               sizeof(float) * piece->colors
+                   * ((size_t)roi_in->width * roi_in->height + (size_t)roi_out->width * roi_out->height));
+  return success;
+}
 #endif
 
 /** global init of blendops */
@@ -46,6 +46,8 @@
 #define DT_DEV_AVERAGE_DELAY_START 250
 #define DT_DEV_PREVIEW_AVERAGE_DELAY_START 50
 #define DT_DEV_AVERAGE_DELAY_COUNT 5
+// full resolution runs of the center view expected to take longer than this (in ms) are preceded by coarse ones
+#define DT_DEV_PROGRESSIVE_DELAY 400
 
 const gchar *dt_dev_histogram_type_names[DT_DEV_HISTOGRAM_N] = { "logarithmic", "linear", "waveform" };
 
@@ -77,6 +79,7 @@ void dt_dev_init(dt_develop_t *dev, int32_t gui_attached)
   dev->pipe = dev->preview_pipe = NULL;
   dt_pthread_mutex_init(&dev->pipe_mutex, NULL);
   dt_pthread_mutex_init(&dev->preview_pipe_mutex, NULL);
+  dt_pthread_mutex_init(&dev->early_stage.lock, NULL);
   //   dt_pthread_mutex_init(&dev->histogram_waveform_mutex, NULL);
   dev->histogram = NULL;
   dev->histogram_pre_tonecurve = NULL;
@@ -133,6 +136,8 @@ void dt_dev_cleanup(dt_develop_t *dev)
   // image_cache does not have to be unref'd, this is done outside develop module.
   dt_pthread_mutex_destroy(&dev->pipe_mutex);
   dt_pthread_mutex_destroy(&dev->preview_pipe_mutex);
+  dt_pthread_mutex_destroy(&dev->early_stage.lock);
+  dt_free_align(dev->early_stage.buf);
   //   dt_pthread_mutex_destroy(&dev->histogram_waveform_mutex);
   if(dev->pipe)
   {
@@ -296,6 +301,49 @@ restart:
   dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
 }
 
+// number of coarse passes to show before the full resolution one. each of them halves the size and takes
+// about a quarter of the time, so go only as coarse as needed for the first one to show up quickly.
+static int _dev_coarse_levels(const dt_develop_t *dev)
+{
+  if(!dev->gui_attached || !dt_conf_get_bool("darkroom/ui/progressive_rendering")) return 0;
+  int levels = 0;
+  for(uint32_t delay = dev->average_delay; delay > DT_DEV_PROGRESSIVE_DELAY; delay /= 4)
+    if(++levels == DT_DEV_PIXELPIPE_COARSE_LEVELS) break;
+  return levels;
+}
+
+// grows the region of interest by a margin on each side, as far as the image and the memory for the prefetch
+// cache allow. returns FALSE if that isn't worth another run of the pipe.
+static gboolean _dev_prefetch_region(const dt_develop_t *dev, const float scale, int *x, int *y, int *wd, int *ht)
+{
+  const int budget = dt_conf_get_int("darkroom/ui/prefetch_memory");
+  if(!dev->gui_attached || budget <= 0) return FALSE;
+
+  const int full_wd = dev->pipe->processed_width * scale;
+  const int full_ht = dev->pipe->processed_height * scale;
+  if(*wd >= full_wd && *ht >= full_ht) return FALSE; // all of the image is in view, nowhere to pan to
+
+  // three cache lines of four floats per pixel, the margin m solves (wd + 2m) * (ht + 2m) = pixels
+  const double pixels = budget * 1024.0 * 1024.0 / (3 * 4 * sizeof(float));
+  const double b = *wd + *ht;
+  const double c = (double)*wd * *ht - pixels;
+  if(c >= 0.0) return FALSE;
+  const int margin = (sqrt(b * b - 4.0 * c) - b) / 4.0;
+  if(margin < 64) return FALSE;
+
+  const int x0 = MAX(0, *x - margin);
+  const int y0 = MAX(0, *y - margin);
+  const int x1 = MIN(full_wd, *x + *wd + margin);
+  const int y1 = MIN(full_ht, *y + *ht + margin);
+  if(x1 - x0 <= *wd && y1 - y0 <= *ht) return FALSE;
+
+  *x = x0;
+  *y = y0;
+  *wd = x1 - x0;
+  *ht = y1 - y0;
+  return TRUE;
+}
+
 void dt_dev_process_image_job(dt_develop_t *dev)
 {
   dt_pthread_mutex_lock(&dev->pipe_mutex);
@@ -348,7 +396,7 @@ void dt_dev_process_image_job(dt_develop_t *dev)
 
   dt_dev_zoom_t zoom;
   float zoom_x, zoom_y, scale;
-  int window_width, window_height, x, y, closeup;
+  int x, y, wd, ht, closeup;
   dt_dev_pixelpipe_change_t pipe_changed;
 
 // adjust pipeline according to changed flag set by {add,pop}_history_item.
@@ -381,21 +429,26 @@ restart:
     dt_control_set_dev_zoom_y(zoom_y);
   }
 
-  scale = dt_dev_get_zoom_scale(dev, zoom, 1.0f, 0) * darktable.gui->ppd;
-  window_width = dev->width * darktable.gui->ppd;
-  window_height = dev->height * darktable.gui->ppd;
-  if(closeup)
+  dt_dev_get_viewport(dev, zoom, closeup, zoom_x, zoom_y, &scale, &x, &y, &wd, &ht);
+  dt_dev_pixelpipe_early_stage_expect(dev->pipe, dev, x, y, wd, ht, scale);
+
+  for(int level = _dev_coarse_levels(dev); level > 0; level--)
   {
-    window_width /= 2;
-    window_height /= 2;
+    dt_get_times(&start);
+    // on failure the full resolution run below stops right away, too, and sorts out why
+    if(dt_dev_pixelpipe_process_coarse(dev->pipe, dev, x, y, wd, ht, scale, level)) break;
+    dt_show_times(&start, "[dev_process_image] pixel pipeline processing", "at 1/%d scale", 1 << level);
+    if(dev->pipe->changed != DT_DEV_PIPE_UNCHANGED) goto restart;
+
+    // show it while the next pass is running, darkroom stretches it to the final size
+    dev->image_status = DT_DEV_PIXELPIPE_VALID;
+    if(dev->gui_attached) dt_control_queue_redraw_center();
   }
-  const int wd = MIN(window_width, dev->pipe->processed_width * scale);
-  const int ht = MIN(window_height, dev->pipe->processed_height * scale);
-  x = MAX(0, scale * dev->pipe->processed_width  * (.5 + zoom_x) - wd / 2);
-  y = MAX(0, scale * dev->pipe->processed_height * (.5 + zoom_y) - ht / 2);
 
   dt_get_times(&start);
-  if(dt_dev_pixelpipe_process(dev->pipe, dev, x, y, wd, ht, scale))
+  const int failed = dt_dev_pixelpipe_process(dev->pipe, dev, x, y, wd, ht, scale);
+  dt_dev_pixelpipe_early_stage_expect(dev->pipe, dev, 0, 0, 0, 0, 0.0f);
+  if(failed)
   {
     // interrupted because image changed?
     if(dev->image_force_reload)
@@ -419,10 +472,28 @@ restart:
   // cool, we got a new image!
   dev->image_status = DT_DEV_PIXELPIPE_VALID;
   dev->image_loading = 0;
+  dev->image_history_hash = dt_dev_hash_plus(dev, dev->pipe, 0, 99999);
 
-  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
   // redraw the whole thing, to also update color picker values and histograms etc.
   if(dev->gui_attached) dt_control_queue_redraw();
+
+  // use the time until the next change to render a margin around the view. pans inside of it are drawn
+  // right away, see dt_dev_view_is_rendered().
+  if(_dev_prefetch_region(dev, scale, &x, &y, &wd, &ht))
+  {
+    dt_get_times(&start);
+    if(dt_dev_pixelpipe_process_prefetch(dev->pipe, dev, x, y, wd, ht, scale)
+       || dev->pipe->changed != DT_DEV_PIPE_UNCHANGED)
+    {
+      // a reload comes with a new job, anything else is handled by this one
+      if(!dev->image_force_reload) goto restart;
+      dev->image_status = DT_DEV_PIXELPIPE_INVALID;
+    }
+    else
+      dt_show_times(&start, "[dev_process_image] pixel pipeline processing", "of %dx%d around the view", wd, ht);
+  }
+
+  dt_mipmap_cache_release(darktable.mipmap_cache, &buf);
   dt_control_log_busy_leave();
   dt_pthread_mutex_unlock(&dev->pipe_mutex);
 }
@@ -452,6 +523,44 @@ void dt_dev_reload_image(dt_develop_t *dev, const uint32_t imgid)
   dt_dev_invalidate(dev); // only invalidate image, preview will follow once it's loaded.
 }
 
+void dt_dev_get_viewport(dt_develop_t *dev, dt_dev_zoom_t zoom, int closeup, float zoom_x, float zoom_y,
+                         float *scale, int *x, int *y, int *wd, int *ht)
+{
+  *scale = dt_dev_get_zoom_scale(dev, zoom, 1.0f, 0) * darktable.gui->ppd;
+  int window_width = dev->width * darktable.gui->ppd;
+  int window_height = dev->height * darktable.gui->ppd;
+  if(closeup)
+  {
+    window_width /= 2;
+    window_height /= 2;
+  }
+  *wd = MIN(window_width, dev->pipe->processed_width * *scale);
+  *ht = MIN(window_height, dev->pipe->processed_height * *scale);
+  *x = MAX(0, *scale * dev->pipe->processed_width  * (.5 + zoom_x) - *wd / 2);
+  *y = MAX(0, *scale * dev->pipe->processed_height * (.5 + zoom_y) - *ht / 2);
+}
+
+gboolean dt_dev_view_is_rendered(dt_develop_t *dev)
+{
+  if(dev->image_status != DT_DEV_PIXELPIPE_VALID || dev->pipe->changed != DT_DEV_PIPE_UNCHANGED
+     || dev->pipe->input_timestamp != dev->timestamp
+     || dev->image_history_hash != dt_dev_hash_plus(dev, dev->pipe, 0, 99999))
+    return FALSE;
+
+  float scale;
+  int x, y, wd, ht;
+  dt_dev_get_viewport(dev, dt_control_get_dev_zoom(), dt_control_get_dev_closeup(), dt_control_get_dev_zoom_x(),
+                      dt_control_get_dev_zoom_y(), &scale, &x, &y, &wd, &ht);
+
+  dt_dev_pixelpipe_t *pipe = dev->pipe;
+  dt_pthread_mutex_lock(&pipe->backbuf_mutex);
+  const gboolean rendered = pipe->backbuf && pipe->backbuf_scale == scale && x >= pipe->backbuf_x
+                            && y >= pipe->backbuf_y && x + wd <= pipe->backbuf_x + pipe->backbuf_width
+                            && y + ht <= pipe->backbuf_y + pipe->backbuf_height;
+  dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
+  return rendered;
+}
+
 float dt_dev_get_zoom_scale(dt_develop_t *dev, dt_dev_zoom_t zoom, int closeup_factor, int preview)
 {
   float zoom_scale;
@@ -949,7 +1058,7 @@ static void auto_apply_presets(dt_develop_t *dev)
                                     "UPDATE memory.history SET num=?1 WHERE rowid=?2", -1, &stmt, NULL);
 
         // let's wrap this into a transaction, it might make it a little faster.
-        sqlite3_exec(dt_database_get(darktable.db), "BEGIN TRANSACTION", NULL, NULL, NULL);
+        dt_database_start_transaction(darktable.db);
         do
         {
           DT_DEBUG_SQLITE3_CLEAR_BINDINGS(stmt);
@@ -963,7 +1072,7 @@ static void auto_apply_presets(dt_develop_t *dev)
           r = g_list_next(r);
         } while((sqlite3_step(stmt) == SQLITE_DONE) && r);
 
-        sqlite3_exec(dt_database_get(darktable.db), "COMMIT", NULL, NULL, NULL);
+        dt_database_release_transaction(darktable.db);
 
         g_list_free(rowids);
         sqlite3_finalize(stmt);
@@ -1019,11 +1128,25 @@ void dt_dev_read_history(dt_develop_t *dev)
   // maybe prepend auto-presets to history before loading it:
   auto_apply_presets(dev);
 
+  // index the instances by "op priority", and remember one instance per op to load new instances from.
+  // heavily edited images have hundreds of history items, so don't walk dev->iop for each of them.
+  GHashTable *instances = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  GHashTable *ops = g_hash_table_new(g_str_hash, g_str_equal);
+  for(GList *modules = dev->iop; modules; modules = g_list_next(modules))
+  {
+    dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
+    g_hash_table_insert(instances, g_strdup_printf("%s %d", module->op, module->multi_priority), module);
+    g_hash_table_insert(ops, module->op, module);
+  }
+
+  // new items are prepended and the list is reversed once at the end
+  GList *history = NULL;
+
   sqlite3_stmt *stmt;
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT imgid, num, module, operation, "
-                                                             "op_params, enabled, blendop_params, "
-                                                             "blendop_version, multi_priority, multi_name "
-                                                             "FROM main.history WHERE imgid = ?1 ORDER BY num",
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get_reader(darktable.db), "SELECT imgid, num, module, operation, "
+                                                                    "op_params, enabled, blendop_params, "
+                                                                    "blendop_version, multi_priority, multi_name "
+                                                                    "FROM main.history WHERE imgid = ?1 ORDER BY num",
                               -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dev->image_storage.id);
   dev->history_end = 0;
@@ -1035,7 +1158,6 @@ void dt_dev_read_history(dt_develop_t *dev)
     dt_dev_history_item_t *hist = (dt_dev_history_item_t *)malloc(sizeof(dt_dev_history_item_t));
     hist->enabled = sqlite3_column_int(stmt, 5);
 
-    GList *modules = dev->iop;
     const char *opname = (const char *)sqlite3_column_text(stmt, 3);
     int multi_priority = sqlite3_column_int(stmt, 8);
     const char *multi_name = (const char *)sqlite3_column_text(stmt, 9);
@@ -1047,45 +1169,39 @@ void dt_dev_read_history(dt_develop_t *dev)
       continue;
     }
 
-    hist->module = NULL;
-    dt_iop_module_t *find_op = NULL;
-    while(opname && modules)
+    gchar *key = g_strdup_printf("%s %d", opname, multi_priority);
+    hist->module = (dt_iop_module_t *)g_hash_table_lookup(instances, key);
+    if(hist->module)
     {
-      dt_iop_module_t *module = (dt_iop_module_t *)modules->data;
-      if(!strcmp(module->op, opname))
-      {
-        if(module->multi_priority == multi_priority)
-        {
-          hist->module = module;
-          if(multi_name)
-            snprintf(module->multi_name, sizeof(module->multi_name), "%s", multi_name);
-          else
-            memset(module->multi_name, 0, sizeof(module->multi_name));
-          break;
-        }
-        else if(multi_priority > 0)
-        {
-          // we just say that we find the name, so we just have to add new instance of this module
-          find_op = module;
-        }
-      }
-      modules = g_list_next(modules);
+      if(multi_name)
+        snprintf(hist->module->multi_name, sizeof(hist->module->multi_name), "%s", multi_name);
+      else
+        memset(hist->module->multi_name, 0, sizeof(hist->module->multi_name));
+      g_free(key);
     }
-    if(!hist->module && find_op)
+    else
     {
-      // we have to add a new instance of this module and set index to modindex
-      dt_iop_module_t *new_module = (dt_iop_module_t *)calloc(1, sizeof(dt_iop_module_t));
-      if(!dt_iop_load_module(new_module, find_op->so, dev))
+      // we just say that we find the name, so we just have to add new instance of this module
+      dt_iop_module_t *find_op = multi_priority > 0 ? (dt_iop_module_t *)g_hash_table_lookup(ops, opname) : NULL;
+      if(find_op)
       {
-        new_module->multi_priority = multi_priority;
+        // we have to add a new instance of this module and set index to modindex
+        dt_iop_module_t *new_module = (dt_iop_module_t *)calloc(1, sizeof(dt_iop_module_t));
+        if(!dt_iop_load_module(new_module, find_op->so, dev))
+        {
+          new_module->multi_priority = multi_priority;
 
-        snprintf(new_module->multi_name, sizeof(new_module->multi_name), "%s", multi_name);
+          snprintf(new_module->multi_name, sizeof(new_module->multi_name), "%s", multi_name);
 
-        dev->iop = g_list_insert_sorted(dev->iop, new_module, sort_plugins);
+          dev->iop = g_list_insert_sorted(dev->iop, new_module, sort_plugins);
 
-        new_module->instance = find_op->instance;
-        hist->module = new_module;
+          new_module->instance = find_op->instance;
+          hist->module = new_module;
+          g_hash_table_insert(instances, key, new_module);
+          key = NULL;
+        }
       }
+      g_free(key);
     }
 
     if(!hist->module && opname)
@@ -1187,13 +1303,16 @@ void dt_dev_read_history(dt_develop_t *dev)
     // printf("[dev read history] img %d number %d for operation %d - %s params %f %f\n",
     // sqlite3_column_int(stmt, 0), sqlite3_column_int(stmt, 1), instance, hist->module->op, *(float
     // *)hist->params, *(((float*)hist->params)+1));
-    dev->history = g_list_append(dev->history, hist);
+    history = g_list_prepend(history, hist);
     dev->history_end++;
   }
   sqlite3_finalize(stmt);
+  dev->history = g_list_concat(dev->history, g_list_reverse(history));
+  g_hash_table_destroy(instances);
+  g_hash_table_destroy(ops);
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT history_end FROM main.images WHERE id = ?1",
-                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get_reader(darktable.db),
+                              "SELECT history_end FROM main.images WHERE id = ?1", -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, dev->image_storage.id);
   if(sqlite3_step(stmt) == SQLITE_ROW) // seriously, this should never fail
   {
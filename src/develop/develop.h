@@ -121,6 +121,7 @@ typedef struct dt_develop_t
   int32_t image_loading, first_load, image_force_reload;
   int32_t preview_loading, preview_input_changed;
   dt_dev_pixelpipe_status_t image_status, preview_status;
+  uint64_t image_history_hash; // dt_dev_hash_plus() of the full pipe when its backbuf was rendered
   uint32_t timestamp;
   uint32_t average_delay;
   uint32_t preview_average_delay;
@@ -134,6 +135,19 @@ typedef struct dt_develop_t
   struct dt_dev_pixelpipe_t *pipe, *preview_pipe;
   dt_pthread_mutex_t pipe_mutex, preview_pipe_mutex; // these are locked while the pipes are still in use
 
+  // output of demosaic in the full pipe, which the preview pipe can start from instead of processing the raw
+  // modules itself (see darkroom/ui/preview_from_full). protected by lock.
+  struct
+  {
+    dt_pthread_mutex_t lock;
+    uint64_t hash;     // hash of the modules up to demosaic for buf, 0 if empty
+    uint64_t expected; // same for the run of the full pipe which is going to publish next, 0 if none
+    float *buf;
+    size_t size;
+    dt_iop_roi_t roi;
+    dt_iop_buffer_dsc_t dsc;
+  } early_stage;
+
   // image under consideration, which
   // is copied each time an image is changed. this means we have some information
   // always cached (might be out of sync, so stars are not reliable), but for the iops
@@ -286,6 +300,12 @@ void dt_dev_get_processed_size(const dt_develop_t *dev, int *procw, int *proch);
 void dt_dev_check_zoom_bounds(dt_develop_t *dev, float *zoom_x, float *zoom_y, dt_dev_zoom_t zoom,
                               int closeup, float *boxw, float *boxh);
 float dt_dev_get_zoom_scale(dt_develop_t *dev, dt_dev_zoom_t zoom, int closeup_factor, int mode);
+/** the region of the image the center view shows, in pixels of the full pipe at scale */
+void dt_dev_get_viewport(dt_develop_t *dev, dt_dev_zoom_t zoom, int closeup, float zoom_x, float zoom_y,
+                         float *scale, int *x, int *y, int *wd, int *ht);
+/** TRUE if the backbuf of the full pipe is up to date and covers the current view, pans and redraws don't
+ * need another run of the pipe then. */
+gboolean dt_dev_view_is_rendered(dt_develop_t *dev);
 void dt_dev_get_pointer_zoom_pos(dt_develop_t *dev, const float px, const float py, float *zoom_x,
                                  float *zoom_y);
 
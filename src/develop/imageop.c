@@ -22,6 +22,7 @@
 #include "bauhaus/bauhaus.h"
 #include "common/debug.h"
 #include "common/dtpthread.h"
+#include "common/file_location.h"
 #include "common/imageio_rawspeed.h"
 #include "common/interpolation.h"
 #include "common/module.h"
@@ -42,7 +43,9 @@
 #include "libs/modulegroups.h"
 
 #include <assert.h>
+#include <glib/gstdio.h>
 #include <gmodule.h>
+#include <inttypes.h>
 #include <math.h>
 #include <stdlib.h>
 #include <string.h>
@@ -342,11 +345,14 @@ int dt_iop_load_module_so(void *m, const char *libname, const char *op)
 error:
   fprintf(stderr, "[iop_load_module] failed to open operation `%s': %s\n", op, g_module_error());
   if(module->module) g_module_close(module->module);
+  module->module = NULL;
   return 1;
 }
 
 static int dt_iop_load_module_by_so(dt_iop_module_t *module, dt_iop_module_so_t *so, dt_develop_t *dev)
 {
+  if(dt_iop_so_load(so)) return 1;
+
   module->dt = &darktable;
   module->dev = dev;
   module->widget = NULL;
@@ -1050,19 +1056,29 @@ void dt_iop_cleanup_histogram(gpointer data, gpointer user_data)
 
 static void init_presets(dt_iop_module_so_t *module_so)
 {
-  if(module_so->init_presets) module_so->init_presets(module_so);
+  int32_t module_version = module_so->manifest_version;
+
+  // the built-in presets are kept in data.db, only write them when the module or the build changed. a module
+  // from the manifest has its .so opened for that.
+  if((!g_atomic_int_get(&module_so->loaded) || module_so->init_presets)
+     && dt_gui_presets_begin_builtin(module_so->op, module_version) && !dt_iop_so_load(module_so))
+  {
+    if(module_so->init_presets) module_so->init_presets(module_so);
+    dt_gui_presets_end_builtin(module_so->op, module_version);
+  }
 
   // this seems like a reasonable place to check for and update legacy
   // presets.
 
-  int32_t module_version = module_so->version();
-
   sqlite3_stmt *stmt;
   DT_DEBUG_SQLITE3_PREPARE_V2(
       dt_database_get(darktable.db),
-      "SELECT name, op_version, op_params, blendop_version, blendop_params FROM data.presets WHERE operation = ?1",
+      "SELECT name, op_version, op_params, blendop_version, blendop_params FROM data.presets WHERE operation = ?1 "
+      "AND (op_version < ?2 OR blendop_version < ?3 OR blendop_params IS NULL)",
       -1, &stmt, NULL);
   DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, module_so->op, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, module_version);
+  DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, dt_develop_blend_version());
 
   while(sqlite3_step(stmt) == SQLITE_ROW)
   {
@@ -1119,7 +1135,7 @@ static void init_presets(dt_iop_module_so_t *module_so)
       sqlite3_finalize(stmt2);
     }
 
-    if(module_version > old_params_version && module_so->legacy_params != NULL)
+    if(module_version > old_params_version && !dt_iop_so_load(module_so) && module_so->legacy_params != NULL)
     {
       fprintf(stderr, "[imageop_init_presets] updating '%s' preset '%s' from version %d to version %d\n",
               module_so->op, name, old_params_version, module_version);
@@ -1271,11 +1287,11 @@ static void dt_iop_init_module_so(void *m)
     // Calling the accelerator initialization callback, if present
     init_key_accels(module);
 
-    if(module->flags() & IOP_FLAGS_SUPPORTS_BLENDING)
+    if(module->manifest_flags & IOP_FLAGS_SUPPORTS_BLENDING)
     {
       dt_accel_register_slider_iop(module, FALSE, NC_("accel", "fusion"));
     }
-    if(!(module->flags() & IOP_FLAGS_DEPRECATED))
+    if(!(module->manifest_flags & IOP_FLAGS_DEPRECATED))
     {
       // Adding the optional show accelerator to the table (blank)
       dt_accel_register_iop(module, FALSE, NC_("accel", "show module"), 0, 0);
@@ -1287,10 +1303,159 @@ static void dt_iop_init_module_so(void *m)
   }
 }
 
+// the manifest in the cache dir records op, version() and flags() of every iop together with size and mtime of
+// its .so. without gui that is all dt_init needs, so matching modules are registered without opening the .so.
+// the gui registers keyboard accels from the .so of every module and always opens them, keeping the manifest
+// current.
+typedef struct dt_iop_manifest_entry_t
+{
+  int version;
+  int flags;
+  int64_t size;
+  int64_t mtime;
+} dt_iop_manifest_entry_t;
+
+typedef struct dt_iop_manifest_t
+{
+  GHashTable *entries; // op -> dt_iop_manifest_entry_t
+  gboolean defer;
+  gboolean changed;
+} dt_iop_manifest_t;
+
+// only used while dt_iop_load_modules_so() runs, the loader callback has no user data
+static dt_iop_manifest_t _manifest = { NULL, FALSE, FALSE };
+
+// serialises opening the .so of modules registered from the manifest
+static GMutex _so_load_mutex;
+
+static gchar *_manifest_filename()
+{
+  char cachedir[PATH_MAX] = { 0 };
+  dt_loc_get_user_cache_dir(cachedir, sizeof(cachedir));
+  return g_build_filename(cachedir, "iop-manifest", NULL);
+}
+
+static void _manifest_read()
+{
+  _manifest.entries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  _manifest.changed = FALSE;
+
+  gchar *filename = _manifest_filename();
+  gchar *contents = NULL;
+  if(g_file_get_contents(filename, &contents, NULL, NULL))
+  {
+    gchar **lines = g_strsplit(contents, "\n", -1);
+    int file_version = 0;
+    // the first line is the module interface version, the manifest of another build is of no use
+    if(lines[0] && sscanf(lines[0], "darktable iop manifest %d", &file_version) == 1
+       && file_version == dt_version())
+    {
+      for(gchar **line = lines + 1; *line; line++)
+      {
+        char op[20];
+        dt_iop_manifest_entry_t entry;
+        if(sscanf(*line, "%19s %d %d %" SCNd64 " %" SCNd64, op, &entry.version, &entry.flags, &entry.size,
+                  &entry.mtime) != 5)
+          continue;
+        g_hash_table_insert(_manifest.entries, g_strdup(op), g_memdup(&entry, sizeof(entry)));
+      }
+    }
+    g_strfreev(lines);
+    g_free(contents);
+  }
+  g_free(filename);
+}
+
+static void _manifest_write()
+{
+  GString *contents = g_string_new(NULL);
+  g_string_append_printf(contents, "darktable iop manifest %d\n", dt_version());
+  for(GList *iop = darktable.iop; iop; iop = g_list_next(iop))
+  {
+    dt_iop_module_so_t *module = (dt_iop_module_so_t *)iop->data;
+    GStatBuf st;
+    if(g_stat(module->libname, &st)) continue;
+    g_string_append_printf(contents, "%s %d %d %" PRId64 " %" PRId64 "\n", module->op, module->manifest_version,
+                           module->manifest_flags, (int64_t)st.st_size, (int64_t)st.st_mtime);
+  }
+
+  gchar *filename = _manifest_filename();
+  if(!g_file_set_contents(filename, contents->str, contents->len, NULL))
+    fprintf(stderr, "[iop_load_module] can't write the module manifest `%s'\n", filename);
+  g_free(filename);
+  g_string_free(contents, TRUE);
+}
+
+static int _iop_load_module_so_manifest(void *m, const char *libname, const char *op)
+{
+  dt_iop_module_so_t *module = (dt_iop_module_so_t *)m;
+  const dt_iop_manifest_entry_t *entry = g_hash_table_lookup(_manifest.entries, op);
+  GStatBuf st;
+  const gboolean current = entry && !g_stat(libname, &st) && entry->size == (int64_t)st.st_size
+                           && entry->mtime == (int64_t)st.st_mtime;
+
+  module->libname = g_strdup(libname);
+  if(current && _manifest.defer)
+  {
+    g_strlcpy(module->op, op, sizeof(module->op));
+    module->manifest_version = entry->version;
+    module->manifest_flags = entry->flags;
+    dt_print(DT_DEBUG_CONTROL, "[iop_load_module] registered iop `%s' from the manifest\n", op);
+    return 0;
+  }
+
+  if(dt_iop_load_module_so(m, libname, op))
+  {
+    g_free(module->libname);
+    return 1;
+  }
+  module->manifest_version = module->version();
+  module->manifest_flags = module->flags();
+  g_atomic_int_set(&module->loaded, 1);
+
+  if(!current || entry->version != module->manifest_version || entry->flags != module->manifest_flags)
+    _manifest.changed = TRUE;
+  return 0;
+}
+
+int dt_iop_so_load(dt_iop_module_so_t *module)
+{
+  // > 0 open, < 0 failed to open
+  const int loaded = g_atomic_int_get(&module->loaded);
+  if(loaded) return loaded < 0;
+
+  g_mutex_lock(&_so_load_mutex);
+  if(!g_atomic_int_get(&module->loaded))
+  {
+    const double start = dt_get_wtime();
+    char op[20];
+    g_strlcpy(op, module->op, sizeof(op));
+    const int res = dt_iop_load_module_so(module, module->libname, op);
+    g_atomic_int_set(&module->loaded, res ? -1 : 1);
+    dt_print(DT_DEBUG_PERF, "[iop_load_module] opened iop `%s' on first use in %.3f secs\n", op,
+             dt_get_wtime() - start);
+  }
+  g_mutex_unlock(&_so_load_mutex);
+
+  return g_atomic_int_get(&module->loaded) < 0;
+}
+
 void dt_iop_load_modules_so()
 {
-  darktable.iop = dt_module_load_modules("/plugins", sizeof(dt_iop_module_so_t), dt_iop_load_module_so,
+  _manifest_read();
+  _manifest.defer = !darktable.gui;
+
+  // one transaction for the presets of all modules
+  dt_database_start_transaction(darktable.db);
+  darktable.iop = dt_module_load_modules("/plugins", sizeof(dt_iop_module_so_t), _iop_load_module_so_manifest,
                                          dt_iop_init_module_so, NULL);
+  dt_database_release_transaction(darktable.db);
+
+  // also drops the entries of modules that are gone
+  if(_manifest.changed || g_hash_table_size(_manifest.entries) != g_list_length(darktable.iop))
+    _manifest_write();
+  g_hash_table_destroy(_manifest.entries);
+  _manifest.entries = NULL;
 }
 
 int dt_iop_load_module(dt_iop_module_t *module, dt_iop_module_so_t *module_so, dt_develop_t *dev)
@@ -1321,6 +1486,7 @@ GList *dt_iop_load_modules(dt_develop_t *dev)
     if(dt_iop_load_module_by_so(module, module_so, dev))
     {
       free(module);
+      iop = g_list_next(iop);
       continue;
     }
     res = g_list_insert_sorted(res, module, sort_plugins);
@@ -1360,8 +1526,10 @@ void dt_iop_unload_modules_so()
   while(darktable.iop)
   {
     dt_iop_module_so_t *module = (dt_iop_module_so_t *)darktable.iop->data;
-    if(module->cleanup_global) module->cleanup_global(module);
+    // modules from the manifest that were never used have nothing to clean up
+    if(g_atomic_int_get(&module->loaded) > 0 && module->cleanup_global) module->cleanup_global(module);
     if(module->module) g_module_close(module->module);
+    g_free(module->libname);
     free(darktable.iop->data);
     darktable.iop = g_list_delete_link(darktable.iop, darktable.iop);
   }
@@ -1967,6 +2135,21 @@ int dt_iop_breakpoint(struct dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe)
   return 0;
 }
 
+int dt_iop_should_abort(const dt_dev_pixelpipe_iop_t *piece)
+{
+  const dt_dev_pixelpipe_t *pipe = piece->pipe;
+  const dt_develop_t *dev = piece->module->dev;
+  if(pipe->shutdown || dev->gui_leaving) return 1;
+  // the same reasons dt_dev_pixelpipe_process_rec() stops for between the modules
+  if(pipe != dev->preview_pipe && pipe->changed == DT_DEV_PIPE_ZOOMED) return 1;
+  if(pipe->changed != DT_DEV_PIPE_UNCHANGED && pipe->changed != DT_DEV_PIPE_ZOOMED) return 1;
+  if(pipe == dev->pipe && dev->image_force_reload) return 1;
+  // zoomed or panned to somewhere else since the run started
+  if(pipe == dev->pipe && pipe->input_timestamp < dev->timestamp) return 1;
+  if(pipe == dev->preview_pipe && dev->preview_loading) return 1;
+  return 0;
+}
+
 void dt_iop_nap(int32_t usec)
 {
   if(usec <= 0) return;
@@ -2071,7 +2254,7 @@ gchar *dt_iop_get_localized_name(const gchar *op)
       do
       {
         dt_iop_module_so_t *module = (dt_iop_module_so_t *)iop->data;
-        g_hash_table_insert(module_names, module->op, g_strdup(module->name()));
+        if(!dt_iop_so_load(module)) g_hash_table_insert(module_names, module->op, g_strdup(module->name()));
       } while((iop = g_list_next(iop)) != NULL);
     }
   }
@@ -136,6 +136,13 @@ typedef struct dt_iop_module_so_t
   GtkWidget *widget;
   /** button used to show/hide this module in the plugin list. */
   dt_iop_module_state_t state;
+  /** path of the .so. modules registered from the manifest only open it in dt_iop_so_load(). */
+  gchar *libname;
+  /** set once the .so is open and all callbacks below are valid. */
+  gint loaded;
+  /** version() and flags(), valid whether or not the .so is open. */
+  int manifest_version;
+  int manifest_flags;
 
   /** this initializes static, hardcoded presets for this module and is called only once per run of dt. */
   void (*init_presets)(struct dt_iop_module_so_t *self);
@@ -453,8 +460,11 @@ typedef struct dt_iop_module_t
 
 } dt_iop_module_t;
 
-/** loads and inits the modules in the plugins/ directory. */
+/** loads and inits the modules in the plugins/ directory. without gui the .so files listed in the manifest are
+ * only opened on first use. */
 void dt_iop_load_modules_so();
+/** opens the .so of a module registered from the manifest, returns 0 once all callbacks can be used. */
+int dt_iop_so_load(dt_iop_module_so_t *module);
 /** cleans up the dlopen refs. */
 void dt_iop_unload_modules_so();
 /** returns a list of instances referencing stuff loaded in load_modules_so. */
@@ -514,6 +524,11 @@ void dt_iop_cleanup_histogram(gpointer data, gpointer user_data);
 /** let plugins have breakpoints: */
 int dt_iop_breakpoint(struct dt_develop_t *dev, struct dt_dev_pixelpipe_t *pipe);
 
+/** returns non-zero when the pipe of piece is going to start over or shuts down, so whatever process() is
+ * computing won't be used. cheap enough for the outer loops of expensive modules, which may then return at
+ * once: the pipe throws away their output. */
+int dt_iop_should_abort(const struct dt_dev_pixelpipe_iop_t *piece);
+
 /** allow plugins to relinquish CPU and go to sleep for some time */
 void dt_iop_nap(int32_t usec);
 
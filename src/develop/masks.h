@@ -243,6 +243,12 @@ int dt_masks_group_render(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece
                           float **buffer, int *roi, float scale);
 int dt_masks_group_render_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                               const dt_iop_roi_t *roi, float *buffer);
+/** like dt_masks_get_mask(), but takes the mask from the cache of the darkroom pipes when the forms and
+ * the modules in front of this one didn't change. dt_masks_group_render_roi() uses the same cache. */
+int dt_masks_get_mask_cached(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
+                             float **buffer, int *width, int *height, int *posx, int *posy);
+/** free the cached masks of a pipe */
+void dt_masks_cache_cleanup(struct dt_dev_pixelpipe_t *pipe);
 
 // returns current masks version
 int dt_masks_version(void);
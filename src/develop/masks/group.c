@@ -449,6 +449,169 @@ error:
   return 0;
 }
 
+// rasterized masks of the darkroom pipes. a mask only depends on its forms, on the modules in front of the one
+// using it (they distort the forms) and on the roi, so moving a slider doesn't have to render all the forms
+// again. the cache is bounded by memory rather than by a number of entries: spots asks for one small mask per
+// form, the blending for one of the size of the roi. entries are recycled least recently used first.
+typedef struct dt_masks_cache_entry_t
+{
+  uint64_t hash;
+  float *buffer;
+  size_t size;
+  int width, height, posx, posy;
+} dt_masks_cache_entry_t;
+
+typedef struct dt_masks_cache_t
+{
+  GList *entries; // most recently used first
+  size_t size;    // bytes held by all entries
+} dt_masks_cache_t;
+
+static void _masks_cache_entry_free(gpointer data)
+{
+  dt_masks_cache_entry_t *e = (dt_masks_cache_entry_t *)data;
+  free(e->buffer);
+  free(e);
+}
+
+void dt_masks_cache_cleanup(dt_dev_pixelpipe_t *pipe)
+{
+  dt_masks_cache_t *cache = pipe->mask_cache;
+  if(!cache) return;
+  g_list_free_full(cache->entries, _masks_cache_entry_free);
+  free(cache);
+  pipe->mask_cache = NULL;
+}
+
+// a sixteenth of the memory the pixelpipe may use, per pipe
+static size_t _masks_cache_budget()
+{
+  const int limit = dt_conf_get_int("host_memory_limit");
+  return ((size_t)(limit > 0 ? limit : 500) << 20) / 16;
+}
+
+static gboolean _masks_cache_enabled(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece)
+{
+  // the hash of the forms is only complete for the forms of the darkroom, and the other pipes don't come back
+  // with the same masks anyway
+  return module->dev == darktable.develop
+         && (piece->pipe->type & (DT_DEV_PIXELPIPE_FULL | DT_DEV_PIXELPIPE_PREVIEW));
+}
+
+static uint64_t _masks_cache_hash(dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form, const dt_iop_roi_t *roi)
+{
+  dt_dev_pixelpipe_t *pipe = piece->pipe;
+
+  // the modules in front of this one and the roi
+  uint64_t hash = dt_dev_pixelpipe_cache_hash(pipe->image.id, roi, pipe, g_list_index(pipe->nodes, piece));
+
+  // the input the forms are scaled to
+  const float dims[5] = { pipe->iwidth, pipe->iheight, pipe->iscale, piece->buf_in.width, piece->buf_in.height };
+  const char *str = (const char *)dims;
+  for(size_t i = 0; i < sizeof(dims); i++) hash = ((hash << 5) + hash) ^ str[i];
+
+  // and the forms
+  const int length = dt_masks_group_get_hash_buffer_length(form);
+  char *buf = malloc(length);
+  dt_masks_group_get_hash_buffer(form, buf);
+  for(int i = 0; i < length; i++) hash = ((hash << 5) + hash) ^ buf[i];
+  free(buf);
+
+  return hash;
+}
+
+static const dt_masks_cache_entry_t *_masks_cache_get(dt_dev_pixelpipe_t *pipe, const uint64_t hash)
+{
+  dt_masks_cache_t *cache = pipe->mask_cache;
+  if(!cache) return NULL;
+
+  for(GList *l = cache->entries; l; l = g_list_next(l))
+  {
+    dt_masks_cache_entry_t *e = (dt_masks_cache_entry_t *)l->data;
+    if(e->hash != hash) continue;
+    cache->entries = g_list_remove_link(cache->entries, l);
+    cache->entries = g_list_concat(l, cache->entries);
+    return e;
+  }
+  return NULL;
+}
+
+static void _masks_cache_put(dt_dev_pixelpipe_t *pipe, const uint64_t hash, const float *buffer,
+                             const int width, const int height, const int posx, const int posy)
+{
+  // a mask that would push everything else out is not worth the copy
+  const size_t size = (size_t)width * height * sizeof(float);
+  const size_t budget = _masks_cache_budget();
+  if(size > budget / 2) return;
+
+  if(!pipe->mask_cache) pipe->mask_cache = calloc(1, sizeof(dt_masks_cache_t));
+  dt_masks_cache_t *cache = pipe->mask_cache;
+  if(!cache) return;
+
+  // make room by dropping the entries that weren't used for the longest time, keep the buffer of one that fits
+  float *reuse = NULL;
+  while(cache->entries && cache->size + size > budget)
+  {
+    GList *last = g_list_last(cache->entries);
+    dt_masks_cache_entry_t *old = (dt_masks_cache_entry_t *)last->data;
+    cache->entries = g_list_delete_link(cache->entries, last);
+    cache->size -= old->size;
+    if(!reuse && old->size == size)
+    {
+      reuse = old->buffer;
+      old->buffer = NULL;
+    }
+    _masks_cache_entry_free(old);
+  }
+
+  dt_masks_cache_entry_t *e = (dt_masks_cache_entry_t *)malloc(sizeof(dt_masks_cache_entry_t));
+  if(e) e->buffer = reuse ? reuse : malloc(size);
+  if(!e || !e->buffer)
+  {
+    free(reuse);
+    free(e);
+    return;
+  }
+  memcpy(e->buffer, buffer, size);
+  e->hash = hash;
+  e->size = size;
+  e->width = width;
+  e->height = height;
+  e->posx = posx;
+  e->posy = posy;
+  cache->entries = g_list_prepend(cache->entries, e);
+  cache->size += size;
+}
+
+int dt_masks_get_mask_cached(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
+                             float **buffer, int *width, int *height, int *posx, int *posy)
+{
+  if(!_masks_cache_enabled(module, piece))
+    return dt_masks_get_mask(module, piece, form, buffer, width, height, posx, posy);
+
+  // the mask doesn't depend on any roi
+  const dt_iop_roi_t roi = { 0 };
+  const uint64_t hash = _masks_cache_hash(piece, form, &roi);
+  const dt_masks_cache_entry_t *e = _masks_cache_get(piece->pipe, hash);
+  if(e)
+  {
+    *buffer = malloc(e->size);
+    if(*buffer)
+    {
+      memcpy(*buffer, e->buffer, e->size);
+      *width = e->width;
+      *height = e->height;
+      *posx = e->posx;
+      *posy = e->posy;
+      return 1;
+    }
+  }
+
+  const int ok = dt_masks_get_mask(module, piece, form, buffer, width, height, posx, posy);
+  if(ok) _masks_cache_put(piece->pipe, hash, *buffer, *width, *height, *posx, *posy);
+  return ok;
+}
+
 int dt_masks_group_render(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, dt_masks_form_t *form,
                           float **buffer, int *roi, float scale)
 {
@@ -677,7 +840,19 @@ int dt_masks_group_render_roi(dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *p
   double start2 = dt_get_wtime();
   if(!form) return 0;
 
+  const gboolean cached = _masks_cache_enabled(module, piece);
+  const uint64_t hash = cached ? _masks_cache_hash(piece, form, roi) : 0;
+  const dt_masks_cache_entry_t *e = cached ? _masks_cache_get(piece->pipe, hash) : NULL;
+  if(e && e->size == (size_t)roi->width * roi->height * sizeof(float))
+  {
+    memcpy(buffer, e->buffer, e->size);
+    if(darktable.unmuted & DT_DEBUG_PERF)
+      dt_print(DT_DEBUG_MASKS, "[masks] render all masks took %0.04f sec (cached)\n", dt_get_wtime() - start2);
+    return 1;
+  }
+
   int ok = dt_masks_get_mask_roi(module, piece, form, roi, buffer);
+  if(ok && cached) _masks_cache_put(piece->pipe, hash, buffer, roi->width, roi->height, roi->x, roi->y);
 
   if(darktable.unmuted & DT_DEBUG_PERF)
     dt_print(DT_DEBUG_MASKS, "[masks] render all masks took %0.04f sec\n", dt_get_wtime() - start2);
@@ -1022,7 +1022,7 @@ void dt_masks_read_forms(dt_develop_t *dev)
       {
         dt_masks_point_path_t *point = (dt_masks_point_path_t *)malloc(sizeof(dt_masks_point_path_t));
         memcpy(point, ptbuf + i, sizeof(dt_masks_point_path_t));
-        form->points = g_list_append(form->points, point);
+        form->points = g_list_prepend(form->points, point);
       }
     }
     else if(form->type & DT_MASKS_GROUP)
@@ -1032,7 +1032,7 @@ void dt_masks_read_forms(dt_develop_t *dev)
       {
         dt_masks_point_group_t *point = (dt_masks_point_group_t *)malloc(sizeof(dt_masks_point_group_t));
         memcpy(point, ptbuf + i, sizeof(dt_masks_point_group_t));
-        form->points = g_list_append(form->points, point);
+        form->points = g_list_prepend(form->points, point);
       }
     }
     else if(form->type & DT_MASKS_GRADIENT)
@@ -1056,10 +1056,12 @@ void dt_masks_read_forms(dt_develop_t *dev)
       {
         dt_masks_point_brush_t *point = (dt_masks_point_brush_t *)malloc(sizeof(dt_masks_point_brush_t));
         memcpy(point, ptbuf + i, sizeof(dt_masks_point_brush_t));
-        form->points = g_list_append(form->points, point);
+        form->points = g_list_prepend(form->points, point);
       }
     }
 
+    form->points = g_list_reverse(form->points);
+
     if(form->version != dt_masks_version())
     {
       if(dt_masks_legacy_params(dev, form, form->version, dt_masks_version()))
@@ -1078,10 +1080,11 @@ void dt_masks_read_forms(dt_develop_t *dev)
     }
 
     // and we can add the form to the list
-    dev->forms = g_list_append(dev->forms, form);
+    dev->forms = g_list_prepend(dev->forms, form);
   }
 
   sqlite3_finalize(stmt);
+  dev->forms = g_list_reverse(dev->forms);
   dt_dev_masks_list_change(dev);
 }
 
@@ -22,11 +22,13 @@
 #include "common/histogram.h"
 #include "common/imageio.h"
 #include "common/opencl.h"
+#include "common/profiling.h"
 #include "control/control.h"
 #include "control/signal.h"
 #include "develop/blend.h"
 #include "develop/format.h"
 #include "develop/imageop_math.h"
+#include "develop/masks.h"
 #include "develop/pixelpipe.h"
 #include "develop/tiling.h"
 #include "gui/gtk.h"
@@ -65,9 +67,9 @@ typedef enum dt_pixelpipe_picker_source_t
 static void get_output_format(dt_iop_module_t *module, dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece,
                               dt_develop_t *dev, dt_iop_buffer_dsc_t *dsc);
 
-static char *_pipe_type_to_str(int pipe_type)
+const char *dt_dev_pixelpipe_type_to_str(int pipe_type)
 {
-  char *r;
+  const char *r;
 
   switch(pipe_type)
   {
@@ -139,7 +141,12 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   pipe->backbuf_size = size;
   if(!dt_dev_pixelpipe_cache_init(&(pipe->cache), entries, pipe->backbuf_size)) return 0;
   pipe->cache_obsolete = 0;
+  // only allocated on first use
+  memset(pipe->coarse_cache, 0, sizeof(pipe->coarse_cache));
+  memset(&pipe->prefetch_cache, 0, sizeof(pipe->prefetch_cache));
   pipe->backbuf = NULL;
+  pipe->backbuf_x = pipe->backbuf_y = 0;
+  pipe->backbuf_scale = 0.0f;
   pipe->processing = 0;
   pipe->shutdown = 0;
   pipe->opencl_error = 0;
@@ -147,6 +154,7 @@ int dt_dev_pixelpipe_init_cached(dt_dev_pixelpipe_t *pipe, size_t size, int32_t
   pipe->mask_display = DT_DEV_PIXELPIPE_DISPLAY_NONE;
   pipe->input_timestamp = 0;
   pipe->levels = IMAGEIO_RGB | IMAGEIO_INT8;
+  pipe->mask_cache = NULL;
   dt_pthread_mutex_init(&(pipe->backbuf_mutex), NULL);
   dt_pthread_mutex_init(&(pipe->busy_mutex), NULL);
   return 1;
@@ -171,6 +179,10 @@ void dt_dev_pixelpipe_cleanup(dt_dev_pixelpipe_t *pipe)
   dt_dev_pixelpipe_cleanup_nodes(pipe);
   // so now it's safe to clean up cache:
   dt_dev_pixelpipe_cache_cleanup(&(pipe->cache));
+  for(int k = 0; k < DT_DEV_PIXELPIPE_COARSE_LEVELS; k++)
+    if(pipe->coarse_cache[k].entries) dt_dev_pixelpipe_cache_cleanup(&(pipe->coarse_cache[k]));
+  if(pipe->prefetch_cache.entries) dt_dev_pixelpipe_cache_cleanup(&(pipe->prefetch_cache));
+  dt_masks_cache_cleanup(pipe);
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
   dt_pthread_mutex_destroy(&(pipe->backbuf_mutex));
   dt_pthread_mutex_destroy(&(pipe->busy_mutex));
@@ -346,6 +358,7 @@ static void get_output_format(dt_iop_module_t *module, dt_dev_pixelpipe_t *pipe,
 static void histogram_collect(dt_dev_pixelpipe_iop_t *piece, const void *pixel, const dt_iop_roi_t *roi,
                               uint32_t **histogram, uint32_t *histogram_max)
 {
+  dt_trace_span_t span = dt_trace_begin("histogram", piece->module->op);
   dt_dev_histogram_collection_params_t histogram_params = piece->histogram_params;
 
   dt_histogram_roi_t histogram_roi;
@@ -364,6 +377,8 @@ static void histogram_collect(dt_dev_pixelpipe_iop_t *piece, const void *pixel,
 
   dt_histogram_helper(&histogram_params, &piece->histogram_stats, cst, pixel, histogram);
   dt_histogram_max_helper(&piece->histogram_stats, cst, histogram, histogram_max);
+  dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(piece->pipe->type),
+               dt_iop_buffer_dsc_to_bpp(&piece->dsc_in) * roi->width * roi->height);
 }
 
 #ifdef HAVE_OPENCL
@@ -386,6 +401,8 @@ static void histogram_collect_cl(int devid, dt_dev_pixelpipe_iop_t *piece, cl_me
 
   if(!pixel) return;
 
+  // including the copy to the host, which is most of it
+  dt_trace_span_t span = dt_trace_begin("histogram", piece->module->op);
   cl_int err = dt_opencl_copy_device_to_host(devid, pixel, img, roi->width, roi->height, 4 * sizeof(float));
   if(err != CL_SUCCESS)
   {
@@ -411,6 +428,8 @@ static void histogram_collect_cl(int devid, dt_dev_pixelpipe_iop_t *piece, cl_me
 
   dt_histogram_helper(&histogram_params, &piece->histogram_stats, cst, pixel, histogram);
   dt_histogram_max_helper(&piece->histogram_stats, cst, histogram, histogram_max);
+  dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(piece->pipe->type),
+               (size_t)roi->width * roi->height * 4 * sizeof(float));
 
   if(tmpbuf) dt_free_align(tmpbuf);
 }
@@ -494,7 +513,11 @@ static void pixelpipe_picker(dt_iop_module_t *module, dt_iop_buffer_dsc_t *dsc,
   if(pixelpipe_picker_helper(module, roi, picked_color, picked_color_min, picked_color_max, picker_source, box))
     return;
 
+  dt_trace_span_t span = dt_trace_begin("picker", module->op);
   dt_color_picker_helper(dsc, pixel, roi, box, picked_color, picked_color_min, picked_color_max);
+  // modules only pick in the preview pipe
+  dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(darktable.develop->preview_pipe->type),
+               dt_iop_buffer_dsc_to_bpp(dsc) * (box[2] - box[0] + 1) * (box[3] - box[1] + 1));
 }
 
 
@@ -513,6 +536,7 @@ static void pixelpipe_picker_cl(int devid, dt_iop_module_t *module, dt_iop_buffe
   if(pixelpipe_picker_helper(module, roi, picked_color, picked_color_min, picked_color_max, picker_source, box))
     return;
 
+  dt_trace_span_t span = dt_trace_begin("picker", module->op);
   size_t origin[3];
   size_t region[3];
 
@@ -555,12 +579,189 @@ static void pixelpipe_picker_cl(int devid, dt_iop_module_t *module, dt_iop_buffe
   dt_color_picker_helper(dsc, pixel, &roi_copy, box, picked_color, picked_color_min, picked_color_max);
 
 error:
+  dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(darktable.develop->preview_pipe->type), size * bpp);
   dt_free_align(tmpbuf);
 }
 #endif
 
 
 // recursive helper for process:
+// the module stopped early because the pipe is going to start over (see dt_iop_should_abort()) or shuts down.
+// its output is incomplete, so make sure the cache line it was written to isn't picked up again.
+static int _pixelpipe_process_aborted(dt_dev_pixelpipe_t *pipe, dt_dev_pixelpipe_iop_t *piece, void *output)
+{
+  if(!dt_iop_should_abort(piece)) return 0;
+  dt_dev_pixelpipe_cache_invalidate(&(pipe->cache), output);
+  return 1;
+}
+
+// the preview pipe can start from the output of demosaic in the full pipe, which has a higher resolution than
+// mipf whenever the whole image is shown, instead of running the raw modules itself. cpu only: with opencl
+// the output might only live in device memory.
+static gboolean _early_stage_enabled(const dt_develop_t *dev)
+{
+  return dev->gui_attached && !dt_opencl_is_enabled() && dt_conf_get_bool("darkroom/ui/preview_from_full");
+}
+
+static uint64_t _early_stage_hash(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, dt_dev_pixelpipe_iop_t *piece)
+{
+  // the module hashes don't know about the image
+  const uint64_t hash = dt_dev_hash_plus(dev, pipe, 0, piece->module->priority);
+  return hash ? hash ^ ((uint64_t)pipe->image.id << 32) : 0;
+}
+
+void dt_dev_pixelpipe_early_stage_expect(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width,
+                                         int height, float scale)
+{
+  uint64_t expected = 0;
+  // the preview pipe needs all of the image, give or take the rounding of the region
+  if(width > 0 && height > 0 && x == 0 && y == 0 && width + 1 >= (int)(pipe->processed_width * scale)
+     && height + 1 >= (int)(pipe->processed_height * scale) && _early_stage_enabled(dev))
+  {
+    for(GList *nodes = pipe->nodes; nodes; nodes = g_list_next(nodes))
+    {
+      dt_dev_pixelpipe_iop_t *piece = (dt_dev_pixelpipe_iop_t *)nodes->data;
+      if(strcmp(piece->module->op, "demosaic")) continue;
+      if(piece->enabled) expected = _early_stage_hash(pipe, dev, piece);
+      break;
+    }
+  }
+  dt_pthread_mutex_lock(&dev->early_stage.lock);
+  dev->early_stage.expected = expected;
+  dt_pthread_mutex_unlock(&dev->early_stage.lock);
+}
+
+// full pipe: keep a copy of the output of demosaic if it is from a run the preview pipe was told about
+static void _early_stage_publish(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, dt_dev_pixelpipe_iop_t *piece,
+                                 const void *output, const dt_iop_buffer_dsc_t *dsc, const dt_iop_roi_t *roi)
+{
+  if(pipe != dev->pipe || strcmp(piece->module->op, "demosaic")) return;
+  if(dsc->datatype != TYPE_FLOAT || dsc->channels != 4) return;
+
+  const uint64_t hash = _early_stage_hash(pipe, dev, piece);
+  dt_pthread_mutex_lock(&dev->early_stage.lock);
+  // the coarse passes of progressive rendering come first, replace them by the full resolution
+  if(hash && hash == dev->early_stage.expected
+     && (hash != dev->early_stage.hash || roi->scale > dev->early_stage.roi.scale))
+  {
+    const size_t size = sizeof(float) * 4 * roi->width * roi->height;
+    if(size > dev->early_stage.size)
+    {
+      dt_free_align(dev->early_stage.buf);
+      dev->early_stage.buf = (float *)dt_alloc_align(64, size);
+      dev->early_stage.size = dev->early_stage.buf ? size : 0;
+    }
+    if(dev->early_stage.buf)
+    {
+      memcpy(dev->early_stage.buf, output, size);
+      dev->early_stage.hash = hash;
+      dev->early_stage.roi = *roi;
+      dev->early_stage.dsc = *dsc;
+    }
+    else
+      dev->early_stage.hash = 0;
+  }
+  dt_pthread_mutex_unlock(&dev->early_stage.lock);
+}
+
+// does the region have (in full image coordinates) the area and resolution of the wanted one?
+static gboolean _early_stage_covers(const dt_iop_roi_t *have, const dt_iop_roi_t *want)
+{
+  if(have->scale < want->scale) return FALSE;
+  // allow for a pixel of rounding in the coarser one
+  const float eps = 1.0f / want->scale;
+  return want->x / want->scale >= have->x / have->scale - eps
+         && want->y / want->scale >= have->y / have->scale - eps
+         && (want->x + want->width) / want->scale <= (have->x + have->width) / have->scale + eps
+         && (want->y + want->height) / want->scale <= (have->y + have->height) / have->scale + eps;
+}
+
+// preview pipe: fill the cache line for demosaic from what the full pipe published, waiting for it if a run of
+// the full pipe is going to. returns 1 if the output is there, 0 to process as usual and -1 if the pipe should
+// stop instead.
+static int _early_stage_take(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, dt_dev_pixelpipe_iop_t *piece,
+                             const dt_iop_roi_t *roi_out, const uint64_t hash, const size_t bufsize,
+                             void **output, dt_iop_buffer_dsc_t **out_format)
+{
+  if(pipe != dev->preview_pipe || strcmp(piece->module->op, "demosaic") || !_early_stage_enabled(dev)) return 0;
+  // a focused raw module which picks colors or draws a histogram needs to run in this pipe
+  const dt_iop_module_t *gui_module = dev->gui_module;
+  if(gui_module && gui_module->priority <= piece->module->priority
+     && (gui_module->request_color_pick != DT_REQUEST_COLORPICK_OFF
+         || (gui_module->request_histogram & DT_REQUEST_ON)))
+    return 0;
+
+  const uint64_t early_hash = _early_stage_hash(pipe, dev, piece);
+  if(!early_hash) return 0;
+
+  // the same region in full image coordinates
+  dt_iop_roi_t roi = *roi_out;
+  roi.scale /= pipe->iscale;
+
+  const int nloop = dt_conf_get_int("pixelpipe_synchronization_timeout");
+  for(int n = 0; n <= nloop; n++)
+  {
+    dt_pthread_mutex_lock(&dev->early_stage.lock);
+    if(dev->early_stage.hash == early_hash && _early_stage_covers(&dev->early_stage.roi, &roi))
+    {
+      dt_pthread_mutex_lock(&pipe->busy_mutex);
+      if(pipe->shutdown)
+      {
+        dt_pthread_mutex_unlock(&pipe->busy_mutex);
+        dt_pthread_mutex_unlock(&dev->early_stage.lock);
+        return -1;
+      }
+      (void)dt_dev_pixelpipe_cache_get(&(pipe->cache), hash, bufsize, output, out_format);
+      **out_format = pipe->dsc = piece->dsc_out = dev->early_stage.dsc;
+      dt_iop_clip_and_zoom_roi((float *)*output, dev->early_stage.buf, &roi, &dev->early_stage.roi, roi.width,
+                               dev->early_stage.roi.width);
+      dt_pthread_mutex_unlock(&pipe->busy_mutex);
+      dt_pthread_mutex_unlock(&dev->early_stage.lock);
+      return 1;
+    }
+    const int wait = early_hash == dev->early_stage.expected;
+    dt_pthread_mutex_unlock(&dev->early_stage.lock);
+    if(!wait) return 0;
+
+    dt_iop_nap(5000);
+    if(dt_iop_breakpoint(dev, pipe) || dev->preview_loading || dev->gui_leaving) return -1;
+  }
+  return 0;
+}
+
+// recursive helper for process:
+// run the module on the cpu, with tiling if its buffers don't fit into host memory
+static dt_pixelpipe_flow_t _pixelpipe_process_on_cpu(dt_dev_pixelpipe_t *pipe, dt_iop_module_t *module,
+                                                     dt_dev_pixelpipe_iop_t *piece, void *input, void *output,
+                                                     const dt_iop_roi_t *roi_in, const dt_iop_roi_t *roi_out,
+                                                     const size_t in_bpp, const size_t bpp,
+                                                     const dt_develop_tiling_t *tiling,
+                                                     dt_pixelpipe_flow_t pixelpipe_flow)
+{
+  const int use_tiling = piece->process_tiling_ready
+                         && !dt_tiling_piece_fits_host_memory(MAX(roi_in->width, roi_out->width),
+                                                              MAX(roi_in->height, roi_out->height),
+                                                              MAX(in_bpp, bpp), tiling->factor, tiling->overhead);
+
+  // with tiling, the time not spent in the nested process spans of the tiles is the tiling overhead
+  dt_trace_span_t span = dt_trace_begin(use_tiling ? "tiling" : "process", module->op);
+  if(use_tiling)
+  {
+    module->process_tiling(module, piece, input, output, roi_in, roi_out, in_bpp);
+    pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
+    pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU);
+  }
+  else
+  {
+    module->process(module, piece, input, output, roi_in, roi_out);
+    pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
+    pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
+  }
+  dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(pipe->type),
+               in_bpp * roi_in->width * roi_in->height + bpp * roi_out->width * roi_out->height);
+  return pixelpipe_flow;
+}
+
 static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, void **output,
                                         void **cl_mem_output, dt_iop_buffer_dsc_t **out_format,
                                         const dt_iop_roi_t *roi_out, GList *modules, GList *pieces, int pos)
@@ -633,6 +834,7 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     }
     dt_times_t start;
     dt_get_times(&start);
+    dt_trace_span_t span = dt_trace_begin("input", "input");
     // we're looking for the full buffer
     {
       if(roi_out->scale == 1.0 && roi_out->x == 0 && roi_out->y == 0 && pipe->iwidth == roi_out->width
@@ -675,13 +877,23 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
       // else found in cache.
     }
 
-    dt_show_times(&start, "[dev_pixelpipe]", "initing base buffer [%s]", _pipe_type_to_str(pipe->type));
+    dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(pipe->type), bufsize);
+    dt_show_times(&start, "[dev_pixelpipe]", "initing base buffer [%s]", dt_dev_pixelpipe_type_to_str(pipe->type));
     dt_pthread_mutex_unlock(&pipe->busy_mutex);
   }
   else
   {
     // 3b) recurse and obtain output array in &input
 
+    const int early_stage = _early_stage_take(pipe, dev, piece, roi_out, hash, bufsize, output, out_format);
+    if(early_stage < 0) return 1;
+    if(early_stage)
+    {
+      dt_print(DT_DEBUG_PERF, "[dev_pixelpipe] took the output of %s from the full pipe [%s]\n", module_name,
+               dt_dev_pixelpipe_type_to_str(pipe->type));
+      goto post_process_collect_info;
+    }
+
     // get region of interest which is needed in input
     dt_pthread_mutex_lock(&pipe->busy_mutex);
     if(pipe->shutdown)
@@ -740,6 +952,11 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
 
     dt_times_t start;
     dt_get_times(&start);
+    // instances of the same module are told apart by their name
+    char span_name[sizeof(module_name) + sizeof(module->multi_name) + 1];
+    snprintf(span_name, sizeof(span_name), "%s%s%s", module_name, module->multi_name[0] ? " " : "",
+             module->multi_name);
+    dt_trace_span_t module_span = dt_trace_begin("module", span_name);
 
     dt_pixelpipe_flow_t pixelpipe_flow = (PIXELPIPE_FLOW_NONE | PIXELPIPE_FLOW_HISTOGRAM_NONE);
 
@@ -939,8 +1156,12 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
           /* now call process_cl of module; module should emit meaningful messages in case of error */
           if(success_opencl)
           {
+            // kernels run asynchronously, so this is mostly the time to queue them. -d perf has their run times.
+            dt_trace_span_t span = dt_trace_begin("process", module->op);
             success_opencl
                 = module->process_cl(module, piece, cl_mem_input, *cl_mem_output, &roi_in, roi_out);
+            dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(pipe->type),
+                         in_bpp * roi_in.width * roi_in.height + bpp * roi_out->width * roi_out->height);
             pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_GPU);
             pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_CPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
           }
@@ -1078,8 +1299,11 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
           /* now call process_tiling_cl of module; module should emit meaningful messages in case of error */
           if(success_opencl)
           {
+            dt_trace_span_t span = dt_trace_begin("tiling", module->op);
             success_opencl
                 = module->process_tiling_cl(module, piece, input, *output, &roi_in, roi_out, in_bpp);
+            dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(pipe->type),
+                         in_bpp * roi_in.width * roi_in.height + bpp * roi_out->width * roi_out->height);
             pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
             pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_CPU);
           }
@@ -1282,23 +1506,10 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
           }
 
           /* process module on cpu. use tiling if needed and possible. */
-          if(piece->process_tiling_ready
-             && !dt_tiling_piece_fits_host_memory(MAX(roi_in.width, roi_out->width),
-                                                  MAX(roi_in.height, roi_out->height), MAX(in_bpp, bpp),
-                                                  tiling.factor, tiling.overhead))
-          {
-            module->process_tiling(module, piece, input, *output, &roi_in, roi_out, in_bpp);
-            pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
-            pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU);
-          }
-          else
-          {
-            module->process(module, piece, input, *output, &roi_in, roi_out);
-            pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
-            pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
-          }
+          pixelpipe_flow = _pixelpipe_process_on_cpu(pipe, module, piece, input, *output, &roi_in, roi_out, in_bpp,
+                                                     bpp, &tiling, pixelpipe_flow);
 
-          if(pipe->shutdown)
+          if(_pixelpipe_process_aborted(pipe, piece, *output))
           {
             dt_pthread_mutex_unlock(&pipe->busy_mutex);
             return 1;
@@ -1415,23 +1626,10 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
         }
 
         /* process module on cpu. use tiling if needed and possible. */
-        if(piece->process_tiling_ready
-           && !dt_tiling_piece_fits_host_memory(MAX(roi_in.width, roi_out->width),
-                                                MAX(roi_in.height, roi_out->height), MAX(in_bpp, bpp),
-                                                tiling.factor, tiling.overhead))
-        {
-          module->process_tiling(module, piece, input, *output, &roi_in, roi_out, in_bpp);
-          pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
-          pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU);
-        }
-        else
-        {
-          module->process(module, piece, input, *output, &roi_in, roi_out);
-          pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
-          pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
-        }
+        pixelpipe_flow = _pixelpipe_process_on_cpu(pipe, module, piece, input, *output, &roi_in, roi_out, in_bpp,
+                                                   bpp, &tiling, pixelpipe_flow);
 
-        if(pipe->shutdown)
+        if(_pixelpipe_process_aborted(pipe, piece, *output))
         {
           dt_pthread_mutex_unlock(&pipe->busy_mutex);
           return 1;
@@ -1513,23 +1711,10 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
       }
 
       /* process module on cpu. use tiling if needed and possible. */
-      if(piece->process_tiling_ready
-         && !dt_tiling_piece_fits_host_memory(MAX(roi_in.width, roi_out->width),
-                                              MAX(roi_in.height, roi_out->height), MAX(in_bpp, bpp),
-                                              tiling.factor, tiling.overhead))
-      {
-        module->process_tiling(module, piece, input, *output, &roi_in, roi_out, in_bpp);
-        pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
-        pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU);
-      }
-      else
-      {
-        module->process(module, piece, input, *output, &roi_in, roi_out);
-        pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
-        pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
-      }
+      pixelpipe_flow = _pixelpipe_process_on_cpu(pipe, module, piece, input, *output, &roi_in, roi_out, in_bpp,
+                                                 bpp, &tiling, pixelpipe_flow);
 
-      if(pipe->shutdown)
+      if(_pixelpipe_process_aborted(pipe, piece, *output))
       {
         dt_pthread_mutex_unlock(&pipe->busy_mutex);
         return 1;
@@ -1598,23 +1783,10 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
     }
 
     /* process module on cpu. use tiling if needed and possible. */
-    if(piece->process_tiling_ready
-       && !dt_tiling_piece_fits_host_memory(MAX(roi_in.width, roi_out->width),
-                                            MAX(roi_in.height, roi_out->height), MAX(in_bpp, bpp),
-                                            tiling.factor, tiling.overhead))
-    {
-      module->process_tiling(module, piece, input, *output, &roi_in, roi_out, in_bpp);
-      pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
-      pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU);
-    }
-    else
-    {
-      module->process(module, piece, input, *output, &roi_in, roi_out);
-      pixelpipe_flow |= (PIXELPIPE_FLOW_PROCESSED_ON_CPU);
-      pixelpipe_flow &= ~(PIXELPIPE_FLOW_PROCESSED_ON_GPU | PIXELPIPE_FLOW_PROCESSED_WITH_TILING);
-    }
+    pixelpipe_flow = _pixelpipe_process_on_cpu(pipe, module, piece, input, *output, &roi_in, roi_out, in_bpp,
+                                               bpp, &tiling, pixelpipe_flow);
 
-    if(pipe->shutdown)
+    if(_pixelpipe_process_aborted(pipe, piece, *output))
     {
       dt_pthread_mutex_unlock(&pipe->busy_mutex);
       return 1;
@@ -1659,6 +1831,9 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
                     : pixelpipe_flow & PIXELPIPE_FLOW_HISTOGRAM_ON_CPU ? "CPU" : ""));
     }
 
+    dt_trace_end(&module_span, dt_dev_pixelpipe_type_to_str(pipe->type),
+                 in_bpp * roi_in.width * roi_in.height + out_bpp * roi_out->width * roi_out->height);
+
     gchar *module_label = dt_history_item_get_name(module);
     dt_show_times(
         &start, "[dev_pixelpipe]", "processed `%s' on %s%s%s, blended on %s [%s]", module_label,
@@ -1672,7 +1847,7 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
         pixelpipe_flow & PIXELPIPE_FLOW_BLENDED_ON_GPU
             ? "GPU"
             : pixelpipe_flow & PIXELPIPE_FLOW_BLENDED_ON_CPU ? "CPU" : "",
-        _pipe_type_to_str(pipe->type));
+        dt_dev_pixelpipe_type_to_str(pipe->type));
     g_free(module_label);
     module_label = NULL;
 
@@ -1733,12 +1908,12 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
         module_label = dt_history_item_get_name(module);
         if(hasnan)
           fprintf(stderr, "[dev_pixelpipe] module `%s' outputs NaNs! [%s]\n", module_label,
-                  _pipe_type_to_str(pipe->type));
+                  dt_dev_pixelpipe_type_to_str(pipe->type));
         if(hasinf)
           fprintf(stderr, "[dev_pixelpipe] module `%s' outputs non-finite floats! [%s]\n", module_label,
-                  _pipe_type_to_str(pipe->type));
+                  dt_dev_pixelpipe_type_to_str(pipe->type));
         fprintf(stderr, "[dev_pixelpipe] module `%s' min: (%f; %f; %f) max: (%f; %f; %f) [%s]\n", module_label,
-                min[0], min[1], min[2], max[0], max[1], max[2], _pipe_type_to_str(pipe->type));
+                min[0], min[1], min[2], max[0], max[1], max[2], dt_dev_pixelpipe_type_to_str(pipe->type));
         g_free(module_label);
       }
       else if((*out_format)->datatype == TYPE_FLOAT && (*out_format)->channels == 1)
@@ -1763,12 +1938,12 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
         module_label = dt_history_item_get_name(module);
         if(hasnan)
           fprintf(stderr, "[dev_pixelpipe] module `%s' outputs NaNs! [%s]\n", module_label,
-                  _pipe_type_to_str(pipe->type));
+                  dt_dev_pixelpipe_type_to_str(pipe->type));
         if(hasinf)
           fprintf(stderr, "[dev_pixelpipe] module `%s' outputs non-finite floats! [%s]\n", module_label,
-                  _pipe_type_to_str(pipe->type));
+                  dt_dev_pixelpipe_type_to_str(pipe->type));
         fprintf(stderr, "[dev_pixelpipe] module `%s' min: (%f) max: (%f) [%s]\n", module_label, min, max,
-                _pipe_type_to_str(pipe->type));
+                dt_dev_pixelpipe_type_to_str(pipe->type));
         g_free(module_label);
       }
 
@@ -1777,6 +1952,8 @@ static int dt_dev_pixelpipe_process_rec(dt_dev_pixelpipe_t *pipe, dt_develop_t *
 
   post_process_collect_info:
 
+    _early_stage_publish(pipe, dev, piece, *output, *out_format, roi_out);
+
     dt_pthread_mutex_lock(&pipe->busy_mutex);
     if(pipe->shutdown)
     {
@@ -2201,8 +2378,11 @@ static int dt_dev_pixelpipe_process_rec_and_backcopy(dt_dev_pixelpipe_t *pipe, d
     {
       cl_int err;
 
+      const size_t bpp = dt_iop_buffer_dsc_to_bpp(*out_format);
+      dt_trace_span_t span = dt_trace_begin("copy", "backcopy");
       err = dt_opencl_copy_device_to_host(pipe->devid, *output, *cl_mem_output, roi_out->width, roi_out->height,
-                                          dt_iop_buffer_dsc_to_bpp(*out_format));
+                                          bpp);
+      dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(pipe->type), bpp * roi_out->width * roi_out->height);
       dt_opencl_release_mem_object(*cl_mem_output);
       *cl_mem_output = NULL;
 
@@ -2234,7 +2414,7 @@ int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x,
   pipe->devid = (pipe->opencl_enabled) ? dt_opencl_lock_device(pipe->type)
                                        : -1; // try to get/lock opencl resource
 
-  dt_print(DT_DEBUG_OPENCL, "[pixelpipe_process] [%s] using device %d\n", _pipe_type_to_str(pipe->type),
+  dt_print(DT_DEBUG_OPENCL, "[pixelpipe_process] [%s] using device %d\n", dt_dev_pixelpipe_type_to_str(pipe->type),
            pipe->devid);
 
   if(darktable.unmuted & DT_DEBUG_MEMORY)
@@ -2271,8 +2451,11 @@ restart:
   dt_iop_buffer_dsc_t *out_format = &_out_format;
 
   // run pixelpipe recursively and get error status
+  dt_trace_span_t span = dt_trace_begin("pipe", dt_dev_pixelpipe_type_to_str(pipe->type));
   int err = dt_dev_pixelpipe_process_rec_and_backcopy(pipe, dev, &buf, &cl_mem_out, &out_format, &roi, modules,
                                                       pieces, pos);
+  dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(pipe->type),
+               dt_iop_buffer_dsc_to_bpp(out_format) * roi.width * roi.height);
 
   // get status summary of opencl queue by checking the eventlist
   int oclerr = (pipe->devid >= 0) ? (dt_opencl_events_flush(pipe->devid, 1) != 0) : 0;
@@ -2308,7 +2491,7 @@ restart:
     dt_dev_pixelpipe_flush_caches(pipe);
     dt_dev_pixelpipe_change(pipe, dev);
     dt_print(DT_DEBUG_OPENCL, "[pixelpipe_process] [%s] falling back to cpu path\n",
-             _pipe_type_to_str(pipe->type));
+             dt_dev_pixelpipe_type_to_str(pipe->type));
     goto restart; // try again (this time without opencl)
   }
 
@@ -2331,6 +2514,9 @@ restart:
   pipe->backbuf = buf;
   pipe->backbuf_width = width;
   pipe->backbuf_height = height;
+  pipe->backbuf_x = x;
+  pipe->backbuf_y = y;
+  pipe->backbuf_scale = scale;
   dt_pthread_mutex_unlock(&pipe->backbuf_mutex);
 
   // printf("pixelpipe homebrew process end\n");
@@ -2338,6 +2524,55 @@ restart:
   return 0;
 }
 
+// runs the pipe on one of the extra caches instead of the one of the full resolution view
+static int _pixelpipe_process_in_cache(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, dt_dev_pixelpipe_cache_t *other,
+                                       int x, int y, int width, int height, float scale)
+{
+  // the run only flushes the cache it works on, the others have to go as well
+  if(pipe->cache_obsolete)
+  {
+    dt_dev_pixelpipe_cache_flush(&(pipe->cache));
+    for(int k = 0; k < DT_DEV_PIXELPIPE_COARSE_LEVELS; k++)
+      if(pipe->coarse_cache[k].entries) dt_dev_pixelpipe_cache_flush(&(pipe->coarse_cache[k]));
+    if(pipe->prefetch_cache.entries) dt_dev_pixelpipe_cache_flush(&(pipe->prefetch_cache));
+  }
+
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  const dt_dev_pixelpipe_cache_t cache = pipe->cache;
+  pipe->cache = *other;
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+
+  const int ret = dt_dev_pixelpipe_process(pipe, dev, x, y, width, height, scale);
+
+  // the backbuf points into the other cache now, which is left alone until it is used for the next run
+  dt_pthread_mutex_lock(&pipe->busy_mutex);
+  *other = pipe->cache;
+  pipe->cache = cache;
+  dt_pthread_mutex_unlock(&pipe->busy_mutex);
+  return ret;
+}
+
+int dt_dev_pixelpipe_process_coarse(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width,
+                                    int height, float scale, int level)
+{
+  if(level < 1 || level > DT_DEV_PIXELPIPE_COARSE_LEVELS) return 1;
+  dt_dev_pixelpipe_cache_t *coarse = &(pipe->coarse_cache[level - 1]);
+
+  // buffers are small at these scales. a few lines are enough to keep the pipe going and to reuse the
+  // output of unchanged modules from the last pass at this level.
+  if(!coarse->entries && !dt_dev_pixelpipe_cache_init(coarse, 3, 0)) return 1;
+
+  const float f = 1.0f / (1 << level);
+  return _pixelpipe_process_in_cache(pipe, dev, coarse, x * f, y * f, width * f, height * f, scale * f);
+}
+
+int dt_dev_pixelpipe_process_prefetch(dt_dev_pixelpipe_t *pipe, dt_develop_t *dev, int x, int y, int width,
+                                      int height, float scale)
+{
+  if(!pipe->prefetch_cache.entries && !dt_dev_pixelpipe_cache_init(&(pipe->prefetch_cache), 3, 0)) return 0;
+  return _pixelpipe_process_in_cache(pipe, dev, &(pipe->prefetch_cache), x, y, width, height, scale);
+}
+
 void dt_dev_pixelpipe_flush_caches(dt_dev_pixelpipe_t *pipe)
 {
   dt_dev_pixelpipe_cache_flush(&pipe->cache);
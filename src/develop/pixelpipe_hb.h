@@ -70,6 +70,9 @@ typedef enum dt_dev_pixelpipe_change_t
   DT_DEV_PIPE_ZOOMED = 1 << 3 // zoom event, preview pipe does not need changes
 } dt_dev_pixelpipe_change_t;
 
+// number of coarse passes (at 1/2, 1/4, ...) progressive rendering can do before the full resolution one
+#define DT_DEV_PIXELPIPE_COARSE_LEVELS 2
+
 /**
  * this encapsulates the pixelpipe.
  * a develop module will need several of these:
@@ -82,6 +85,10 @@ typedef struct dt_dev_pixelpipe_t
   dt_dev_pixelpipe_cache_t cache;
   // set to non-zero in order to obsolete old cache entries on next pixelpipe run
   int cache_obsolete;
+  // small caches for the coarse passes of progressive rendering, see dt_dev_pixelpipe_process_coarse()
+  dt_dev_pixelpipe_cache_t coarse_cache[DT_DEV_PIXELPIPE_COARSE_LEVELS];
+  // cache for rendering a margin around the view, see dt_dev_pixelpipe_process_prefetch()
+  dt_dev_pixelpipe_cache_t prefetch_cache;
   // input buffer
   float *input;
   // width and height of input buffer
@@ -103,6 +110,9 @@ typedef struct dt_dev_pixelpipe_t
   uint8_t *backbuf;
   size_t backbuf_size;
   int backbuf_width, backbuf_height;
+  // region of interest the backbuf was rendered for
+  int backbuf_x, backbuf_y;
+  float backbuf_scale;
   uint64_t backbuf_hash;
   dt_pthread_mutex_t backbuf_mutex, busy_mutex;
   // working?
@@ -126,6 +136,8 @@ typedef struct dt_dev_pixelpipe_t
   int devid;
   // image struct as it was when the pixelpipe was initialized. copied to avoid race conditions.
   dt_image_t image;
+  // rasterized drawn masks, see dt_masks_group_render_roi()
+  struct dt_masks_cache_t *mask_cache;
 } dt_dev_pixelpipe_t;
 
 struct dt_develop_t;
@@ -170,9 +182,25 @@ void dt_dev_pixelpipe_synch_all(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *d
 // adjust output node according to history stack (history pop event)
 void dt_dev_pixelpipe_synch_top(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev);
 
+// name of the pipe type for debug output and traces
+const char *dt_dev_pixelpipe_type_to_str(int pipe_type);
 // process region of interest of pixels. returns 1 if pipe was altered during processing.
 int dt_dev_pixelpipe_process(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y, int width,
                              int height, float scale);
+// process the region of interest at 1/2^level of its size (level 1..DT_DEV_PIXELPIPE_COARSE_LEVELS). uses a
+// separate cache per level, so a quick low resolution pass neither evicts the cache lines the next full
+// resolution pass depends on nor overwrites the backbuf of the coarser pass before it.
+int dt_dev_pixelpipe_process_coarse(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y,
+                                    int width, int height, float scale, int level);
+// process a region of interest which is larger than what is going to be shown right away, in a separate cache
+// as well. returns 0 without touching the backbuf if there is no memory for it.
+int dt_dev_pixelpipe_process_prefetch(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y,
+                                      int width, int height, float scale);
+// tell the preview pipe whether the runs of the full pipe on this region are going to compute all it needs up
+// to demosaic, so it waits for that instead of processing the raw modules itself. a zero sized region means
+// none are coming.
+void dt_dev_pixelpipe_early_stage_expect(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y,
+                                         int width, int height, float scale);
 // convenience method that does not gamma-compress the image.
 int dt_dev_pixelpipe_process_no_gamma(dt_dev_pixelpipe_t *pipe, struct dt_develop_t *dev, int x, int y,
                                       int width, int height, float scale);
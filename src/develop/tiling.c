@@ -19,6 +19,7 @@
 
 #include "develop/tiling.h"
 #include "common/opencl.h"
+#include "common/profiling.h"
 #include "control/control.h"
 #include "develop/blend.h"
 #include "develop/pixelpipe.h"
@@ -726,6 +727,9 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
   for(size_t tx = 0; tx < tiles_x; tx++)
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
+      // the pipe starts over anyway, don't bother with the remaining tiles
+      if(dt_iop_should_abort(piece)) goto cancel;
+
       piece->pipe->tiling = 1;
 
       size_t wd = tx * tile_wd + width > roi_in->width ? roi_in->width - tx * tile_wd : width;
@@ -761,7 +765,10 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
       for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
 
       /* call process() of module */
+      dt_trace_span_t span = dt_trace_begin("process", self->op);
       self->process(self, piece, input, output, &iroi, &oroi);
+      dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(piece->pipe->type),
+                   (size_t)iroi.width * iroi.height * in_bpp + (size_t)oroi.width * oroi.height * out_bpp);
 
       /* aggregate resulting processed_maximum */
       /* TODO: check if there really can be differences between tiles and take
@@ -803,6 +810,7 @@ static void _default_process_tiling_ptp(struct dt_iop_module_t *self, struct dt_
   /* copy back final processed_maximum */
   for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
 
+cancel:
   if(input != NULL) dt_free_align(input);
   if(output != NULL) dt_free_align(output);
   piece->pipe->tiling = 0;
@@ -984,6 +992,9 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
   for(size_t tx = 0; tx < tiles_x; tx++)
     for(size_t ty = 0; ty < tiles_y; ty++)
     {
+      // the pipe starts over anyway, don't bother with the remaining tiles
+      if(dt_iop_should_abort(piece)) goto cancel;
+
       piece->pipe->tiling = 1;
 
       /* the output dimensions of the good part of this specific tile */
@@ -1104,7 +1115,11 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
       for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_saved[k];
 
       /* call process() of module */
+      dt_trace_span_t span = dt_trace_begin("process", self->op);
       self->process(self, piece, input, output, &iroi_full, &oroi_full);
+      dt_trace_end(&span, dt_dev_pixelpipe_type_to_str(piece->pipe->type),
+                   (size_t)iroi_full.width * iroi_full.height * in_bpp
+                       + (size_t)oroi_full.width * oroi_full.height * out_bpp);
 
       /* aggregate resulting processed_maximum */
       /* TODO: check if there really can be differences between tiles and take
@@ -1138,6 +1153,7 @@ static void _default_process_tiling_roi(struct dt_iop_module_t *self, struct dt_
   /* copy back final processed_maximum */
   for(int k = 0; k < 4; k++) piece->pipe->dsc.processed_maximum[k] = processed_maximum_new[k];
 
+cancel:
   if(input != NULL) dt_free_align(input);
   if(output != NULL) dt_free_align(output);
   piece->pipe->tiling = 0;
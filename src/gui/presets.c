@@ -72,11 +72,79 @@ typedef struct dt_gui_presets_edit_dialog_t
 
 // this is also called for non-gui applications linking to libdarktable!
 // so beware, don't use any darktable.gui stuff here .. (or change this behaviour in darktable.c)
+// the built-in presets of a module only change with its version, the build and the language of the names.
+// data.db_info remembers for which of those they were written last time, as 'presets/<operation>' keys.
+static gchar *_presets_stamp_prefix()
+{
+  return g_strdup_printf("%s %s ", darktable_package_version, g_get_language_names()[0]);
+}
+
+static gchar *_presets_stamp(const int32_t version)
+{
+  gchar *prefix = _presets_stamp_prefix();
+  gchar *stamp = g_strdup_printf("%s%d", prefix, version);
+  g_free(prefix);
+  return stamp;
+}
+
 void dt_gui_presets_init()
 {
-  // remove auto generated presets from plugins, not the user included ones.
-  DT_DEBUG_SQLITE3_EXEC(dt_database_get(darktable.db), "DELETE FROM data.presets WHERE writeprotect = 1", NULL,
-                        NULL, NULL);
+  // remove auto generated presets from plugins, not the user included ones. the ones written by this build
+  // for the current language are kept, their modules skip writing them again.
+  sqlite3_stmt *stmt;
+  gchar *prefix = _presets_stamp_prefix();
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "DELETE FROM data.presets WHERE writeprotect = 1 AND 'presets/' || operation NOT IN "
+                              "(SELECT key FROM data.db_info WHERE SUBSTR(value, 1, LENGTH(?1)) = ?1)",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, prefix, -1, SQLITE_TRANSIENT);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  g_free(prefix);
+}
+
+gboolean dt_gui_presets_begin_builtin(const char *operation, const int32_t version)
+{
+  sqlite3_stmt *stmt;
+  gchar *key = g_strdup_printf("presets/%s", operation);
+  gchar *stamp = _presets_stamp(version);
+  gboolean up_to_date = FALSE;
+
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), "SELECT value FROM data.db_info WHERE key = ?1",
+                              -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, key, -1, SQLITE_TRANSIENT);
+  if(sqlite3_step(stmt) == SQLITE_ROW) up_to_date = !g_strcmp0((const char *)sqlite3_column_text(stmt, 0), stamp);
+  sqlite3_finalize(stmt);
+
+  if(!up_to_date)
+  {
+    // the module writes all of them again, drop the outdated ones first
+    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                                "DELETE FROM data.presets WHERE operation = ?1 AND writeprotect = 1", -1, &stmt,
+                                NULL);
+    DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, operation, -1, SQLITE_TRANSIENT);
+    sqlite3_step(stmt);
+    sqlite3_finalize(stmt);
+  }
+
+  g_free(stamp);
+  g_free(key);
+  return !up_to_date;
+}
+
+void dt_gui_presets_end_builtin(const char *operation, const int32_t version)
+{
+  sqlite3_stmt *stmt;
+  gchar *key = g_strdup_printf("presets/%s", operation);
+  gchar *stamp = _presets_stamp(version);
+  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
+                              "INSERT OR REPLACE INTO data.db_info (key, value) VALUES (?1, ?2)", -1, &stmt, NULL);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, key, -1, SQLITE_TRANSIENT);
+  DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 2, stamp, -1, SQLITE_TRANSIENT);
+  sqlite3_step(stmt);
+  sqlite3_finalize(stmt);
+  g_free(stamp);
+  g_free(key);
 }
 
 void dt_gui_presets_add_generic(const char *name, dt_dev_operation_t op, const int32_t version,
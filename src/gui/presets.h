@@ -11,6 +11,12 @@ typedef enum dt_gui_presets_format_flag_t
 /** create a db table with presets for all operations. */
 void dt_gui_presets_init();
 
+/** returns TRUE if the built-in presets of operation have to be written, after removing the old ones. they
+ * are kept from the last start when neither the module version, the build nor the language changed. */
+gboolean dt_gui_presets_begin_builtin(const char *operation, const int32_t version);
+/** remember that the built-in presets of operation are up to date. */
+void dt_gui_presets_end_builtin(const char *operation, const int32_t version);
+
 /** add or replace a generic (i.e. non-exif specific) preset for this operation. */
 void dt_gui_presets_add_generic(const char *name, dt_dev_operation_t op, const int32_t version,
                                 const void *params, const int32_t params_size, const int32_t enabled);
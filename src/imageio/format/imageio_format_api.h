@@ -73,9 +73,11 @@ int dimension(struct dt_imageio_module_format_t *self, struct dt_imageio_module_
 // writing functions:
 /* bits per pixel and color channel we want to write: 8: char x3, 16: uint16_t x3, 32: float x3. */
 int bpp(struct dt_imageio_module_data_t *data);
-/* write to file, with exif if not NULL, and icc profile if supported. */
+/* write to file, with exif if not NULL, and icc profile if supported. formats flagged with
+   FORMAT_FLAGS_SUPPORT_XMP get the xmp packet to embed (or NULL), and fall back to
+   dt_exif_write_metadata() for whatever they can't write while encoding. */
 int write_image(struct dt_imageio_module_data_t *data, const char *filename, const void *in, void *exif,
-                int exif_len, int imgid, int num, int total);
+                int exif_len, const char *xmp, int imgid, int num, int total);
 /* flag that describes the available precision/levels of output format. mainly used for dithering. */
 int levels(struct dt_imageio_module_data_t *data);
 
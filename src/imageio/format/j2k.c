@@ -322,7 +322,7 @@ static void cinema_setup_encoder(opj_cparameters_t *parameters, opj_image_t *ima
 }
 
 int write_image(dt_imageio_module_data_t *j2k_tmp, const char *filename, const void *in_tmp, void *exif,
-                int exif_len, int imgid, int num, int total)
+                int exif_len, const char *xmp, int imgid, int num, int total)
 {
   const float *in = (const float *)in_tmp;
   dt_imageio_j2k_t *j2k = (dt_imageio_j2k_t *)j2k_tmp;
@@ -502,8 +502,8 @@ int write_image(dt_imageio_module_data_t *j2k_tmp, const char *filename, const v
   opj_stream_destroy(cstream);
   opj_destroy_codec(ccodec);
 
-  /* add exif data blob. seems to not work for j2k files :( */
-  if(exif && j2k->format == JP2_CFMT) rc = dt_exif_write_blob(exif, exif_len, filename, 1);
+  /* add exif data blob and xmp in one go, openjpeg can't embed them. seems to not work for j2k files :( */
+  if((exif || xmp) && j2k->format == JP2_CFMT) rc = dt_exif_write_metadata(exif, exif_len, xmp, filename, 1);
 
   /* free image data */
   opj_image_destroy(image);
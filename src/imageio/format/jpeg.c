@@ -32,6 +32,7 @@
 #include <setjmp.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 // this fixes a rather annoying, long time bug in libjpeg :(
 #undef HAVE_STDLIB_H
 #undef HAVE_STDDEF_H
@@ -313,8 +314,12 @@ read_icc_profile (j_decompress_ptr cinfo,
 #undef MAX_SEQ_NO
 
 
+#define EXIF_MARKER (JPEG_APP0 + 1)                  /* JPEG marker code for Exif and XMP */
+#define XMP_NAMESPACE "http://ns.adobe.com/xap/1.0/" /* written with its '\0', precedes the XMP packet */
+#define MAX_BYTES_IN_MARKER 65533                    /* maximum data len of a JPEG marker */
+
 int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const void *in_tmp, void *exif,
-                int exif_len, int imgid, int num, int total)
+                int exif_len, const char *xmp, int imgid, int num, int total)
 {
   dt_imageio_jpeg_t *jpg = (dt_imageio_jpeg_t *)jpg_tmp;
   const uint8_t *in = (const uint8_t *)in_tmp;
@@ -367,6 +372,20 @@ int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const v
 
   jpeg_start_compress(&(jpg->cinfo), TRUE);
 
+  // metadata goes right behind the jfif header, app1 segments are limited to 64k though. whatever doesn't fit
+  // is merged into the file by exiv2 afterwards.
+  const gboolean exif_embedded = exif && exif_len > 6 && exif_len <= MAX_BYTES_IN_MARKER;
+  if(exif_embedded) jpeg_write_marker(&(jpg->cinfo), EXIF_MARKER, (const JOCTET *)exif, exif_len);
+
+  const size_t xmp_len = xmp ? strlen(xmp) : 0;
+  const gboolean xmp_embedded = xmp && sizeof(XMP_NAMESPACE) + xmp_len <= MAX_BYTES_IN_MARKER;
+  if(xmp_embedded)
+  {
+    jpeg_write_m_header(&(jpg->cinfo), EXIF_MARKER, sizeof(XMP_NAMESPACE) + xmp_len);
+    for(size_t k = 0; k < sizeof(XMP_NAMESPACE); k++) jpeg_write_m_byte(&(jpg->cinfo), XMP_NAMESPACE[k]);
+    for(size_t k = 0; k < xmp_len; k++) jpeg_write_m_byte(&(jpg->cinfo), xmp[k]);
+  }
+
   if(imgid > 0)
   {
     cmsHPROFILE out_profile = dt_colorspaces_get_output_profile(imgid)->profile;
@@ -397,10 +416,14 @@ int write_image(dt_imageio_module_data_t *jpg_tmp, const char *filename, const v
   jpeg_destroy_compress(&(jpg->cinfo));
   fclose(f);
 
-  dt_exif_write_blob(exif, exif_len, filename, 1);
+  if((exif && !exif_embedded) || (xmp && !xmp_embedded))
+    dt_exif_write_metadata(exif_embedded ? NULL : exif, exif_len, xmp_embedded ? NULL : xmp, filename, 1);
 
   return 0;
 }
+#undef EXIF_MARKER
+#undef XMP_NAMESPACE
+#undef MAX_BYTES_IN_MARKER
 
 static int __attribute__((__unused__)) read_header(const char *filename, dt_imageio_jpeg_t *jpg)
 {
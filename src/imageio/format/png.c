@@ -26,11 +26,13 @@
 #include <png.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <zlib.h>
 
 #include "bauhaus/bauhaus.h"
 #include "common/colorspaces.h"
 #include "common/darktable.h"
+#include "common/exif.h"
 #include "common/imageio.h"
 #include "common/imageio_module.h"
 #include "control/conf.h"
@@ -122,8 +124,226 @@ static void PNGwriteRawProfile(png_struct *ping, png_info *ping_info, char *prof
   png_free(ping, text);
 }
 
+#ifdef PNG_iTXt_SUPPORTED
+// embed the xmp packet the way exiv2 and adobe do it: uncompressed international text
+static void _write_xmp_packet(png_struct *ping, png_info *ping_info, const char *xmp)
+{
+  png_text text;
+  memset(&text, 0, sizeof(text));
+  text.compression = PNG_ITXT_COMPRESSION_NONE;
+  text.key = (png_charp) "XML:com.adobe.xmp";
+  text.text = (png_charp)xmp;
+  text.itxt_length = strlen(xmp);
+  png_set_text(ping, ping_info, &text, 1);
+}
+#endif
+
+// input bytes per deflate block. blocks are compressed independently, primed with the data before them.
+#define PNG_BLOCK_SIZE (128 * 1024)
+#define PNG_WINDOW_SIZE 32768
+
+// drop alpha and convert a row to what png wants: rgb, 16 bit samples most significant byte first
+static void _pack_row(const dt_imageio_png_t *p, const void *ivoid, const int y, uint8_t *out)
+{
+  if(p->bpp > 8)
+  {
+    const uint16_t *in = (const uint16_t *)ivoid + (size_t)4 * y * p->width;
+    for(int x = 0; x < p->width; x++, in += 4)
+      for(int c = 0; c < 3; c++)
+      {
+        *out++ = in[c] >> 8;
+        *out++ = in[c] & 0xff;
+      }
+  }
+  else
+  {
+    const uint8_t *in = (const uint8_t *)ivoid + (size_t)4 * y * p->width;
+    for(int x = 0; x < p->width; x++, in += 4, out += 3) memcpy(out, in, 3);
+  }
+}
+
+static inline int _paeth(const int a, const int b, const int c)
+{
+  const int pa = abs(b - c), pb = abs(a - c), pc = abs(a + b - 2 * c);
+  if(pa <= pb && pa <= pc) return a;
+  if(pb <= pc) return b;
+  return c;
+}
+
+static inline uint8_t _filter_byte(const int type, const uint8_t *row, const uint8_t *prev, const size_t i,
+                                   const size_t bpp)
+{
+  const int a = i >= bpp ? row[i - bpp] : 0;
+  const int b = prev[i];
+  const int c = i >= bpp ? prev[i - bpp] : 0;
+  switch(type)
+  {
+    case 1: return row[i] - a;
+    case 2: return row[i] - b;
+    case 3: return row[i] - ((a + b) >> 1);
+    case 4: return row[i] - _paeth(a, b, c);
+    default: return row[i];
+  }
+}
+
+// filter one row with whatever filter gives the smallest sum of absolute differences, like libpng does.
+// out gets the filter type byte followed by the filtered row.
+static void _filter_row(uint8_t *out, const uint8_t *row, const uint8_t *prev, const size_t rowbytes,
+                        const size_t bpp)
+{
+  int best = 0;
+  uint64_t best_sum = UINT64_MAX;
+  for(int type = 0; type < 5; type++)
+  {
+    uint64_t sum = 0;
+    for(size_t i = 0; i < rowbytes && sum < best_sum; i++) sum += abs((int8_t)_filter_byte(type, row, prev, i, bpp));
+    if(sum < best_sum)
+    {
+      best_sum = sum;
+      best = type;
+    }
+  }
+  out[0] = best;
+  for(size_t i = 0; i < rowbytes; i++) out[i + 1] = _filter_byte(best, row, prev, i, bpp);
+}
+
+static int _deflate_block(const uint8_t *in, const size_t len, const size_t dict_len, const int level,
+                          const int last, uint8_t *out, size_t *out_len)
+{
+  z_stream z = { 0 };
+  if(deflateInit2(&z, level, Z_DEFLATED, -15, 8, Z_DEFAULT_STRATEGY) != Z_OK) return 1;
+  int res = 0;
+  if(dict_len > 0 && deflateSetDictionary(&z, in - dict_len, dict_len) != Z_OK) res = 1;
+  z.next_in = (Bytef *)in;
+  z.avail_in = len;
+  z.next_out = out;
+  z.avail_out = *out_len;
+  // byte align all but the last block with an empty stored block so they can simply be concatenated
+  const int ret = deflate(&z, last ? Z_FINISH : Z_SYNC_FLUSH);
+  if(ret != (last ? Z_STREAM_END : Z_OK) || z.avail_in != 0 || z.avail_out == 0) res = 1;
+  *out_len -= z.avail_out;
+  deflateEnd(&z);
+  return res;
+}
+
+/* write the image data as one zlib stream, made of blocks that are filtered and deflated in parallel.
+ * the stream is emitted in groups of a few blocks per thread, one IDAT chunk per group. */
+static int _write_idat_parallel(png_structp png_ptr, const dt_imageio_png_t *p, const void *ivoid,
+                                const int threads)
+{
+  const size_t bpp = 3 * p->bpp / 8;
+  const size_t rowbytes = bpp * p->width;
+  const size_t filtered_row = rowbytes + 1;
+  const int rows_per_block = MAX(1, PNG_BLOCK_SIZE / filtered_row);
+  const int blocks_per_group = 2 * threads;
+  const int rows_per_group = rows_per_block * blocks_per_group;
+  const size_t block_cap = compressBound(rows_per_block * filtered_row) + 64;
+
+  // the filtered rows of a group, preceded by the last window of the group before
+  uint8_t *filtered = malloc(PNG_WINDOW_SIZE + rows_per_group * filtered_row);
+  uint8_t *scratch = malloc(2 * rowbytes * threads);
+  uint8_t *blocks = malloc(block_cap * blocks_per_group);
+  size_t *block_len = malloc(sizeof(size_t) * blocks_per_group);
+  uLong *block_adler = malloc(sizeof(uLong) * blocks_per_group);
+  int res = 0;
+
+  if(!filtered || !scratch || !blocks || !block_len || !block_adler)
+  {
+    res = 1;
+    goto end;
+  }
+
+  // zlib header as deflate would have written it for this level
+  const int level_flags = p->compression < 2 ? 0 : p->compression < 6 ? 1 : p->compression == 6 ? 2 : 3;
+  unsigned int header = (0x78 << 8) | (level_flags << 6);
+  header += 31 - (header % 31);
+  const uint8_t zlib_header[2] = { header >> 8, header & 0xff };
+
+  uint8_t *data = filtered + PNG_WINDOW_SIZE;
+  size_t window = 0;
+  uLong adler = adler32(0L, Z_NULL, 0);
+
+  for(int y0 = 0; y0 < p->height; y0 += rows_per_group)
+  {
+    const int rows = MIN(rows_per_group, p->height - y0);
+    const int nblocks = (rows + rows_per_block - 1) / rows_per_block;
+    const int last_group = y0 + rows == p->height;
+    int failed = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(static) default(none) num_threads(threads) \
+    firstprivate(y0, rows, rowbytes, filtered_row, bpp) shared(p, ivoid, data, scratch)
+#endif
+    for(int r = 0; r < rows; r++)
+    {
+      uint8_t *row = scratch + 2 * rowbytes * dt_get_thread_num();
+      uint8_t *prev = row + rowbytes;
+      _pack_row(p, ivoid, y0 + r, row);
+      if(y0 + r > 0)
+        _pack_row(p, ivoid, y0 + r - 1, prev);
+      else
+        memset(prev, 0, rowbytes);
+      _filter_row(data + r * filtered_row, row, prev, rowbytes, bpp);
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) default(none) num_threads(threads) \
+    firstprivate(rows, nblocks, rows_per_block, filtered_row, block_cap, window, last_group) \
+    shared(p, data, blocks, block_len, block_adler) reduction(| : failed)
+#endif
+    for(int b = 0; b < nblocks; b++)
+    {
+      const uint8_t *in = data + b * rows_per_block * filtered_row;
+      const size_t len = MIN(rows_per_block, rows - b * rows_per_block) * filtered_row;
+      const size_t dict_len = MIN(PNG_WINDOW_SIZE, (size_t)(in - data) + window);
+      block_len[b] = block_cap;
+      failed |= _deflate_block(in, len, dict_len, p->compression, last_group && b == nblocks - 1,
+                               blocks + b * block_cap, &block_len[b]);
+      block_adler[b] = adler32(adler32(0L, Z_NULL, 0), in, len);
+    }
+
+    if(failed)
+    {
+      res = 1;
+      goto end;
+    }
+
+    size_t chunk_len = y0 == 0 ? sizeof(zlib_header) : 0;
+    for(int b = 0; b < nblocks; b++)
+    {
+      chunk_len += block_len[b];
+      const size_t len = MIN(rows_per_block, rows - b * rows_per_block) * filtered_row;
+      adler = adler32_combine(adler, block_adler[b], len);
+    }
+    if(last_group) chunk_len += 4;
+
+    png_write_chunk_start(png_ptr, (png_bytep) "IDAT", chunk_len);
+    if(y0 == 0) png_write_chunk_data(png_ptr, zlib_header, sizeof(zlib_header));
+    for(int b = 0; b < nblocks; b++) png_write_chunk_data(png_ptr, blocks + b * block_cap, block_len[b]);
+    if(last_group)
+    {
+      const uint8_t trailer[4] = { adler >> 24, (adler >> 16) & 0xff, (adler >> 8) & 0xff, adler & 0xff };
+      png_write_chunk_data(png_ptr, trailer, sizeof(trailer));
+    }
+    png_write_chunk_end(png_ptr);
+
+    // keep the end of this group around as dictionary for the first block of the next one
+    const size_t tail = MIN(PNG_WINDOW_SIZE, rows * filtered_row + window);
+    memmove(data - tail, data + rows * filtered_row - tail, tail);
+    window = tail;
+  }
+
+end:
+  free(filtered);
+  free(scratch);
+  free(blocks);
+  free(block_len);
+  free(block_adler);
+  return res;
+}
+
 int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const void *ivoid, void *exif, int exif_len,
-                int imgid, int num, int total)
+                const char *xmp, int imgid, int num, int total)
 {
   dt_imageio_png_t *p = (dt_imageio_png_t *)p_tmp;
   const int width = p->width, height = p->height;
@@ -157,12 +377,7 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
 
   png_init_io(png_ptr, f);
 
-  png_set_compression_level(png_ptr, p->compression);
-  png_set_compression_mem_level(png_ptr, 8);
-  png_set_compression_strategy(png_ptr, Z_DEFAULT_STRATEGY);
-  png_set_compression_window_bits(png_ptr, 15);
-  png_set_compression_method(png_ptr, 8);
-  png_set_compression_buffer_size(png_ptr, 8192);
+  // no png_set_compression_*(): libpng's zlib stream is never used, the image data is deflated by us
 
   png_set_IHDR(png_ptr, info_ptr, width, height, p->bpp, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
                PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
@@ -196,35 +411,36 @@ int write_image(dt_imageio_module_data_t *p_tmp, const char *filename, const voi
   // write exif data
   PNGwriteRawProfile(png_ptr, info_ptr, "exif", exif, exif_len);
 
-  png_write_info(png_ptr, info_ptr);
-
-  /*
-   * Get rid of filler (OR ALPHA) bytes, pack XRGB/RGBX/ARGB/RGBA into
-   * RGB (4 channels -> 3 channels). The second parameter is not used.
-   */
-  png_set_filler(png_ptr, 0, PNG_FILLER_AFTER);
+#ifdef PNG_iTXt_SUPPORTED
+  // and the xmp packet, so that the file doesn't have to be rewritten for it
+  if(xmp) _write_xmp_packet(png_ptr, info_ptr, xmp);
+#endif
 
-  png_bytep *row_pointers = malloc((size_t)height * sizeof(png_bytep));
+  png_write_info(png_ptr, info_ptr);
 
-  if(p->bpp > 8)
-  {
-    /* swap bytes of 16 bit files to most significant bit first */
-    png_set_swap(png_ptr);
+  const double start = dt_get_wtime();
+  const int threads = dt_imageio_get_encode_threads();
 
-    for(unsigned i = 0; i < height; i++) row_pointers[i] = (png_bytep)((uint16_t *)ivoid + (size_t)4 * i * width);
-  }
-  else
+  // the pixel data is filtered and deflated by us, so all that's left to libpng are the chunks around it.
+  // everything else ended up in front of the image data already, so we are done after IEND.
+  if(_write_idat_parallel(png_ptr, p, ivoid, threads))
   {
-    for(unsigned i = 0; i < height; i++) row_pointers[i] = (uint8_t *)ivoid + (size_t)4 * i * width;
+    fclose(f);
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+    return 1;
   }
+  png_write_chunk(png_ptr, (png_bytep) "IEND", NULL, 0);
 
-  png_write_image(png_ptr, row_pointers);
-
-  free(row_pointers);
+  dt_print(DT_DEBUG_PERF, "[png] encoded %dx%d at %d bit in %.3f secs (%.1f MPix/s, %d threads)\n", width, height,
+           p->bpp, dt_get_wtime() - start, width * (double)height / 1e6 / MAX(dt_get_wtime() - start, 1e-6),
+           threads);
 
-  png_write_end(png_ptr, info_ptr);
   png_destroy_write_struct(&png_ptr, &info_ptr);
   fclose(f);
+
+#ifndef PNG_iTXt_SUPPORTED
+  if(xmp) dt_exif_write_metadata(NULL, 0, xmp, filename, 1);
+#endif
   return 0;
 }
 
@@ -29,7 +29,9 @@
 #include <stddef.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <tiffio.h>
+#include <zlib.h>
 
 DT_MODULE(2)
 
@@ -51,8 +53,76 @@ typedef struct dt_imageio_tiff_gui_t
 } dt_imageio_tiff_gui_t;
 
 
+// drop the alpha channel of rows [y0, y0 + rows) of the image and pack them into out
+static void _pack_rows(const dt_imageio_tiff_t *d, const void *in_void, uint8_t *out, const int y0, const int rows)
+{
+  const size_t bytes = d->bpp / 8;
+  for(int y = y0; y < y0 + rows; y++)
+  {
+    const uint8_t *in = (const uint8_t *)in_void + (size_t)4 * bytes * y * d->width;
+    for(int x = 0; x < d->width; x++, in += 4 * bytes, out += 3 * bytes) memcpy(out, in, 3 * bytes);
+  }
+}
+
+// apply the predictor the tags promise to one packed row, the same way libtiff's codec would.
+// as we hand libtiff the compressed strips, we also have to do its byte swapping on big endian hosts.
+static void _predict_row(const dt_imageio_tiff_t *d, uint8_t *row, const size_t rowsize)
+{
+  const int predictor = d->compress == 1 ? 1 : (d->compress == 3 && d->bpp == 32) ? 3 : 2;
+
+  if(predictor == 3)
+  {
+    // floating point predictor: split the row into byte planes, most significant first, then difference
+    const size_t wc = rowsize / 4;
+    uint8_t *tmp = malloc(rowsize);
+    memcpy(tmp, row, rowsize);
+    for(size_t count = 0; count < wc; count++)
+      for(int byte = 0; byte < 4; byte++)
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+        row[byte * wc + count] = tmp[4 * count + byte];
+#else
+        row[(4 - byte - 1) * wc + count] = tmp[4 * count + byte];
+#endif
+    free(tmp);
+    for(size_t i = rowsize - 1; i >= 3; i--) row[i] -= row[i - 3];
+    return;
+  }
+
+  if(predictor == 2)
+  {
+    // horizontal differencing of the samples, three per pixel
+    if(d->bpp == 8)
+    {
+      for(size_t i = rowsize - 1; i >= 3; i--) row[i] -= row[i - 3];
+    }
+    else if(d->bpp == 16)
+    {
+      uint16_t *s = (uint16_t *)row;
+      for(size_t i = rowsize / 2 - 1; i >= 3; i--) s[i] -= s[i - 3];
+    }
+    else
+    {
+      uint32_t *s = (uint32_t *)row;
+      for(size_t i = rowsize / 4 - 1; i >= 3; i--) s[i] -= s[i - 3];
+    }
+  }
+
+#if G_BYTE_ORDER == G_BIG_ENDIAN
+  if(d->bpp == 16)
+  {
+    uint16_t *s = (uint16_t *)row;
+    for(size_t i = 0; i < rowsize / 2; i++) s[i] = GUINT16_SWAP_LE_BE(s[i]);
+  }
+  else if(d->bpp == 32)
+  {
+    uint32_t *s = (uint32_t *)row;
+    for(size_t i = 0; i < rowsize / 4; i++) s[i] = GUINT32_SWAP_LE_BE(s[i]);
+  }
+#endif
+}
+
 int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const void *in_void, void *exif,
-                int exif_len, int imgid, int num, int total)
+                int exif_len, const char *xmp, int imgid, int num, int total)
 {
   const dt_imageio_tiff_t *d = (dt_imageio_tiff_t *)d_tmp;
 
@@ -61,10 +131,15 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
 
   TIFF *tif = NULL;
 
-  void *rowdata = NULL;
+  void *stripdata = NULL;
+  size_t *striplen = NULL;
 
   int rc = 1; // default to error
 
+  const size_t rowsize = (size_t)(d->width * 3) * d->bpp / 8;
+  // aim for strips of ~256k, big enough to compress well and to be worth a thread
+  const int rows_per_strip = CLAMP((256 * 1024) / rowsize, 1, d->height);
+
   if(imgid > 0)
   {
     cmsHPROFILE out_profile = dt_colorspaces_get_output_profile(imgid)->profile;
@@ -127,6 +202,11 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   {
     TIFFSetField(tif, TIFFTAG_ICCPROFILE, (uint32_t)profile_len, profile);
   }
+  if(xmp != NULL)
+  {
+    // embedded right away, so exiv2 only has to merge the exif data below
+    TIFFSetField(tif, TIFFTAG_XMLPACKET, (uint32_t)strlen(xmp), xmp);
+  }
   TIFFSetField(tif, TIFFTAG_SAMPLESPERPIXEL, (uint16_t)3);
   TIFFSetField(tif, TIFFTAG_BITSPERSAMPLE, (uint16_t)d->bpp);
   TIFFSetField(tif, TIFFTAG_SAMPLEFORMAT, (uint16_t)(d->bpp == 32 ? SAMPLEFORMAT_IEEEFP : SAMPLEFORMAT_UINT));
@@ -134,7 +214,7 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
   TIFFSetField(tif, TIFFTAG_IMAGELENGTH, (uint32_t)d->height);
   TIFFSetField(tif, TIFFTAG_PHOTOMETRIC, (uint16_t)PHOTOMETRIC_RGB);
   TIFFSetField(tif, TIFFTAG_PLANARCONFIG, (uint16_t)PLANARCONFIG_CONTIG);
-  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)1);
+  TIFFSetField(tif, TIFFTAG_ROWSPERSTRIP, (uint32_t)rows_per_strip);
   TIFFSetField(tif, TIFFTAG_ORIENTATION, (uint16_t)ORIENTATION_TOPLEFT);
 
   int resolution = dt_conf_get_int("metadata/resolution");
@@ -145,64 +225,65 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     TIFFSetField(tif, TIFFTAG_RESOLUTIONUNIT, (uint16_t)RESUNIT_INCH);
   }
 
-  const size_t rowsize = (d->width * 3) * d->bpp / 8;
-  if((rowdata = malloc(rowsize)) == NULL)
+  const double start = dt_get_wtime();
+  const uint32_t nstrips = TIFFNumberOfStrips(tif);
+  const int threads = dt_imageio_get_encode_threads();
+  // compress a few strips per thread at a time, and write them out in order before doing the next batch
+  const uint32_t strips_per_batch = 2 * threads;
+  const size_t stripsize = rowsize * rows_per_strip;
+  const size_t outsize = d->compress > 0 ? compressBound(stripsize) : 0;
+
+  if((stripdata = malloc((stripsize + outsize) * strips_per_batch)) == NULL
+     || (striplen = malloc(sizeof(size_t) * strips_per_batch)) == NULL)
   {
     rc = 1;
     goto exit;
   }
 
-  if(d->bpp == 32)
+  for(uint32_t batch = 0; batch < nstrips; batch += strips_per_batch)
   {
-    for(int y = 0; y < d->height; y++)
-    {
-      float *in = (float *)in_void + (size_t)4 * y * d->width;
-      float *out = (float *)rowdata;
+    const uint32_t count = MIN(strips_per_batch, nstrips - batch);
+    int failed = 0;
 
-      for(int x = 0; x < d->width; x++, in += 4, out += 3)
-      {
-        memcpy(out, in, 3 * sizeof(float));
-      }
-
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
-      {
-        rc = 1;
-        goto exit;
-      }
-    }
-  }
-  else if(d->bpp == 16)
-  {
-    for(int y = 0; y < d->height; y++)
+#ifdef _OPENMP
+#pragma omp parallel for schedule(dynamic) default(none) num_threads(threads) \
+    firstprivate(batch, count, rows_per_strip, rowsize, stripsize, outsize) \
+    shared(stripdata, striplen, d, in_void) reduction(| : failed)
+#endif
+    for(uint32_t k = 0; k < count; k++)
     {
-      uint16_t *in = (uint16_t *)in_void + (size_t)4 * y * d->width;
-      uint16_t *out = (uint16_t *)rowdata;
+      const uint32_t strip = batch + k;
+      const int y0 = strip * rows_per_strip;
+      const int rows = MIN(rows_per_strip, d->height - y0);
+      uint8_t *buf = (uint8_t *)stripdata + k * (stripsize + outsize);
 
-      for(int x = 0; x < d->width; x++, in += 4, out += 3)
-      {
-        memcpy(out, in, 3 * sizeof(uint16_t));
-      }
+      _pack_rows(d, in_void, buf, y0, rows);
 
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
+      if(d->compress > 0)
       {
-        rc = 1;
-        goto exit;
+        for(int r = 0; r < rows; r++) _predict_row(d, buf + r * rowsize, rowsize);
+
+        uLongf len = outsize;
+        if(compress2(buf + stripsize, &len, buf, rows * rowsize, 9) != Z_OK) failed = 1;
+        striplen[k] = len;
       }
+      else
+        striplen[k] = rows * rowsize;
     }
-  }
-  else
-  {
-    for(int y = 0; y < d->height; y++)
-    {
-      uint8_t *in = (uint8_t *)in_void + (size_t)4 * y * d->width;
-      uint8_t *out = (uint8_t *)rowdata;
 
-      for(int x = 0; x < d->width; x++, in += 4, out += 3)
-      {
-        memcpy(out, in, 3 * sizeof(uint8_t));
-      }
+    if(failed)
+    {
+      rc = 1;
+      goto exit;
+    }
 
-      if(TIFFWriteScanline(tif, rowdata, y, 0) == -1)
+    for(uint32_t k = 0; k < count; k++)
+    {
+      uint8_t *buf = (uint8_t *)stripdata + k * (stripsize + outsize);
+      // uncompressed strips still go through libtiff, which takes care of the byte order for us
+      const tmsize_t written = d->compress > 0 ? TIFFWriteRawStrip(tif, batch + k, buf + stripsize, striplen[k])
+                                               : TIFFWriteEncodedStrip(tif, batch + k, buf, striplen[k]);
+      if(written == -1)
       {
         rc = 1;
         goto exit;
@@ -210,6 +291,10 @@ int write_image(dt_imageio_module_data_t *d_tmp, const char *filename, const voi
     }
   }
 
+  dt_print(DT_DEBUG_PERF, "[tiff] encoded %dx%d at %d bit in %.3f secs (%.1f MPix/s, %d threads)\n", d->width,
+           d->height, d->bpp, dt_get_wtime() - start,
+           d->width * (double)d->height / 1e6 / MAX(dt_get_wtime() - start, 1e-6), threads);
+
   // success
   rc = 0;
 
@@ -228,8 +313,10 @@ exit:
   }
   free(profile);
   profile = NULL;
-  free(rowdata);
-  rowdata = NULL;
+  free(stripdata);
+  stripdata = NULL;
+  free(striplen);
+  striplen = NULL;
 
   return rc;
 }
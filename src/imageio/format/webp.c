@@ -28,6 +28,7 @@
 #include "imageio/format/imageio_format_api.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <webp/encode.h>
 
@@ -108,12 +109,94 @@ static int FileWriter(const uint8_t *data, size_t data_size, const WebPPicture *
   return data_size ? (fwrite(data, data_size, 1, out) == 1) : 1;
 }
 
+static void _put_le24(uint8_t *p, const uint32_t v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+}
+
+static void _put_le32(uint8_t *p, const uint32_t v)
+{
+  _put_le24(p, v);
+  p[3] = (v >> 24) & 0xff;
+}
+
+static size_t _chunk_size(const size_t payload)
+{
+  return payload ? 8 + payload + (payload & 1) : 0;
+}
+
+static int _write_chunk(FILE *out, const char *fourcc, const void *payload, const size_t size)
+{
+  uint8_t header[8];
+  const uint8_t pad = 0;
+  memcpy(header, fourcc, 4);
+  _put_le32(header + 4, size);
+  return fwrite(header, sizeof(header), 1, out) == 1 && fwrite(payload, size, 1, out) == 1
+         && (!(size & 1) || fwrite(&pad, 1, 1, out) == 1);
+}
+
+// the simple file format has no room for metadata. wrap the encoded bitstream into the extended format
+// (VP8X) and append exif and xmp chunks, so that nobody has to rewrite the file afterwards.
+static int _write_extended(FILE *out, const uint8_t *data, const size_t size, const int width,
+                           const int height, const uint8_t *exif, const size_t exif_len, const char *xmp,
+                           const size_t xmp_len)
+{
+  if(size < 20 || memcmp(data, "RIFF", 4) || memcmp(data + 8, "WEBP", 4)) return 1;
+  const uint8_t *chunks = data + 12;
+  const size_t chunks_len = size - 12;
+  const int has_vp8x = !memcmp(chunks, "VP8X", 4);
+
+  uint8_t vp8x[10] = { 0 };
+  if(has_vp8x)
+    memcpy(vp8x, chunks + 8, sizeof(vp8x));
+  else
+  {
+    // lossless bitstreams tell whether they use alpha, lossy ones with alpha come as VP8X already
+    if(!memcmp(chunks, "VP8L", 4) && chunks_len >= 13 && (chunks[12] & 0x10)) vp8x[0] |= 0x10;
+    _put_le24(vp8x + 4, width - 1);
+    _put_le24(vp8x + 7, height - 1);
+  }
+  if(exif_len) vp8x[0] |= 0x08;
+  if(xmp_len) vp8x[0] |= 0x04;
+
+  // everything but the VP8X chunk is taken over as is
+  const uint8_t *image = has_vp8x ? chunks + _chunk_size(sizeof(vp8x)) : chunks;
+  const size_t image_len = has_vp8x ? chunks_len - _chunk_size(sizeof(vp8x)) : chunks_len;
+
+  const uint64_t riff_len
+      = 4 + _chunk_size(sizeof(vp8x)) + image_len + _chunk_size(exif_len) + _chunk_size(xmp_len);
+  if(riff_len > UINT32_MAX) return 1;
+
+  uint8_t header[12];
+  memcpy(header, "RIFF", 4);
+  _put_le32(header + 4, riff_len);
+  memcpy(header + 8, "WEBP", 4);
+
+  if(fwrite(header, sizeof(header), 1, out) != 1 || !_write_chunk(out, "VP8X", vp8x, sizeof(vp8x))
+     || fwrite(image, image_len, 1, out) != 1)
+    return 1;
+  if(exif_len && !_write_chunk(out, "EXIF", exif, exif_len)) return 1;
+  if(xmp_len && !_write_chunk(out, "XMP ", xmp, xmp_len)) return 1;
+  return 0;
+}
+
 int write_image(dt_imageio_module_data_t *webp, const char *filename, const void *in_tmp, void *exif,
-                int exif_len, int imgid, int num, int total)
+                int exif_len, const char *xmp, int imgid, int num, int total)
 {
   dt_imageio_webp_t *webp_data = (dt_imageio_webp_t *)webp;
   FILE *out = g_fopen(filename, "wb");
 
+  // with metadata the bitstream is collected in memory first, to be wrapped into the extended format.
+  // the exif chunk holds the tiff structure, without the "Exif\0\0" header of our blob.
+  const uint8_t *exif_data = (exif && exif_len > 6) ? (const uint8_t *)exif + 6 : NULL;
+  const size_t exif_data_len = exif_data ? exif_len - 6 : 0;
+  const size_t xmp_len = xmp ? strlen(xmp) : 0;
+  const int has_metadata = exif_data_len || xmp_len;
+  WebPMemoryWriter writer;
+  WebPMemoryWriterInit(&writer);
+
   // Create, configure and validate a WebPConfig instance
   WebPConfig config;
   if(!WebPConfigPreset(&config, webp_data->hint, (float)webp_data->quality)) goto Error;
@@ -135,6 +218,11 @@ int write_image(dt_imageio_module_data_t *webp, const char *filename, const void
     fprintf(stderr, "[webp export] error saving to %s\n", filename);
     goto Error;
   }
+  else if(has_metadata)
+  {
+    pic.writer = WebPMemoryWrite;
+    pic.custom_ptr = &writer;
+  }
   else
   {
     pic.writer = FileWriter;
@@ -162,12 +250,21 @@ int write_image(dt_imageio_module_data_t *webp, const char *filename, const void
     fprintf(stderr, "[webp export] error code: %d (%s)\n", pic.error_code, EncoderError[pic.error_code]);
     goto Error;
   }
+  if(has_metadata
+     && _write_extended(out, writer.mem, writer.size, webp_data->width, webp_data->height, exif_data,
+                        exif_data_len, xmp, xmp_len))
+  {
+    fprintf(stderr, "[webp export] error writing to %s\n", filename);
+    goto Error;
+  }
   WebPPictureFree(&pic);
+  free(writer.mem); // WebPMemoryWriterClear() is not available in older versions
   fclose(out);
   return 0;
 
 Error:
   WebPPictureFree(&pic);
+  free(writer.mem);
   if(out != NULL)
   {
     fclose(out);
@@ -341,8 +438,8 @@ void gui_reset(dt_imageio_module_format_t *self)
 
 int flags(dt_imageio_module_data_t *data)
 {
-  // TODO(jinxos): support embedded XMP/ICC
-  return 0;
+  // TODO(jinxos): support embedded ICC
+  return FORMAT_FLAGS_SUPPORT_XMP;
 }
 
 // modelines: These editor modelines have been set for all relevant files by tools/update_modelines.sh
@@ -32,10 +32,13 @@
 #include "gui/gtk.h"
 #include "gui/gtkentry.h"
 #include "imageio/storage/imageio_storage_api.h"
+#include <errno.h>
+#include <fcntl.h>
 #include <glib.h>
 #include <glib/gstdio.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <unistd.h>
 
 DT_MODULE(2)
 
@@ -279,35 +282,42 @@ try_again:
 
   /* prevent overwrite of files */
   failed:
-    if(!d->overwrite)
+    if(!d->overwrite && !fail && *ext)
     {
+      // the file is only written later on by the export queue, so claim the name right away by creating it.
+      // otherwise two images of this export could both find the same name still free. formats without an
+      // extension (copy) append their own and write synchronously.
       int seq = 1;
-      if(!fail && g_file_test(filename, G_FILE_TEST_EXISTS))
+      int fd;
+      while((fd = g_open(filename, O_WRONLY | O_CREAT | O_EXCL, 0666)) == -1 && errno == EEXIST)
       {
-        do
-        {
-          sprintf(c, "_%.2d.%s", seq, ext);
-          seq++;
-        } while(g_file_test(filename, G_FILE_TEST_EXISTS));
+        sprintf(c, "_%.2d.%s", seq, ext);
+        seq++;
       }
+      if(fd == -1)
+      {
+        fprintf(stderr, "[imageio_storage_disk] could not create file: `%s'!\n", filename);
+        dt_control_log(_("could not export to file `%s'!"), filename);
+        fail = 1;
+      }
+      else
+        close(fd);
     }
   } // end of critical block
   dt_pthread_mutex_unlock(&darktable.plugin_threadsafe);
   if(fail) return 1;
 
-  /* export image to file */
-  if(dt_imageio_export(imgid, filename, format, fdata, high_quality, upscale, TRUE, self, sdata, num, total) != 0)
+  /* export image to file, the actual write happens in the background and reports back when done */
+  if(dt_imageio_export_async(imgid, filename, format, fdata, high_quality, upscale, TRUE, self, sdata, num, total)
+     != 0)
   {
     fprintf(stderr, "[imageio_storage_disk] could not export to file: `%s'!\n", filename);
     dt_control_log(_("could not export to file `%s'!"), filename);
+    // don't leave the reserved name behind
+    if(!d->overwrite && *ext) g_unlink(filename);
     return 1;
   }
 
-  printf("[export_job] exported to `%s'\n", filename);
-  char *trunc = filename + strlen(filename) - 32;
-  if(trunc < filename) trunc = filename;
-  dt_control_log(ngettext("%d/%d exported to `%s%s'", "%d/%d exported to `%s%s'", num),
-                 num, total, trunc != filename ? ".." : "", trunc);
   return 0;
 }
 
@@ -273,8 +273,11 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
   {
     dt_bilateral_t *b = dt_bilateral_init(roi_in->width, roi_in->height, sigma_s, sigma_r);
     dt_bilateral_splat(b, (float *)i);
-    dt_bilateral_blur(b);
-    dt_bilateral_slice(b, (float *)i, (float *)o, d->detail);
+    if(!dt_iop_should_abort(piece))
+    {
+      dt_bilateral_blur(b);
+      dt_bilateral_slice(b, (float *)i, (float *)o, d->detail);
+    }
     dt_bilateral_free(b);
   }
   else // s_mode_local_laplacian
@@ -302,8 +305,11 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   {
     dt_bilateral_t *b = dt_bilateral_init(roi_in->width, roi_in->height, sigma_s, sigma_r);
     dt_bilateral_splat(b, (float *)i);
-    dt_bilateral_blur(b);
-    dt_bilateral_slice(b, (float *)i, (float *)o, d->detail);
+    if(!dt_iop_should_abort(piece))
+    {
+      dt_bilateral_blur(b);
+      dt_bilateral_slice(b, (float *)i, (float *)o, d->detail);
+    }
     dt_bilateral_free(b);
   }
   else // s_mode_local_laplacian
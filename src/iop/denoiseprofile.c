@@ -801,6 +801,8 @@ static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
 
   for(int scale = 0; scale < max_scale; scale++)
   {
+    if(dt_iop_should_abort(piece)) break;
+
     const float sigma = 1.0f;
     const float varf = sqrtf(2.0f + 2.0f * 4.0f * 4.0f + 6.0f * 6.0f) / 16.0f; // about 0.5
     const float sigma_band = powf(varf, scale) * sigma;
@@ -833,6 +835,8 @@ static void process_wavelets(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_
   // now do everything backwards, so the result will end up in *ovoid
   for(int scale = max_scale - 1; scale >= 0; scale--)
   {
+    if(dt_iop_should_abort(piece)) break;
+
 #if 1
     // variance stabilizing transform maps sigma to unity.
     const float sigma = 1.0f;
@@ -911,6 +915,9 @@ static void process_nlmeans(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t
   // for each shift vector
   for(int kj = -K; kj <= K; kj++)
   {
+    // the pipe is going to start over, the result would be thrown away anyway
+    if(dt_iop_should_abort(piece)) break;
+
     for(int ki = -K; ki <= K; ki++)
     {
       // TODO: adaptive K tests here!
@@ -1059,6 +1066,8 @@ static void process_nlmeans_sse(struct dt_iop_module_t *self, dt_dev_pixelpipe_i
   // for each shift vector
   for(int kj = -K; kj <= K; kj++)
   {
+    if(dt_iop_should_abort(piece)) break;
+
     for(int ki = -K; ki <= K; ki++)
     {
       // TODO: adaptive K tests here!
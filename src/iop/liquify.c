@@ -1325,9 +1325,9 @@ void process(struct dt_iop_module_t *module, dt_dev_pixelpipe_iop_t *piece, cons
   if (map == NULL)
     return;
 
-  // 3. apply the map
+  // 3. apply the map, unless the pipe is about to start over
 
-  if (map_extent.width != 0 && map_extent.height != 0)
+  if (map_extent.width != 0 && map_extent.height != 0 && !dt_iop_should_abort (piece))
     apply_global_distortion_map (module, piece, in, out, roi_in, roi_out, map, &map_extent);
 
   dt_free_align ((void *) map);
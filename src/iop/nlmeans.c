@@ -400,6 +400,9 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
   // for each shift vector
   for(int kj = -K; kj <= K; kj++)
   {
+    // no need to finish if the pipe is restarted
+    if(dt_iop_should_abort(piece)) break;
+
     for(int ki = -K; ki <= K; ki++)
     {
       int inited_slide = 0;
@@ -544,6 +547,8 @@ void process_sse2(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, c
   // for each shift vector
   for(int kj = -K; kj <= K; kj++)
   {
+    if(dt_iop_should_abort(piece)) break;
+
     for(int ki = -K; ki <= K; ki++)
     {
       int inited_slide = 0;
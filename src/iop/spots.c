@@ -479,7 +479,7 @@ void process(struct dt_iop_module_t *self, dt_dev_pixelpipe_iop_t *piece, const
         // we get the mask
         float *mask = NULL;
         int posx, posy, width, height;
-        dt_masks_get_mask(self, piece, form, &mask, &width, &height, &posx, &posy);
+        dt_masks_get_mask_cached(self, piece, form, &mask, &width, &height, &posx, &posy);
         int fts = posy * roi_in->scale, fhs = height * roi_in->scale, fls = posx * roi_in->scale,
             fws = width * roi_in->scale;
         int dx = 0, dy = 0;
@@ -26,6 +26,7 @@
 #include "dtgtk/icon.h"
 #include "gui/accelerators.h"
 #include "gui/gtk.h"
+#include "gui/presets.h"
 #include <stdbool.h>
 #include <stdlib.h>
 
@@ -668,9 +669,11 @@ void dt_lib_init_presets(dt_lib_module_t *module)
   {
     sqlite3_stmt *stmt;
     DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                                "SELECT rowid, op_version, op_params, name FROM data.presets WHERE operation=?1",
+                                "SELECT rowid, op_version, op_params, name FROM data.presets WHERE operation=?1 "
+                                "AND op_version<?2",
                                 -1, &stmt, NULL);
     DT_DEBUG_SQLITE3_BIND_TEXT(stmt, 1, module->plugin_name, -1, SQLITE_TRANSIENT);
+    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, module->version(module));
     while(sqlite3_step(stmt) == SQLITE_ROW)
     {
       int rowid = sqlite3_column_int(stmt, 0);
@@ -722,7 +725,12 @@ void dt_lib_init_presets(dt_lib_module_t *module)
     sqlite3_finalize(stmt);
   }
 
-  if(module->init_presets) module->init_presets(module);
+  // built-in presets are only written again when the module or the build changed
+  if(module->init_presets && dt_gui_presets_begin_builtin(module->plugin_name, module->version(module)))
+  {
+    module->init_presets(module);
+    dt_gui_presets_end_builtin(module->plugin_name, module->version(module));
+  }
 }
 
 static void dt_lib_init_module(void *m)
@@ -1063,8 +1071,10 @@ void dt_lib_init(dt_lib_t *lib)
 {
   // Setting everything to null initially
   memset(lib, 0, sizeof(dt_lib_t));
+  dt_database_start_transaction(darktable.db);
   darktable.lib->plugins = dt_module_load_modules("/plugins/lighttable", sizeof(dt_lib_module_t),
                                                   dt_lib_load_module, dt_lib_init_module, dt_lib_sort_plugins);
+  dt_database_release_transaction(darktable.db);
 }
 
 void dt_lib_cleanup(dt_lib_t *lib)
@@ -215,6 +215,7 @@ static void write_metadata(dt_lib_module_t *self)
   gchar *creator = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(d->creator));
   gchar *publisher = gtk_combo_box_text_get_active_text(GTK_COMBO_BOX_TEXT(d->publisher));
 
+  dt_database_start_transaction(darktable.db);
   if(title != NULL && (d->multi_title == FALSE || gtk_combo_box_get_active(GTK_COMBO_BOX(d->title)) != 0))
     dt_metadata_set(mouse_over_id, "Xmp.dc.title", title);
   if(description != NULL
@@ -228,6 +229,7 @@ static void write_metadata(dt_lib_module_t *self)
   if(publisher != NULL
      && (d->multi_publisher == FALSE || gtk_combo_box_get_active(GTK_COMBO_BOX(d->publisher)) != 0))
     dt_metadata_set(mouse_over_id, "Xmp.dc.publisher", publisher);
+  dt_database_release_transaction(darktable.db);
 
   g_free(title);
   g_free(description);
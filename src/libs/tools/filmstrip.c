@@ -503,26 +503,7 @@ static gboolean _lib_filmstrip_scroll_callback(GtkWidget *w, GdkEventScroll *e,
 
 static gboolean _lib_filmstrip_imgid_in_collection(const dt_collection_t *collection, const int imgid)
 {
-  sqlite3_stmt *stmt;
-  gboolean image_in_collection = TRUE;
-  const char *query = dt_collection_get_query(collection);
-
-  char *count_query = g_strdup_printf("SELECT count(id) FROM (%s) WHERE id = ?3", query);
-
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), count_query, -1, &stmt, NULL);
-  if((collection->params.query_flags & COLLECTION_QUERY_USE_LIMIT)
-     && !(collection->params.query_flags & COLLECTION_QUERY_USE_ONLY_WHERE_EXT))
-  {
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, 0);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, -1);
-  }
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 3, imgid);
-
-  if(sqlite3_step(stmt) == SQLITE_ROW)
-    image_in_collection = (sqlite3_column_int(stmt, 0) > 0);
-  sqlite3_finalize(stmt);
-  g_free(count_query);
-  return image_in_collection;
+  return dt_collection_get_position(collection, imgid) >= 0;
 }
 
 static gboolean _lib_filmstrip_button_press_callback(GtkWidget *w, GdkEventButton *e, gpointer user_data)
@@ -671,9 +652,6 @@ static gboolean _lib_filmstrip_draw_callback(GtkWidget *widget, cairo_t *cr, gpo
 
   const int col_start = max_cols / 2 - strip->offset;
   const int empty_edge = (width - (max_cols * wd)) / 2;
-  int step_res = SQLITE_ROW;
-
-  sqlite3_stmt *stmt = NULL;
 
   /* mouse over image position in filmstrip */
   pointerx -= empty_edge;
@@ -685,18 +663,16 @@ static gboolean _lib_filmstrip_draw_callback(GtkWidget *widget, cairo_t *cr, gpo
   /* get the count of current collection */
   strip->collection_count = dt_collection_get_count(darktable.collection);
 
-  /* get the collection query */
-  const gchar *query = dt_collection_get_query(darktable.collection);
-  if(!query) return FALSE;
-
   if(offset < 0) strip->offset = offset = 0;
   if(offset > strip->collection_count - 1) strip->offset = offset = strip->collection_count - 1;
 
   // dt_view_set_scrollbar(self, offset, count, max_cols, 0, 1, 1);
 
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), query, -1, &stmt, NULL);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, offset - max_cols / 2);
-  DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, max_cols);
+  int32_t *ids = malloc(sizeof(int32_t) * max_cols);
+  if(!ids) return FALSE;
+  const int ids_count = dt_collection_get_range(darktable.collection, offset - max_cols / 2, max_cols, ids);
+  dt_image_cache_prefetch(darktable.image_cache, ids, ids_count);
+  int current = 0;
 
 
   cairo_save(cr);
@@ -709,14 +685,9 @@ static gboolean _lib_filmstrip_draw_callback(GtkWidget *widget, cairo_t *cr, gpo
       continue;
     }
 
-    if(step_res != SQLITE_DONE)
-    {
-      step_res = sqlite3_step(stmt);
-    }
-
-    if(step_res == SQLITE_ROW)
+    if(current < ids_count)
     {
-      int id = sqlite3_column_int(stmt, 0);
+      int id = ids[current++];
       // set mouse over id
       if(seli == col)
       {
@@ -731,17 +702,11 @@ static gboolean _lib_filmstrip_draw_callback(GtkWidget *widget, cairo_t *cr, gpo
       dt_view_image_expose(&(strip->image_over), id, cr, wd, ht, max_cols, img_pointerx, img_pointery, FALSE, FALSE);
       cairo_restore(cr);
     }
-    else if(step_res == SQLITE_DONE)
-    {
-      /* do nothing, just add some empty thumb frames */
-    }
-    else
-      goto failure;
+    /* else do nothing, just add some empty thumb frames */
     cairo_translate(cr, wd, 0.0f);
   }
-failure:
   cairo_restore(cr);
-  sqlite3_finalize(stmt);
+  free(ids);
 
   if(darktable.gui->center_tooltip == 1) // set in this round
   {
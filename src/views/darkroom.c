@@ -200,12 +200,18 @@ void expose(
     roi_hash_old = roi_hash;
     mutex = &dev->pipe->backbuf_mutex;
     dt_pthread_mutex_lock(mutex);
-    float wd = dev->pipe->backbuf_width;
-    float ht = dev->pipe->backbuf_height;
-    stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, wd);
-    surface = dt_cairo_image_surface_create_for_data(dev->pipe->backbuf, CAIRO_FORMAT_RGB24, wd, ht, stride);
-    wd /= darktable.gui->ppd;
-    ht /= darktable.gui->ppd;
+    // the backbuf may have been rendered with a margin around the view to pan in (see
+    // dt_dev_process_image_job()), or by a coarse pass of progressive rendering at a fraction of the size.
+    float scale;
+    int view_x, view_y, view_wd, view_ht;
+    dt_dev_get_viewport(dev, zoom, closeup, zoom_x, zoom_y, &scale, &view_x, &view_y, &view_wd, &view_ht);
+    const float coarse = dev->pipe->backbuf_scale < 0.99f * scale ? scale / dev->pipe->backbuf_scale : 1.0f;
+    const float ppd = darktable.gui->ppd;
+    const float wd = view_wd / ppd;
+    const float ht = view_ht / ppd;
+    stride = cairo_format_stride_for_width(CAIRO_FORMAT_RGB24, dev->pipe->backbuf_width);
+    surface = dt_cairo_image_surface_create_for_data(dev->pipe->backbuf, CAIRO_FORMAT_RGB24,
+                                                     dev->pipe->backbuf_width, dev->pipe->backbuf_height, stride);
     if(dev->full_preview)
       dt_gui_gtk_set_source_rgb(cr, DT_GUI_COLOR_DARKROOM_PREVIEW_BG);
     else
@@ -219,7 +225,11 @@ void expose(
     }
     cairo_rectangle(cr, 0, 0, wd, ht);
     cairo_set_source_surface(cr, surface, 0, 0);
-    cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_FAST);
+    cairo_matrix_t matrix;
+    cairo_matrix_init(&matrix, 1.0 / coarse, 0.0, 0.0, 1.0 / coarse, (view_x / coarse - dev->pipe->backbuf_x) / ppd,
+                      (view_y / coarse - dev->pipe->backbuf_y) / ppd);
+    cairo_pattern_set_matrix(cairo_get_source(cr), &matrix);
+    cairo_pattern_set_filter(cairo_get_source(cr), coarse > 1.0f ? CAIRO_FILTER_GOOD : CAIRO_FILTER_FAST);
     cairo_fill_preserve(cr);
     cairo_set_line_width(cr, 1.0);
     cairo_set_source_rgb(cr, .3, .3, .3);
@@ -770,17 +780,12 @@ static void dt_dev_jump_image(dt_develop_t *dev, int diff)
 
     offset = dt_collection_image_offset(orig_imgid);
 
-    DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db), qin, -1, &stmt, NULL);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 1, offset + diff);
-    DT_DEBUG_SQLITE3_BIND_INT(stmt, 2, 1);
-    if(sqlite3_step(stmt) == SQLITE_ROW)
+    imgid = dt_collection_get_nth(darktable.collection, MAX(offset + diff, 0));
+    if(imgid > 0)
     {
-      imgid = sqlite3_column_int(stmt, 0);
-
       if(orig_imgid == imgid)
       {
         // nothing to do
-        sqlite3_finalize(stmt);
         return;
       }
 
@@ -792,7 +797,6 @@ static void dt_dev_jump_image(dt_develop_t *dev, int diff)
         dt_dev_change_image(dev, imgid);
       }
     }
-    sqlite3_finalize(stmt);
   }
 }
 
@@ -1955,7 +1959,8 @@ void mouse_moved(dt_view_t *self, double x, double y, double pressure, int which
     dt_control_set_dev_zoom_y(zy);
     ctl->button_x = x - offx;
     ctl->button_y = y - offy;
-    dt_dev_invalidate(dev);
+    // pans inside of what the full pipe rendered last time only need a redraw
+    if(!dt_dev_view_is_rendered(dev)) dt_dev_invalidate(dev);
     dt_control_queue_redraw();
   }
 }
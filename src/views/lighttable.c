@@ -115,7 +115,6 @@ typedef struct dt_library_t
   struct
   {
     /* main query statment, should be update on listener signal of collection */
-    sqlite3_stmt *main_query;
     /* select imgid from selected_images */
     sqlite3_stmt *select_imgid_in_selection;
     /* delete from selected_images where imgid != ?1 */
@@ -348,14 +347,6 @@ static void _update_collected_images(dt_view_t *self)
     sqlite3_finalize(stmt);
   }
 
-  /* if we have a statment lets clean it */
-  if(lib->statements.main_query) sqlite3_finalize(lib->statements.main_query);
-
-  /* prepare a new main query statement for collection */
-  DT_DEBUG_SQLITE3_PREPARE_V2(dt_database_get(darktable.db),
-                              "SELECT imgid FROM memory.collected_images ORDER BY rowid LIMIT ?1, ?2", -1,
-                              &lib->statements.main_query, NULL);
-
   dt_control_queue_redraw_center();
 }
 
@@ -418,7 +409,7 @@ void init(dt_view_t *self)
   lib->full_res_thumb_id = -1;
   lib->audio_player_id = -1;
 
-  /* setup collection listener and initialize main_query statement */
+  /* setup collection listener */
   dt_control_signal_connect(darktable.signals, DT_SIGNAL_COLLECTION_CHANGED,
                             G_CALLBACK(_view_lighttable_collection_listener_callback), (gpointer)self);
 
@@ -565,9 +556,6 @@ static int expose_filemanager(dt_view_t *self, cairo_t *cr, int32_t width, int32
     return 0;
   }
 
-  /* do we have a main query collection statement */
-  if(!lib->statements.main_query) return 0;
-
   /* safety check added to be able to work with zoom slider. The
   * communication between zoom slider and lighttable should be handled
   * differently (i.e. this is a clumsy workaround) */
@@ -589,14 +577,6 @@ static int expose_filemanager(dt_view_t *self, cairo_t *cr, int32_t width, int32
   if(iir > 1) shown_rows += max_rows - 2;
   dt_view_set_scrollbar(self, 0, 1, 1, offset, shown_rows * iir, (max_rows - 1) * iir);
 
-  /* let's reset and reuse the main_query statement */
-  DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->statements.main_query);
-  DT_DEBUG_SQLITE3_RESET(lib->statements.main_query);
-
-  /* setup offset and row for the main query */
-  DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 1, offset);
-  DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 2, max_rows * iir);
-
   if(mouse_over_id != -1)
   {
     const dt_image_t *mouse_over_image = dt_image_cache_get(darktable.image_cache, mouse_over_id, 'r');
@@ -613,18 +593,9 @@ static int expose_filemanager(dt_view_t *self, cairo_t *cr, int32_t width, int32
   // group.
   int *query_ids = (int *)calloc(max_rows * max_cols, sizeof(int));
   if(!query_ids) goto after_drawing;
-  for(int row = 0; row < max_rows; row++)
-  {
-    for(int col = 0; col < max_cols; col++)
-    {
-      if(sqlite3_step(lib->statements.main_query) == SQLITE_ROW)
-        query_ids[row * iir + col] = sqlite3_column_int(lib->statements.main_query, 0);
-      else
-        goto end_query_cache;
-    }
-  }
+  dt_image_cache_prefetch(darktable.image_cache, query_ids,
+                          dt_collection_get_range(darktable.collection, offset, max_rows * iir, query_ids));
 
-end_query_cache:
   mouse_over_id = -1;
   cairo_save(cr);
   int current_image = 0;
@@ -902,17 +873,8 @@ after_drawing:
     const int prefetchrows = .5 * max_rows + 1;
     int32_t *imgids = malloc(prefetchrows * iir * sizeof(int32_t));
 
-    /* clear and reset main query */
-    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->statements.main_query);
-    DT_DEBUG_SQLITE3_RESET(lib->statements.main_query);
-
-    /* setup offest and row for prefetch */
-    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 1, offset + max_rows * iir);
-    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 2, prefetchrows * iir);
-
     // prefetch jobs in inverse order: supersede previous jobs: most important last
-    while(sqlite3_step(lib->statements.main_query) == SQLITE_ROW && imgids_num < prefetchrows * iir)
-      imgids[imgids_num++] = sqlite3_column_int(lib->statements.main_query, 0);
+    imgids_num = dt_collection_get_range(darktable.collection, offset + max_rows * iir, prefetchrows * iir, imgids);
 
     float imgwd = iir == 1 ? 0.97 : 0.8;
     dt_mipmap_size_t mip = dt_mipmap_cache_get_matching_size(darktable.mipmap_cache, imgwd * wd,
@@ -992,8 +954,6 @@ static int expose_zoomable(dt_view_t *self, cairo_t *cr, int32_t width, int32_t
     zoom_y = lib->select_offset_y - /* (zoom == 1 ? 2. : 1.)*/ pointery;
   }
 
-  if(!lib->statements.main_query) return 0;
-
   if(track == 0)
     ;
   else if(track > 1)
@@ -1152,17 +1112,13 @@ static int expose_zoomable(dt_view_t *self, cairo_t *cr, int32_t width, int32_t
       continue;
     }
 
-    /* clear and reset main query */
-    DT_DEBUG_SQLITE3_CLEAR_BINDINGS(lib->statements.main_query);
-    DT_DEBUG_SQLITE3_RESET(lib->statements.main_query);
-
-    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 1, offset);
-    DT_DEBUG_SQLITE3_BIND_INT(lib->statements.main_query, 2, max_cols);
+    int32_t row_ids[DT_LIBRARY_MAX_ZOOM];
+    const int row_count = dt_collection_get_range(darktable.collection, offset, max_cols, row_ids);
     for(int col = 0; col < max_cols; col++)
     {
-      if(sqlite3_step(lib->statements.main_query) == SQLITE_ROW)
+      if(col < row_count)
       {
-        id = sqlite3_column_int(lib->statements.main_query, 0);
+        id = row_ids[col];
 
         // set mouse over id
         if((zoom == 1 && mouse_over_id < 0) || ((!pan || track) && seli == col && selj == row && pointerx > 0
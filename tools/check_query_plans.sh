@@ -0,0 +1,159 @@
+#!/bin/sh
+
+#
+# Usage: check_query_plans [darktable config dir] [number of images]
+#
+# copies the schema of the library and data databases darktable created in the config
+# dir (~/.config/darktable by default), fills the copy with synthetic images (500000 by
+# default) and prints the query plan and the run time of the queries the collect module
+# generates for each collection property and sort order. run the darktable build to be
+# tested on that config dir once before, so the schema and indexes are the ones it
+# creates. the databases themselves are only read.
+#
+# queries marked "index" must not scan any of the big tables, the script exits with
+# a non-zero status if one does. queries marked "scan" can't use an index (LIKE '%..%',
+# ROUND() and friends) and are only reported. the where clauses below follow
+# get_query_string() in src/common/collection.c.
+#
+
+CONFIGDIR=${1:-$HOME/.config/darktable}
+IMAGES=${2:-500000}
+
+# tables that are small enough to be scanned, including the aliases used in the queries
+SMALL_TABLES="film_rolls|tags|b"
+
+TMPDIR=$(mktemp -d)
+LIBDB=$TMPDIR/library.db
+DATADB=$TMPDIR/data.db
+trap 'rm -rf "$TMPDIR"' EXIT
+
+if ! command -v sqlite3 > /dev/null; then
+    echo missing sqlite3
+    exit 1
+fi
+
+# sqlite's own tables get created again on demand and can't be created by hand
+copy_schema()
+{
+    if [ ! -f "$1" ]; then
+        echo no database at $1
+        exit 1
+    fi
+    sqlite3 -readonly "$1" .schema | grep -v "^CREATE TABLE sqlite_" | sqlite3 "$2" || exit 1
+}
+
+copy_schema "$CONFIGDIR/library.db" "$LIBDB"
+copy_schema "$CONFIGDIR/data.db" "$DATADB"
+
+FILL="
+ATTACH DATABASE '$DATADB' AS data;
+BEGIN TRANSACTION;
+WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 2000)
+  INSERT INTO film_rolls (id, folder) SELECT i, '/home/user/pictures/' || (2000 + i / 200) || '/roll_' || i FROM n;
+WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < 5000)
+  INSERT INTO data.tags (id, name) SELECT i, 'places|country ' || (i % 50) || '|city ' || i FROM n;
+WITH RECURSIVE n(i) AS (SELECT 1 UNION ALL SELECT i + 1 FROM n WHERE i < $IMAGES)
+  INSERT INTO images (id, group_id, film_id, width, height, filename, maker, model, lens, exposure, aperture,
+                      iso, focal_length, datetime_taken, flags, longitude, latitude, version, max_version)
+  SELECT i, i, 1 + i % 2000, 6000, 4000, 'IMG_' || i || '.CR2', 'maker ' || (i % 7), 'model ' || (i % 31),
+         'lens ' || (i % 23), 1.0 / (1 + i % 1000), 1.4 + (i % 20) * 0.7, 100 << (i % 7), 10 + i % 190,
+         strftime('%Y:%m:%d %H:%M:%S', 1000000000 + i * 600, 'unixepoch'), i % 6,
+         CASE WHEN i % 5 = 0 THEN 11.5 END, CASE WHEN i % 5 = 0 THEN 48.1 END, 0, 0
+  FROM n;
+INSERT INTO color_labels (imgid, color) SELECT id, id % 5 FROM images WHERE id % 4 = 0;
+INSERT INTO tagged_images (imgid, tagid) SELECT id, 1 + id % 5000 FROM images;
+INSERT OR IGNORE INTO tagged_images (imgid, tagid) SELECT id, 1 + (id * 7) % 5000 FROM images WHERE id % 3 = 0;
+INSERT INTO history (imgid, num, module, operation, enabled)
+  SELECT id, 0, 1, 'exposure', 1 FROM images WHERE id % 3 = 0;
+INSERT INTO meta_data (id, key, value) SELECT id, 0, 'creator ' || (id % 100) FROM images WHERE id % 2 = 0;
+INSERT INTO meta_data (id, key, value) SELECT id, 3, 'title ' || id FROM images WHERE id % 10 = 0;
+COMMIT;
+ANALYZE;
+"
+
+# mode|property|where clause|sort order
+QUERIES="
+index|film roll|(film_id IN (SELECT id FROM main.film_rolls WHERE folder LIKE '/home/user/pictures/2001/roll_200'))|
+index|folders|(film_id IN (SELECT id FROM main.film_rolls WHERE folder LIKE '/home/user/pictures/2001%'))|
+index|color label|(id IN (SELECT imgid FROM main.color_labels WHERE color=2))|
+index|color label (any)|(id IN (SELECT imgid FROM main.color_labels WHERE color IS NOT NULL))|
+scan|history|(id IN (SELECT imgid FROM main.history WHERE imgid=images.id))|
+scan|geotagging|(id IN (SELECT id AS imgid FROM main.images WHERE (longitude IS NOT NULL AND latitude IS NOT NULL)))|
+index|camera|((maker = 'maker 3' AND model = 'model 12') OR (maker = 'maker 4' AND model = 'model 1'))|
+index|tag|(id IN (SELECT imgid FROM main.tagged_images AS a JOIN data.tags AS b ON a.tagid = b.id WHERE name LIKE 'places|country 7|%'))|
+scan|title|(id IN (SELECT id FROM main.meta_data WHERE key = 3 AND value LIKE '%title 12%'))|
+scan|creator|(id IN (SELECT id FROM main.meta_data WHERE key = 0 AND value LIKE '%creator 42%'))|
+scan|lens|(lens LIKE '%lens 4%')|
+scan|focal length|((focal_length >= 35) AND (focal_length <= 50))|
+scan|iso|((iso >= 400) AND (iso <= 1600))|
+scan|aperture|((ROUND(aperture,1) >= 2.8) AND (ROUND(aperture,1) <= 5.6))|
+scan|filename|(filename LIKE '%IMG_4242%')|
+index|day|((datetime_taken >= '2005:03:01 00:00:00') AND (datetime_taken <= '2005:03:01 23:59:59'))|
+index|time|(datetime_taken > '2010:01:01 00:00:00')|
+scan|time (pattern)|(datetime_taken LIKE '2005:03:%')|
+index|sort by time|(film_id = 42)|datetime_taken, filename, version
+index|sort by time (descending)|(film_id = 42)|datetime_taken DESC, filename, version
+index|sort by rating|(film_id = 42)|flags & 7 DESC, filename, version
+index|sort by filename|(film_id = 42)|filename, version
+index|sort by id|(film_id = 42)|id
+index|sort by color label|(film_id = 42)|color DESC, filename, version
+index|sort by group|(film_id = 42)|group_id, id-group_id != 0, id
+index|sort by folder|(film_id = 42)|folder, filename, version
+scan|sort whole library by time|(1=1)|datetime_taken, filename, version
+"
+
+echo building a library with $IMAGES images in $TMPDIR...
+echo "$FILL" | sqlite3 "$LIBDB" || exit 1
+
+# the property names and where clauses contain '|', so split on the first two and the last one only
+echo "$QUERIES" | while read -r LINE; do
+    [ -z "$LINE" ] && continue
+
+    MODE=${LINE%%|*}
+    REST=${LINE#*|}
+    NAME=${REST%%|*}
+    REST=${REST#*|}
+    WHERE=${REST%|*}
+    ORDER=${REST##*|}
+
+    case "$NAME" in
+        "sort by color label")
+            SELECT="SELECT DISTINCT id FROM (SELECT * FROM main.images WHERE $WHERE) AS a LEFT OUTER JOIN main.color_labels AS b ON a.id = b.imgid"
+            ;;
+        "sort by folder")
+            SELECT="SELECT DISTINCT id FROM (SELECT * FROM main.images WHERE $WHERE) JOIN (SELECT id AS film_rolls_id, folder FROM main.film_rolls) ON film_id = film_rolls_id"
+            ;;
+        *)
+            SELECT="SELECT DISTINCT id FROM main.images WHERE $WHERE"
+            ;;
+    esac
+    [ -n "$ORDER" ] && SELECT="$SELECT ORDER BY $ORDER"
+
+    PLAN=$(printf "ATTACH DATABASE '%s' AS data;\nEXPLAIN QUERY PLAN %s;\n" "$DATADB" "$SELECT" | sqlite3 "$LIBDB")
+    TIME=$(printf "ATTACH DATABASE '%s' AS data;\n.timer on\nSELECT COUNT(*) FROM (%s);\n" "$DATADB" "$SELECT" \
+           | sqlite3 "$LIBDB" | sed -n 's/^Run Time: real \([0-9.]*\).*/\1/p')
+    SCANS=$(echo "$PLAN" | grep -E "SCAN (TABLE )?[a-z_]+" | grep -v -E "SCAN (TABLE )?((main|data)\.)?($SMALL_TABLES)( |$)")
+
+    STATUS=ok
+    if [ -n "$SCANS" ]; then
+        if [ "$MODE" = "index" ]; then
+            STATUS=FAIL
+        else
+            STATUS="scan (expected)"
+        fi
+    fi
+
+    echo
+    echo "== $NAME: ${TIME}s, $STATUS"
+    echo "$SELECT"
+    echo "$PLAN" | grep -v "^QUERY PLAN"
+
+    [ "$STATUS" = "FAIL" ] && echo "$NAME" >> "$TMPDIR/failed"
+done
+
+if [ -f "$TMPDIR/failed" ]; then
+    echo
+    echo the following queries scan a big table:
+    cat "$TMPDIR/failed"
+    exit 1
+fi